@@ -0,0 +1,17 @@
+struct PS_INPUT
+{
+  float4 pos : SV_POSITION;
+  float4 col : COLOR0;
+  float2 uv  : TEXCOORD0;
+};
+SamplerState sampler0 : register(s0);
+Texture2D texture0 : register(t0);
+
+// Shades a signed distance field font atlas, 0.5 lies on the glyph edge.
+float4 main(PS_INPUT input) : SV_Target
+{
+  float dist = texture0.Sample(sampler0, input.uv).r;
+  float width = max(fwidth(dist) * 0.7071, 0.0001);
+  float alpha = smoothstep(0.5 - width, 0.5 + width, dist);
+  return float4(input.col.rgb, input.col.a * alpha);
+}
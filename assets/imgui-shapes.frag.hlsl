@@ -0,0 +1,25 @@
+struct PS_INPUT
+{
+  float4 pos : SV_POSITION;
+  float4 col : COLOR0;
+  float2 uv  : TEXCOORD0;
+  nointerpolation float4 shape : TEXCOORD1;
+  float2 local : TEXCOORD2;
+};
+SamplerState sampler0 : register(s0);
+Texture2D texture0 : register(t0);
+
+// Shapes are a rounded rect's distance in pixels, stroked when they have a
+// thickness. Everything else is drawn as usual.
+float4 main(PS_INPUT input) : SV_Target
+{
+  float pixel = max(length(fwidth(input.local)) * 0.7071, 0.0001);
+  if (input.shape.x < 0.0)
+    return input.col * texture0.Sample(sampler0, input.uv);
+  float2 q = abs(input.local) - input.shape.xy + input.shape.z;
+  float dist = min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - input.shape.z;
+  if (input.shape.w > 0.0)
+    dist = abs(dist) - input.shape.w * 0.5;
+  float alpha = saturate(0.5 - dist / pixel);
+  return float4(input.col.rgb, input.col.a * alpha);
+}
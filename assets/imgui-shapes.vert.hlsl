@@ -0,0 +1,54 @@
+cbuffer vertexBuffer : register(b0) 
+{
+    float4x4 ProjectionMatrix; 
+};
+
+// SV_VertexID counts from the draw's base vertex, which shapes need to find
+// their parameters
+cbuffer shapeBuffer : register(b1)
+{
+    uint BaseVertex;
+};
+
+// The vertex buffer, read back as raw bytes
+ByteAddressBuffer vertices : register(t1);
+
+struct VS_INPUT
+{
+    float2 pos : POSITION;
+    float4 col : COLOR0;
+    float2 uv  : TEXCOORD0;
+    uint id    : SV_VertexID;
+};
+
+struct PS_INPUT
+{
+    float4 pos : SV_POSITION;
+    float4 col : COLOR0;
+    float2 uv  : TEXCOORD0;
+    nointerpolation float4 shape : TEXCOORD1;
+    float2 local : TEXCOORD2;
+};
+
+PS_INPUT main(VS_INPUT input)
+{
+    PS_INPUT output;
+    output.pos = mul( ProjectionMatrix, float4(input.pos.xy, 0.f, 1.f));
+    output.col = input.col;
+    output.uv  = input.uv;
+    output.shape = float4(-1.f, -1.f, -1.f, -1.f);
+    output.local = float2(0.f, 0.f);
+
+    // Shape corners carry their index in the UV, the vertex after them holds
+    // the half size, rounding and thickness
+    if (input.uv.y <= -65536.f)
+    {
+        uint corner = (uint)(-65536.f - input.uv.y);
+        uint param = (BaseVertex + input.id - corner + 4) * 20;
+        output.shape = asfloat(vertices.Load4(param));
+        float2 side = float2(corner == 1 || corner == 2 ? 1.f : -1.f,
+                             corner >= 2 ? 1.f : -1.f);
+        output.local = side * (output.shape.xy + output.shape.w * 0.5f + 1.f);
+    }
+    return output;
+}
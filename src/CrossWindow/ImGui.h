@@ -7,4 +7,6 @@
     "Define either XGFX_VULKAN, XGFX_OPENGL, XGFX_DIRECTX12, XGFX_DIRECTX11, and/or XGFX_METAL before #include \"CrossWindow/ImGui.h\""
 #endif
 
-#include "ImGui/DirectX12.h"
\ No newline at end of file
+#include "ImGui/DirectX12.h"
+#include "ImGui/Remote.h"
+#include "ImGui/Trace.h"
\ No newline at end of file
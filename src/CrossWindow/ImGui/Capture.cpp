@@ -0,0 +1,376 @@
+#include "Capture.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XGFX_IMGUI_SSE2 1
+#endif
+
+namespace xgfx
+{
+namespace
+{
+const int kHashLog = 15;
+const size_t kMinMatch = 4;
+const size_t kMaxMatch = 258;
+const size_t kWindowSize = 32768;
+
+uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - kHashLog);
+}
+
+void writeBigEndian(uint8_t* p, uint32_t v)
+{
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+uint32_t reverseBits(uint32_t code, unsigned bits)
+{
+    uint32_t reversed = 0;
+    for (unsigned i = 0; i < bits; i++)
+        reversed |= ((code >> i) & 1) << (bits - 1 - i);
+    return reversed;
+}
+
+// Deflate's fixed Huffman codes, bit reversed since deflate packs bits from
+// the least significant end, with the extra bits of every match length and
+// distance folded in so each needs a single write.
+struct DeflateTables
+{
+    uint16_t literalCode[257];
+    uint8_t literalBits[257];
+    uint32_t lengthCode[kMaxMatch + 1];
+    uint8_t lengthBits[kMaxMatch + 1];
+    uint8_t distanceSymbol[kWindowSize + 1];
+    uint16_t distanceBase[30];
+    uint8_t distanceCode[30];
+    uint8_t distanceExtra[30];
+    uint32_t crc[256];
+
+    DeflateTables()
+    {
+        for (uint32_t s = 0; s <= 256; s++)
+        {
+            uint32_t code, bits;
+            if (s < 144)
+                code = 0x30 + s, bits = 8;
+            else if (s < 256)
+                code = 0x190 + s - 144, bits = 9;
+            else
+                code = 0, bits = 7;
+            literalCode[s] = static_cast<uint16_t>(reverseBits(code, bits));
+            literalBits[s] = static_cast<uint8_t>(bits);
+        }
+
+        static const uint16_t lengthBase[29] = {
+            3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+            31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                                1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                                4, 4, 4, 4, 5, 5, 5, 5, 0};
+        for (int i = 0; i < 29; i++)
+        {
+            uint32_t s = 257 + i;
+            uint32_t code = s < 280 ? s - 256 : 0xC0 + s - 280;
+            uint32_t bits = s < 280 ? 7 : 8;
+            uint32_t end = i < 28 ? lengthBase[i + 1] : kMaxMatch + 1;
+            for (uint32_t length = lengthBase[i]; length < end; length++)
+            {
+                lengthCode[length] =
+                    reverseBits(code, bits) |
+                    ((length - lengthBase[i]) << bits);
+                lengthBits[length] =
+                    static_cast<uint8_t>(bits + lengthExtra[i]);
+            }
+        }
+
+        uint32_t base = 1;
+        for (int i = 0; i < 30; i++)
+        {
+            distanceBase[i] = static_cast<uint16_t>(base);
+            distanceCode[i] = static_cast<uint8_t>(reverseBits(i, 5));
+            distanceExtra[i] = static_cast<uint8_t>(i < 4 ? 0 : i / 2 - 1);
+            uint32_t end = base + (1u << distanceExtra[i]);
+            for (uint32_t distance = base; distance < end; distance++)
+                distanceSymbol[distance] = static_cast<uint8_t>(i);
+            base = end;
+        }
+
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc[n] = c;
+        }
+    }
+};
+
+const DeflateTables& deflateTables()
+{
+    static const DeflateTables tables;
+    return tables;
+}
+
+class BitWriter
+{
+  public:
+    explicit BitWriter(uint8_t* out) : mOut(out) {}
+
+    // Up to 32 bits at a time
+    void put(uint32_t value, unsigned count)
+    {
+        mBits |= static_cast<uint64_t>(value) << mCount;
+        mCount += count;
+        if (mCount >= 32)
+        {
+            uint32_t word = static_cast<uint32_t>(mBits);
+            mOut[0] = static_cast<uint8_t>(word);
+            mOut[1] = static_cast<uint8_t>(word >> 8);
+            mOut[2] = static_cast<uint8_t>(word >> 16);
+            mOut[3] = static_cast<uint8_t>(word >> 24);
+            mOut += 4;
+            mBits >>= 32;
+            mCount -= 32;
+        }
+    }
+
+    // Pad to a whole byte, returning the end of the written bytes
+    uint8_t* finish()
+    {
+        while (mCount > 0)
+        {
+            *mOut++ = static_cast<uint8_t>(mBits);
+            mBits >>= 8;
+            mCount = mCount > 8 ? mCount - 8 : 0;
+        }
+        return mOut;
+    }
+
+  private:
+    uint8_t* mOut;
+    uint64_t mBits = 0;
+    unsigned mCount = 0;
+};
+
+// Largest output of deflateFixed(), as no symbol takes over 9 bits a byte.
+size_t deflateBound(size_t size) { return size + size / 8 + 16; }
+
+// A single fixed Huffman block with greedy matches against the last
+// position of each hashed 4 byte sequence. Most of a UI frame is flat color
+// and repeated glyphs, which this catches at a fraction of zlib's cost.
+uint8_t* deflateFixed(const uint8_t* src, size_t size, uint8_t* dst)
+{
+    const DeflateTables& t = deflateTables();
+    BitWriter out(dst);
+    out.put(3, 3); // Final block, fixed codes
+
+    std::vector<uint32_t> table(1u << kHashLog, 0);
+    size_t ip = 0;
+    while (ip + kMinMatch <= size)
+    {
+        uint32_t sequence = read32(src + ip);
+        uint32_t h = hash(sequence);
+        size_t ref = table[h];
+        table[h] = static_cast<uint32_t>(ip);
+        size_t distance = ip - ref;
+        if (distance == 0 || distance > kWindowSize ||
+            read32(src + ref) != sequence)
+        {
+            out.put(t.literalCode[src[ip]], t.literalBits[src[ip]]);
+            ip++;
+            continue;
+        }
+
+        size_t length = kMinMatch;
+        size_t maxLength = size - ip < kMaxMatch ? size - ip : kMaxMatch;
+        while (length < maxLength && src[ip + length] == src[ref + length])
+            length++;
+
+        unsigned symbol = t.distanceSymbol[distance];
+        uint32_t distanceCode =
+            t.distanceCode[symbol] |
+            static_cast<uint32_t>(distance - t.distanceBase[symbol]) << 5;
+        out.put(t.lengthCode[length] | distanceCode << t.lengthBits[length],
+                t.lengthBits[length] + 5 + t.distanceExtra[symbol]);
+        ip += length;
+    }
+    for (; ip < size; ip++)
+        out.put(t.literalCode[src[ip]], t.literalBits[src[ip]]);
+    out.put(t.literalCode[256], t.literalBits[256]);
+    return out.finish();
+}
+
+uint32_t adler32(const uint8_t* data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+        // Largest run before b can overflow
+        size_t run = size < 5552 ? size : 5552;
+        size -= run;
+        for (size_t i = 0; i < run; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        data += run;
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+uint32_t crc32(const uint8_t* data, size_t size)
+{
+    const uint32_t* table = deflateTables().crc;
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+        c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+size_t beginChunk(std::vector<uint8_t>& out, const char* type)
+{
+    size_t offset = out.size();
+    out.resize(offset + 8);
+    memcpy(&out[offset + 4], type, 4);
+    return offset;
+}
+
+void endChunk(std::vector<uint8_t>& out, size_t offset)
+{
+    size_t length = out.size() - offset - 8;
+    writeBigEndian(&out[offset], static_cast<uint32_t>(length));
+    uint32_t crc = crc32(&out[offset + 4], length + 4);
+    out.resize(out.size() + 4);
+    writeBigEndian(&out[out.size() - 4], crc);
+}
+
+// PNG's Sub filter, storing each byte as the difference from the same
+// channel of the pixel to its left.
+void filterSub(const uint8_t* row, uint8_t* dst, size_t size)
+{
+    size_t i = 0;
+    for (; i < 4 && i < size; i++)
+        dst[i] = row[i];
+#if defined(XGFX_IMGUI_SSE2)
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i left = _mm_loadu_si128((const __m128i*)(row + i - 4));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_sub_epi8(p, left));
+    }
+#endif
+    for (; i < size; i++)
+        dst[i] = static_cast<uint8_t>(row[i] - row[i - 4]);
+}
+}
+
+void convertReadback(const uint8_t* src, uint8_t* dst, int width, int height)
+{
+    const size_t stride = static_cast<size_t>(width) * 4;
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* in = src + stride * (height - 1 - y);
+        uint8_t* out = dst + stride * y;
+        int x = 0;
+#if defined(XGFX_IMGUI_SSE2)
+        // Four pixels at a time
+        const __m128i green = _mm_set1_epi32(0x0000FF00);
+        const __m128i red_blue = _mm_set1_epi32(0x00FF00FF);
+        const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i p = _mm_loadu_si128((const __m128i*)(in + x * 4));
+            __m128i rb = _mm_and_si128(p, red_blue);
+            rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            p = _mm_or_si128(_mm_and_si128(p, green), alpha);
+            _mm_storeu_si128((__m128i*)(out + x * 4), _mm_or_si128(p, rb));
+        }
+#endif
+        for (; x < width; x++)
+        {
+            out[x * 4 + 0] = in[x * 4 + 2];
+            out[x * 4 + 1] = in[x * 4 + 1];
+            out[x * 4 + 2] = in[x * 4 + 0];
+            out[x * 4 + 3] = 255;
+        }
+    }
+}
+
+void encodePng(const CaptureImage& image, std::vector<uint8_t>& out)
+{
+    const size_t stride = static_cast<size_t>(image.width) * 4;
+    const size_t rowSize = stride + 1;
+    std::vector<uint8_t> filtered(rowSize * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        uint8_t* row = &filtered[rowSize * y];
+        row[0] = 1;
+        filterSub(&image.pixels[stride * y], row + 1, stride);
+    }
+
+    static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    out.assign(signature, signature + sizeof(signature));
+
+    size_t chunk = beginChunk(out, "IHDR");
+    uint8_t header[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 6, 0, 0, 0};
+    writeBigEndian(header, static_cast<uint32_t>(image.width));
+    writeBigEndian(header + 4, static_cast<uint32_t>(image.height));
+    out.insert(out.end(), header, header + sizeof(header));
+    endChunk(out, chunk);
+
+    // A zlib stream flagged as compressed with the fastest level
+    chunk = beginChunk(out, "IDAT");
+    size_t start = out.size();
+    out.resize(start + 2 + deflateBound(filtered.size()) + 4);
+    out[start] = 0x78;
+    out[start + 1] = 0x01;
+    uint8_t* end =
+        deflateFixed(filtered.data(), filtered.size(), &out[start + 2]);
+    writeBigEndian(end, adler32(filtered.data(), filtered.size()));
+    out.resize(end + 4 - out.data());
+    endChunk(out, chunk);
+
+    chunk = beginChunk(out, "IEND");
+    endChunk(out, chunk);
+}
+
+bool writeCapture(const char* path, const CaptureImage& image,
+                  CaptureFormat format)
+{
+    if (image.width <= 0 || image.height <= 0 ||
+        image.pixels.size() != static_cast<size_t>(image.width) *
+                                   image.height * 4)
+    {
+        fprintf(stderr, "ERROR: Capture pixels don't match its size!\n");
+        return false;
+    }
+
+    std::vector<uint8_t> png;
+    if (format == CaptureFormat::Png) encodePng(image, png);
+    const std::vector<uint8_t>& data =
+        format == CaptureFormat::Png ? png : image.pixels;
+    std::FILE* file = std::fopen(path, "wb");
+    bool written =
+        file && std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    if (file && std::fclose(file) != 0) written = false;
+    if (!written) fprintf(stderr, "ERROR: Failed to write %s!\n", path);
+    return written;
+}
+}
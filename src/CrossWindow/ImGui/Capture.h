@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace xgfx
+{
+// File format of saved screenshots and recorded frames.
+enum class CaptureFormat
+{
+    // RGBA8 pixels only, rows from the top, e.g. for ffmpeg's rawvideo
+    Raw,
+    Png
+};
+
+// A framebuffer read back by a backend, as opaque RGBA8 rows from the top.
+struct CaptureImage
+{
+    // Count of frames rendered by the manager when it was captured
+    uint64_t frame = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Convert `height` rows of BGRA8 pixels read back bottom row first into
+// `dst` as RGBA8 top row first, replacing alpha with opaque since a window's
+// alpha only holds blending leftovers.
+void convertReadback(const uint8_t* src, uint8_t* dst, int width, int height);
+
+// Encode an image as PNG with a fast single pass deflate, trading some size
+// for keeping up with recording every frame.
+void encodePng(const CaptureImage& image, std::vector<uint8_t>& out);
+
+bool writeCapture(const char* path, const CaptureImage& image,
+                  CaptureFormat format);
+}
@@ -694,4 +694,115 @@ const unsigned char imguiD3D12PixelShader[] = {
     0x98, 0x41, 0x27, 0x8c, 0x18, 0x24, 0x00, 0x08, 0x82, 0x01, 0xd2, 0x06,
     0x69, 0x60, 0x06, 0x66, 0x00, 0x06, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00};
 
+// The shaders below are compiled from source by createDeviceObjects() when
+// their feature is enabled. Keep them in sync with their files in assets/.
+
+// assets/imgui-sdf.frag.hlsl
+const char imguiD3D12SdfPixelShaderSource[] = R"(
+struct PS_INPUT
+{
+  float4 pos : SV_POSITION;
+  float4 col : COLOR0;
+  float2 uv  : TEXCOORD0;
+};
+SamplerState sampler0 : register(s0);
+Texture2D texture0 : register(t0);
+
+// Shades a signed distance field font atlas, 0.5 lies on the glyph edge.
+float4 main(PS_INPUT input) : SV_Target
+{
+  float dist = texture0.Sample(sampler0, input.uv).r;
+  float width = max(fwidth(dist) * 0.7071, 0.0001);
+  float alpha = smoothstep(0.5 - width, 0.5 + width, dist);
+  return float4(input.col.rgb, input.col.a * alpha);
+}
+)";
+
+// assets/imgui-shapes.vert.hlsl
+const char imguiD3D12ShapeVertexShaderSource[] = R"(
+cbuffer vertexBuffer : register(b0) 
+{
+    float4x4 ProjectionMatrix; 
+};
+
+// SV_VertexID counts from the draw's base vertex, which shapes need to find
+// their parameters
+cbuffer shapeBuffer : register(b1)
+{
+    uint BaseVertex;
+};
+
+// The vertex buffer, read back as raw bytes
+ByteAddressBuffer vertices : register(t1);
+
+struct VS_INPUT
+{
+    float2 pos : POSITION;
+    float4 col : COLOR0;
+    float2 uv  : TEXCOORD0;
+    uint id    : SV_VertexID;
+};
+
+struct PS_INPUT
+{
+    float4 pos : SV_POSITION;
+    float4 col : COLOR0;
+    float2 uv  : TEXCOORD0;
+    nointerpolation float4 shape : TEXCOORD1;
+    float2 local : TEXCOORD2;
+};
+
+PS_INPUT main(VS_INPUT input)
+{
+    PS_INPUT output;
+    output.pos = mul( ProjectionMatrix, float4(input.pos.xy, 0.f, 1.f));
+    output.col = input.col;
+    output.uv  = input.uv;
+    output.shape = float4(-1.f, -1.f, -1.f, -1.f);
+    output.local = float2(0.f, 0.f);
+
+    // Shape corners carry their index in the UV, the vertex after them holds
+    // the half size, rounding and thickness
+    if (input.uv.y <= -65536.f)
+    {
+        uint corner = (uint)(-65536.f - input.uv.y);
+        uint param = (BaseVertex + input.id - corner + 4) * 20;
+        output.shape = asfloat(vertices.Load4(param));
+        float2 side = float2(corner == 1 || corner == 2 ? 1.f : -1.f,
+                             corner >= 2 ? 1.f : -1.f);
+        output.local = side * (output.shape.xy + output.shape.w * 0.5f + 1.f);
+    }
+    return output;
+}
+)";
+
+// assets/imgui-shapes.frag.hlsl
+const char imguiD3D12ShapePixelShaderSource[] = R"(
+struct PS_INPUT
+{
+  float4 pos : SV_POSITION;
+  float4 col : COLOR0;
+  float2 uv  : TEXCOORD0;
+  nointerpolation float4 shape : TEXCOORD1;
+  float2 local : TEXCOORD2;
+};
+SamplerState sampler0 : register(s0);
+Texture2D texture0 : register(t0);
+
+// Shapes are a rounded rect's distance in pixels, stroked when they have a
+// thickness. Everything else is drawn as usual.
+float4 main(PS_INPUT input) : SV_Target
+{
+  float pixel = max(length(fwidth(input.local)) * 0.7071, 0.0001);
+  if (input.shape.x < 0.0)
+    return input.col * texture0.Sample(sampler0, input.uv);
+  float2 q = abs(input.local) - input.shape.xy + input.shape.z;
+  float dist = min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - input.shape.z;
+  if (input.shape.w > 0.0)
+    dist = abs(dist) - input.shape.w * 0.5;
+  float alpha = saturate(0.5 - dist / pixel);
+  return float4(input.col.rgb, input.col.a * alpha);
+}
+)";
+
 }
\ No newline at end of file
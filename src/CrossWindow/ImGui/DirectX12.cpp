@@ -1,11 +1,18 @@
 #include "DirectX12.h"
 #include "DirectX12-Shaders.h"
+#include "FontSdf.h"
+#include "Trace.h"
 #include "imgui.h"
 
 // DirectX
 #include <d3d12.h>
+#include <d3dcompiler.h>
 #include <dxgi1_4.h>
 
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
 namespace xgfx
 {
 
@@ -16,6 +23,7 @@ struct ImGuiD3D12Data
     ID3D12Device* pd3dDevice;
     ID3D12RootSignature* pRootSignature;
     ID3D12PipelineState* pPipelineState;
+    ID3D12PipelineState* pSdfPipelineState;
     DXGI_FORMAT RTVFormat;
     ID3D12Resource* pFontTextureResource;
     D3D12_CPU_DESCRIPTOR_HANDLE hFontSrvCpuDescHandle;
@@ -63,17 +71,22 @@ void D3D12ImGuiManager::setupRenderState(ImDrawData* drawData,
                                          ID3D12GraphicsCommandList* ctx,
                                          ImGuiD3D12RenderBuffers* fr)
 {
+    XGFX_TRACE_SCOPE("D3D12ImGuiManager::setupRenderState");
     ImGuiD3D12Data* bd = GetBackendData();
 
     // Setup orthographic projection matrix into our constant buffer
     // Our visible imgui space lies from drawData->DisplayPos (top left) to
-    // drawData->DisplayPos+data_data->DisplaySize (bottom right).
+    // drawData->DisplayPos+data_data->DisplaySize (bottom right). A stale
+    // frame redrawn during a live resize covers the framebuffer at its own
+    // scale instead.
+    ImVec2 fb_size = framebufferSize(drawData);
+    ImVec2 fb_scale = framebufferScale(drawData);
     VERTEX_CONSTANT_BUFFER_DX12 vertex_constant_buffer;
     {
         float L = drawData->DisplayPos.x;
-        float R = drawData->DisplayPos.x + drawData->DisplaySize.x;
+        float R = drawData->DisplayPos.x + fb_size.x / fb_scale.x;
         float T = drawData->DisplayPos.y;
-        float B = drawData->DisplayPos.y + drawData->DisplaySize.y;
+        float B = drawData->DisplayPos.y + fb_size.y / fb_scale.y;
         float mvp[4][4] = {
             {2.0f / (R - L), 0.0f, 0.0f, 0.0f},
             {0.0f, 2.0f / (T - B), 0.0f, 0.0f},
@@ -86,8 +99,8 @@ void D3D12ImGuiManager::setupRenderState(ImDrawData* drawData,
     // Setup viewport
     D3D12_VIEWPORT vp;
     memset(&vp, 0, sizeof(D3D12_VIEWPORT));
-    vp.Width = drawData->DisplaySize.x * drawData->FramebufferScale.x;
-    vp.Height = drawData->DisplaySize.y * drawData->FramebufferScale.y;
+    vp.Width = fb_size.x;
+    vp.Height = fb_size.y;
     vp.MinDepth = 0.0f;
     vp.MaxDepth = 1.0f;
     vp.TopLeftX = vp.TopLeftY = 0.0f;
@@ -113,6 +126,9 @@ void D3D12ImGuiManager::setupRenderState(ImDrawData* drawData,
     ctx->SetPipelineState(bd->pPipelineState);
     ctx->SetGraphicsRootSignature(bd->pRootSignature);
     ctx->SetGraphicsRoot32BitConstants(0, 16, &vertex_constant_buffer, 0);
+    if (mShapeShaders)
+        ctx->SetGraphicsRootShaderResourceView(
+            3, fr->VertexBuffer->GetGPUVirtualAddress());
 
     // Setup blend factor
     const float blend_factor[4] = {0.f, 0.f, 0.f, 0.f};
@@ -125,6 +141,24 @@ template <typename T> static inline void SafeRelease(T*& res)
     res = nullptr;
 }
 
+// Compile a shader DirectX12-Shaders.h only embeds as source. Returns null
+// and writes the compiler's messages to stderr if it fails.
+static ID3DBlob* compileShader(const char* source, const char* target)
+{
+    ID3DBlob* code = nullptr;
+    ID3DBlob* errors = nullptr;
+    if (FAILED(D3DCompile(source, strlen(source), nullptr, nullptr, nullptr,
+                          "main", target, D3DCOMPILE_OPTIMIZATION_LEVEL3, 0,
+                          &code, &errors)))
+    {
+        fprintf(stderr, "ERROR: Failed to compile %s shader!\n%s", target,
+                errors ? (const char*)errors->GetBufferPointer() : "");
+        SafeRelease(code);
+    }
+    SafeRelease(errors);
+    return code;
+}
+
 D3D12ImGuiManager::D3D12ImGuiManager() {}
 
 D3D12ImGuiManager::~D3D12ImGuiManager() { invalidateDeviceObjects(); }
@@ -136,9 +170,8 @@ bool D3D12ImGuiManager::init(ID3D12Device* device, int numFramesInFlight,
                              D3D12_GPU_DESCRIPTOR_HANDLE fontGpuDeschandle)
 {
     IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
 
-    // Setup CrossWindow event mapping:
+    // Create our context and setup CrossWindow event mapping:
     ImGuiManager::create();
 
     ImGuiIO& io = ImGui::GetIO();
@@ -178,6 +211,7 @@ bool D3D12ImGuiManager::init(ID3D12Device* device, int numFramesInFlight,
 
 void D3D12ImGuiManager::shutdown()
 {
+    ImGuiContextScope scope(context);
     ImGuiD3D12Data* bd = GetBackendData();
     IM_ASSERT(bd != nullptr &&
               "No renderer backend to shutdown, or already shutdown?");
@@ -192,6 +226,7 @@ void D3D12ImGuiManager::shutdown()
 }
 void D3D12ImGuiManager::newFrame()
 {
+    ImGuiContextScope scope(context);
     ImGuiD3D12Data* bd = GetBackendData();
     IM_ASSERT(bd != nullptr && "Did you call init()?");
 
@@ -200,9 +235,17 @@ void D3D12ImGuiManager::newFrame()
 void D3D12ImGuiManager::renderDrawData(
     ImDrawData* drawData, ID3D12GraphicsCommandList* graphicsCommandList)
 {
+    XGFX_TRACE_SCOPE("D3D12ImGuiManager::renderDrawData");
+    ImGuiContextScope scope(context);
+    // GPU timestamps would need the command queue to query its frequency, so
+    // only CPU time is reported here.
+    auto cpuStart = std::chrono::high_resolution_clock::now();
+    frameStats = ImGuiFrameStats();
+
     // Avoid rendering when minimized
     if (drawData->DisplaySize.x <= 0.0f || drawData->DisplaySize.y <= 0.0f)
         return;
+    cullOccludedCommands(drawData);
 
     // FIXME: I'm assuming that this only gets called once per frame!
     // If not, we can't just re-allocate the IB or VB, we'll have to do a proper
@@ -212,12 +255,17 @@ void D3D12ImGuiManager::renderDrawData(
     ImGuiD3D12RenderBuffers* fr =
         &bd->pFrameResources[bd->frameIndex % bd->numFramesInFlight];
 
-    // Create and grow vertex/index buffers if needed
+    // Create or resize vertex/index buffers to the shared capacity. Every
+    // frame in flight follows it, each reallocating when its turn comes
+    // around and the GPU is done with it.
+    vertexBufferSizer.update(drawData->TotalVtxCount);
+    indexBufferSizer.update(drawData->TotalIdxCount);
     if (fr->VertexBuffer == nullptr ||
-        fr->VertexBufferSize < drawData->TotalVtxCount)
+        fr->VertexBufferSize != vertexBufferSizer.capacity)
     {
         SafeRelease(fr->VertexBuffer);
-        fr->VertexBufferSize = drawData->TotalVtxCount + 5000;
+        fr->VertexBufferSize = vertexBufferSizer.capacity;
+        frameStats.bufferReallocations++;
         D3D12_HEAP_PROPERTIES props;
         memset(&props, 0, sizeof(D3D12_HEAP_PROPERTIES));
         props.Type = D3D12_HEAP_TYPE_UPLOAD;
@@ -241,10 +289,11 @@ void D3D12ImGuiManager::renderDrawData(
             return;
     }
     if (fr->IndexBuffer == nullptr ||
-        fr->IndexBufferSize < drawData->TotalIdxCount)
+        fr->IndexBufferSize != indexBufferSizer.capacity)
     {
         SafeRelease(fr->IndexBuffer);
-        fr->IndexBufferSize = drawData->TotalIdxCount + 10000;
+        fr->IndexBufferSize = indexBufferSizer.capacity;
+        frameStats.bufferReallocations++;
         D3D12_HEAP_PROPERTIES props;
         memset(&props, 0, sizeof(D3D12_HEAP_PROPERTIES));
         props.Type = D3D12_HEAP_TYPE_UPLOAD;
@@ -268,93 +317,149 @@ void D3D12ImGuiManager::renderDrawData(
             return;
     }
 
+    size_t buffer_bytes = 0;
+    for (UINT i = 0; i < bd->numFramesInFlight; i++)
+    {
+        const ImGuiD3D12RenderBuffers& buffers = bd->pFrameResources[i];
+        if (buffers.VertexBuffer)
+            buffer_bytes +=
+                (size_t)buffers.VertexBufferSize * sizeof(ImDrawVert);
+        if (buffers.IndexBuffer)
+            buffer_bytes +=
+                (size_t)buffers.IndexBufferSize * sizeof(ImDrawIdx);
+    }
+    recordBufferBytes(buffer_bytes);
+
     // Upload vertex/index data into a single contiguous GPU buffer
-    void *vtx_resource, *idx_resource;
-    D3D12_RANGE range;
-    memset(&range, 0, sizeof(D3D12_RANGE));
-    if (fr->VertexBuffer->Map(0, &range, &vtx_resource) != S_OK) return;
-    if (fr->IndexBuffer->Map(0, &range, &idx_resource) != S_OK) return;
-    ImDrawVert* vtx_dst = (ImDrawVert*)vtx_resource;
-    ImDrawIdx* idx_dst = (ImDrawIdx*)idx_resource;
-    for (int n = 0; n < drawData->CmdListsCount; n++)
     {
-        const ImDrawList* cmd_list = drawData->CmdLists[n];
-        memcpy(vtx_dst, cmd_list->VtxBuffer.Data,
-               cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
-        memcpy(idx_dst, cmd_list->IdxBuffer.Data,
-               cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
-        vtx_dst += cmd_list->VtxBuffer.Size;
-        idx_dst += cmd_list->IdxBuffer.Size;
+        XGFX_TRACE_SCOPE("ImGui upload");
+        void *vtx_resource, *idx_resource;
+        D3D12_RANGE range;
+        memset(&range, 0, sizeof(D3D12_RANGE));
+        if (fr->VertexBuffer->Map(0, &range, &vtx_resource) != S_OK) return;
+        if (fr->IndexBuffer->Map(0, &range, &idx_resource) != S_OK) return;
+        ImDrawVert* vtx_dst = (ImDrawVert*)vtx_resource;
+        ImDrawIdx* idx_dst = (ImDrawIdx*)idx_resource;
+        for (int n = 0; n < drawData->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = drawData->CmdLists[n];
+            memcpy(vtx_dst, cmd_list->VtxBuffer.Data,
+                   cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+            memcpy(idx_dst, cmd_list->IdxBuffer.Data,
+                   cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+            vtx_dst += cmd_list->VtxBuffer.Size;
+            idx_dst += cmd_list->IdxBuffer.Size;
+        }
+        fr->VertexBuffer->Unmap(0, &range);
+        fr->IndexBuffer->Unmap(0, &range);
     }
-    fr->VertexBuffer->Unmap(0, &range);
-    fr->IndexBuffer->Unmap(0, &range);
+    frameStats.vertexCount = static_cast<unsigned>(drawData->TotalVtxCount);
+    frameStats.indexCount = static_cast<unsigned>(drawData->TotalIdxCount);
+    frameStats.bytesUploaded =
+        (size_t)drawData->TotalVtxCount * sizeof(ImDrawVert) +
+        (size_t)drawData->TotalIdxCount * sizeof(ImDrawIdx);
 
     // Setup desired DX state
     setupRenderState(drawData, graphicsCommandList, fr);
 
+    // Skip redundant pipeline, descriptor table and scissor changes between
+    // commands
+    ID3D12PipelineState* last_pipeline = bd->pPipelineState;
+    int last_base_vertex = -1;
+    UINT64 last_texture = 0;
+    D3D12_RECT last_scissor = {0, 0, -1, -1};
+
     // Render command lists
-    // (Because we merged all buffers into a single one, we maintain our own
-    // offset into them)
-    int global_vtx_offset = 0;
-    int global_idx_offset = 0;
-    ImVec2 clip_off = drawData->DisplayPos;
-    for (int n = 0; n < drawData->CmdListsCount; n++)
+    // (Because we merged all buffers into a single one, the compiled ops
+    // carry global offsets into them)
+    renderOps.clear();
+    compileRenderOps(drawData, renderOps);
+    XGFX_TRACE_SCOPE("ImGui draw loop");
+    for (const ImGuiRenderOp& op : renderOps)
     {
-        const ImDrawList* cmd_list = drawData->CmdLists[n];
-        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        if (op.type != ImGuiRenderOp::Draw)
         {
-            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
-            if (pcmd->UserCallback != nullptr)
+            // User callback, registered via ImDrawList::AddCallback()
+            // (ImDrawCallback_ResetRenderState is a special callback value
+            // used by the user to request the renderer to reset render
+            // state.)
+            if (op.type == ImGuiRenderOp::ResetRenderState)
             {
-                // User callback, registered via ImDrawList::AddCallback()
-                // (ImDrawCallback_ResetRenderState is a special callback value
-                // used by the user to request the renderer to reset render
-                // state.)
-                if (pcmd->UserCallback == ImDrawCallback_ResetRenderState)
-                    setupRenderState(drawData, graphicsCommandList, fr);
-                else
-                    pcmd->UserCallback(cmd_list, pcmd);
+                setupRenderState(drawData, graphicsCommandList, fr);
+                last_pipeline = bd->pPipelineState;
             }
             else
             {
-                // Project scissor/clipping rectangles into framebuffer space
-                ImVec2 clip_min((pcmd->ClipRect.x - clip_off.x) *
-                                    drawData->FramebufferScale.x,
-                                (pcmd->ClipRect.y - clip_off.y) *
-                                    drawData->FramebufferScale.y);
-                ImVec2 clip_max((pcmd->ClipRect.z - clip_off.x) *
-                                    drawData->FramebufferScale.x,
-                                (pcmd->ClipRect.w - clip_off.y) *
-                                    drawData->FramebufferScale.y);
-                if (clip_max.x <= clip_min.x || clip_max.y <= clip_min.y)
-                    continue;
-
-                // Apply Scissor/clipping rectangle, Bind texture, Draw
-                const D3D12_RECT r = {(LONG)clip_min.x, (LONG)clip_min.y,
-                                      (LONG)clip_max.x, (LONG)clip_max.y};
-                D3D12_GPU_DESCRIPTOR_HANDLE texture_handle = {};
-                texture_handle.ptr = (UINT64)pcmd->GetTexID();
-                graphicsCommandList->SetGraphicsRootDescriptorTable(
-                    1, texture_handle);
-                graphicsCommandList->RSSetScissorRects(1, &r);
-                graphicsCommandList->DrawIndexedInstanced(
-                    pcmd->ElemCount, 1, pcmd->IdxOffset + global_idx_offset,
-                    pcmd->VtxOffset + global_vtx_offset, 0);
+                op.cmd->UserCallback(op.list, op.cmd);
+                last_pipeline = nullptr;
             }
+            last_base_vertex = -1;
+            last_texture = 0;
+            last_scissor.right = -1;
+            continue;
+        }
+
+        // Apply Scissor/clipping rectangle, Bind texture, Draw
+        const D3D12_RECT r = {op.scissor[0], op.scissor[1], op.scissor[2],
+                              op.scissor[3]};
+        D3D12_GPU_DESCRIPTOR_HANDLE texture_handle = {};
+        texture_handle.ptr = (UINT64)op.texture;
+
+        // A distance field font atlas is shaded by its own pipeline
+        ID3D12PipelineState* pipeline =
+            bd->pSdfPipelineState &&
+                    texture_handle.ptr == bd->hFontSrvGpuDescHandle.ptr
+                ? bd->pSdfPipelineState
+                : bd->pPipelineState;
+        if (pipeline != last_pipeline)
+        {
+            graphicsCommandList->SetPipelineState(pipeline);
+            last_pipeline = pipeline;
+        }
+
+        // SV_VertexID doesn't include the base vertex, which the shape
+        // shaders need to find a shape's parameters
+        if (mShapeShaders && op.vtxOffset != last_base_vertex)
+        {
+            graphicsCommandList->SetGraphicsRoot32BitConstant(
+                2, (UINT)op.vtxOffset, 0);
+            last_base_vertex = op.vtxOffset;
+        }
+        if (texture_handle.ptr != last_texture)
+        {
+            graphicsCommandList->SetGraphicsRootDescriptorTable(
+                1, texture_handle);
+            last_texture = texture_handle.ptr;
+            frameStats.textureBinds++;
+        }
+        if (memcmp(&r, &last_scissor, sizeof(r)) != 0)
+        {
+            graphicsCommandList->RSSetScissorRects(1, &r);
+            last_scissor = r;
+            frameStats.scissorChanges++;
         }
-        global_idx_offset += cmd_list->IdxBuffer.Size;
-        global_vtx_offset += cmd_list->VtxBuffer.Size;
+        graphicsCommandList->DrawIndexedInstanced(op.elemCount, 1,
+                                                  op.idxOffset, op.vtxOffset,
+                                                  0);
+        frameStats.drawCalls++;
     }
+
+    frameStats.cpuTimeMs =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - cpuStart)
+            .count();
 }
 
 void D3D12ImGuiManager::invalidateDeviceObjects()
 {
+    ImGuiContextScope scope(context);
     ImGuiD3D12Data* bd = GetBackendData();
     if (!bd || !bd->pd3dDevice) return;
 
     ImGuiIO& io = ImGui::GetIO();
     SafeRelease(bd->pRootSignature);
     SafeRelease(bd->pPipelineState);
+    SafeRelease(bd->pSdfPipelineState);
     SafeRelease(bd->pFontTextureResource);
     io.Fonts->SetTexID(0); // We copied bd->pFontTextureView to io.Fonts->TexID
                            // so let's clear that as well.
@@ -365,9 +470,14 @@ void D3D12ImGuiManager::invalidateDeviceObjects()
         SafeRelease(fr->IndexBuffer);
         SafeRelease(fr->VertexBuffer);
     }
+    vertexBufferSizer.reset();
+    indexBufferSizer.reset();
+    mShapeShaders = false;
+    analyticShapes = false;
 }
 bool D3D12ImGuiManager::createDeviceObjects()
 {
+    ImGuiContextScope scope(context);
     ImGuiD3D12Data* bd = GetBackendData();
     if (!bd || !bd->pd3dDevice) return false;
     if (bd->pPipelineState) invalidateDeviceObjects();
@@ -381,7 +491,7 @@ bool D3D12ImGuiManager::createDeviceObjects()
         descRange.RegisterSpace = 0;
         descRange.OffsetInDescriptorsFromTableStart = 0;
 
-        D3D12_ROOT_PARAMETER1 param[2] = {};
+        D3D12_ROOT_PARAMETER1 param[4] = {};
 
         param[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
         param[0].Constants.ShaderRegister = 0;
@@ -394,6 +504,19 @@ bool D3D12ImGuiManager::createDeviceObjects()
         param[1].DescriptorTable.pDescriptorRanges = &descRange;
         param[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
+        // The shape shaders' base vertex, and the vertex buffer they read
+        // shape parameters back from
+        param[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+        param[2].Constants.ShaderRegister = 1;
+        param[2].Constants.RegisterSpace = 0;
+        param[2].Constants.Num32BitValues = 1;
+        param[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+        param[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+        param[3].Descriptor.ShaderRegister = 1;
+        param[3].Descriptor.RegisterSpace = 0;
+        param[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
         // Bilinear sampling is required by default. Set 'io.Fonts->Flags |=
         // ImFontAtlasFlags_NoBakedLines' or 'style.AntiAliasedLinesUseTex =
         // false' to allow point/nearest sampling.
@@ -452,10 +575,27 @@ bool D3D12ImGuiManager::createDeviceObjects()
     psoDesc.SampleDesc.Count = 1;
     psoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
 
+    // Shapes need both of their shaders, and are tessellated by ImDrawList
+    // if either fails to compile
+    ID3DBlob* shapeVertexShader = nullptr;
+    ID3DBlob* shapePixelShader = nullptr;
+    if (mAnalyticShapes)
+    {
+        shapeVertexShader =
+            compileShader(imguiD3D12ShapeVertexShaderSource, "vs_5_0");
+        shapePixelShader =
+            compileShader(imguiD3D12ShapePixelShaderSource, "ps_5_0");
+    }
+    mShapeShaders = shapeVertexShader && shapePixelShader;
+
     // Create the vertex shader
     {
-        psoDesc.VS = {xgfx::imguiD3D12VertexShader,
-                      IM_ARRAYSIZE(xgfx::imguiD3D12VertexShader)};
+        if (mShapeShaders)
+            psoDesc.VS = {shapeVertexShader->GetBufferPointer(),
+                          shapeVertexShader->GetBufferSize()};
+        else
+            psoDesc.VS = {xgfx::imguiD3D12VertexShader,
+                          IM_ARRAYSIZE(xgfx::imguiD3D12VertexShader)};
 
         // Create the input layout
         static D3D12_INPUT_ELEMENT_DESC local_layout[] = {
@@ -474,8 +614,12 @@ bool D3D12ImGuiManager::createDeviceObjects()
 
     // Create the pixel shader
     {
-        psoDesc.PS = {xgfx::imguiD3D12PixelShader,
-                      IM_ARRAYSIZE(xgfx::imguiD3D12PixelShader)};
+        if (mShapeShaders)
+            psoDesc.PS = {shapePixelShader->GetBufferPointer(),
+                          shapePixelShader->GetBufferSize()};
+        else
+            psoDesc.PS = {xgfx::imguiD3D12PixelShader,
+                          IM_ARRAYSIZE(xgfx::imguiD3D12PixelShader)};
     }
 
     // Create the blending setup
@@ -525,7 +669,37 @@ bool D3D12ImGuiManager::createDeviceObjects()
     HRESULT result_pipeline_state = bd->pd3dDevice->CreateGraphicsPipelineState(
         &psoDesc, IID_PPV_ARGS(&bd->pPipelineState));
 
-    if (result_pipeline_state != S_OK) return false;
+    if (result_pipeline_state != S_OK)
+    {
+        SafeRelease(shapeVertexShader);
+        SafeRelease(shapePixelShader);
+        mShapeShaders = false;
+        return false;
+    }
+
+    // The same pipeline with the distance field font's pixel shader. Without
+    // it the font falls back to the regular atlas.
+    if (mFontSdf)
+    {
+        if (ID3DBlob* pixelShader =
+                compileShader(imguiD3D12SdfPixelShaderSource, "ps_5_0"))
+        {
+            psoDesc.PS = {pixelShader->GetBufferPointer(),
+                          pixelShader->GetBufferSize()};
+            bd->pd3dDevice->CreateGraphicsPipelineState(
+                &psoDesc, IID_PPV_ARGS(&bd->pSdfPipelineState));
+            pixelShader->Release();
+        }
+        if (!bd->pSdfPipelineState)
+            fprintf(stderr, "ERROR: Failed to create the distance field font "
+                            "pipeline, using the regular atlas!\n");
+    }
+    SafeRelease(shapeVertexShader);
+    SafeRelease(shapePixelShader);
+    if (mAnalyticShapes && !mShapeShaders)
+        fprintf(stderr, "ERROR: Failed to create the shape shaders, "
+                        "tessellating shapes instead!\n");
+    analyticShapes = mAnalyticShapes && mShapeShaders;
 
     createFontTexture();
 
@@ -534,12 +708,30 @@ bool D3D12ImGuiManager::createDeviceObjects()
 
 void D3D12ImGuiManager::createFontTexture()
 {
+    XGFX_TRACE_SCOPE("D3D12ImGuiManager::createFontTexture");
+    ImGuiContextScope scope(context);
+
     // Build texture atlas
     ImGuiIO& io = ImGui::GetIO();
     ImGuiD3D12Data* bd = GetBackendData();
     unsigned char* pixels;
     int width, height;
-    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    int bytesPerPixel = 4;
+    std::vector<unsigned char> field;
+    if (bd->pSdfPipelineState)
+    {
+        // A single channel texture, the shader reads the field from red
+        buildFontDistanceField(io.Fonts, mFontSdfSpread, field, width,
+                               height);
+        pixels = field.data();
+        format = DXGI_FORMAT_R8_UNORM;
+        bytesPerPixel = 1;
+    }
+    else
+    {
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    }
 
     // Upload texture to graphics system
     {
@@ -557,7 +749,7 @@ void D3D12ImGuiManager::createFontTexture()
         desc.Height = height;
         desc.DepthOrArraySize = 1;
         desc.MipLevels = 1;
-        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.Format = format;
         desc.SampleDesc.Count = 1;
         desc.SampleDesc.Quality = 0;
         desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
@@ -568,8 +760,9 @@ void D3D12ImGuiManager::createFontTexture()
             &props, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST,
             nullptr, IID_PPV_ARGS(&pTexture));
 
+        UINT rowBytes = width * bytesPerPixel;
         UINT uploadPitch =
-            (width * 4 + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1u) &
+            (rowBytes + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1u) &
             ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1u);
         UINT uploadSize = height * uploadPitch;
         desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
@@ -601,14 +794,13 @@ void D3D12ImGuiManager::createFontTexture()
         IM_ASSERT(SUCCEEDED(hr));
         for (int y = 0; y < height; y++)
             memcpy((void*)((uintptr_t)mapped + y * uploadPitch),
-                   pixels + y * width * 4, width * 4);
+                   pixels + y * rowBytes, rowBytes);
         uploadBuffer->Unmap(0, &range);
 
         D3D12_TEXTURE_COPY_LOCATION srcLocation = {};
         srcLocation.pResource = uploadBuffer;
         srcLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-        srcLocation.PlacedFootprint.Footprint.Format =
-            DXGI_FORMAT_R8G8B8A8_UNORM;
+        srcLocation.PlacedFootprint.Footprint.Format = format;
         srcLocation.PlacedFootprint.Footprint.Width = width;
         srcLocation.PlacedFootprint.Footprint.Height = height;
         srcLocation.PlacedFootprint.Footprint.Depth = 1;
@@ -682,7 +874,7 @@ void D3D12ImGuiManager::createFontTexture()
         // Create texture view
         D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
         ZeroMemory(&srvDesc, sizeof(srvDesc));
-        srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        srvDesc.Format = format;
         srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
         srvDesc.Texture2D.MipLevels = desc.MipLevels;
         srvDesc.Texture2D.MostDetailedMip = 0;
@@ -717,4 +909,16 @@ void D3D12ImGuiManager::createFontTexture()
     io.Fonts->SetTexID((ImTextureID)bd->hFontSrvGpuDescHandle.ptr);
 }
 
+void D3D12ImGuiManager::setFontSdf(bool enabled, float spread)
+{
+    mFontSdf = enabled;
+    mFontSdfSpread = spread;
+}
+
+void D3D12ImGuiManager::setAnalyticShapes(bool enabled)
+{
+    mAnalyticShapes = enabled;
+    analyticShapes = enabled && mShapeShaders;
+}
+
 }
\ No newline at end of file
@@ -52,5 +52,23 @@ class D3D12ImGuiManager : public ImGuiManager
     void invalidateDeviceObjects();
 
     void createFontTexture();
+
+    // Bake the font atlas as a signed distance field so text stays crisp at
+    // any DPI or zoom without rebuilding the atlas. Load fonts at the largest
+    // size you display and scale them down, `spread` is the field's range in
+    // atlas texels. Its pixel shader is compiled with D3DCompile, set before
+    // createDeviceObjects().
+    void setFontSdf(bool enabled, float spread = 4.0f);
+
+    // Let addRect(), addCircle() and addLine() emit one quad per shape for
+    // the shaders to evaluate, reading its parameters back from the vertex
+    // buffer. The shaders are compiled with D3DCompile, set before
+    // createDeviceObjects().
+    void setAnalyticShapes(bool enabled);
+
+    bool mFontSdf = false;
+    float mFontSdfSpread = 4.0f;
+    bool mAnalyticShapes = false;
+    bool mShapeShaders = false;
 };
 }
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace xgfx
+{
+// Bounded lock-free queue for any number of producer threads and a single
+// consumer. Each slot carries a sequence number telling producers and the
+// consumer whose turn it is, so neither side ever blocks the other.
+template <typename T>
+class EventQueue
+{
+  public:
+    // `capacity` is rounded up to a power of two.
+    explicit EventQueue(size_t capacity = 1024)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        mMask = size - 1;
+        mCells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++)
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    // Safe from any thread. Returns false and drops `value` when full.
+    bool push(const T& value)
+    {
+        size_t pos = mTail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = mCells[pos & mMask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (diff == 0)
+            {
+                if (mTail.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = mTail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer thread only. Returns false when empty.
+    bool pop(T& value)
+    {
+        Cell& cell = mCells[mHead & mMask];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (seq != mHead + 1) return false;
+        value = cell.value;
+        cell.sequence.store(mHead + mMask + 1, std::memory_order_release);
+        mHead++;
+        return true;
+    }
+
+  private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> mCells;
+    size_t mMask = 0;
+
+    // Padded apart so producers and the consumer don't contend on a cache
+    // line
+    char mPad0[64];
+    std::atomic<size_t> mTail{0};
+    char mPad1[64];
+    size_t mHead = 0;
+};
+}
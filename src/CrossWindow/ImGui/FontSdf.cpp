@@ -0,0 +1,162 @@
+#include "FontSdf.h"
+#include "imgui.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XGFX_SDF_SSE2 1
+#endif
+
+namespace xgfx
+{
+namespace
+{
+const float kInf = 1e20f;
+
+// Felzenszwalb & Huttenlocher's 1D squared distance transform of `f` into
+// `d`, using `v` and `z` as scratch space.
+void distanceTransform1D(const float* f, float* d, int n, int* v, float* z)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -kInf;
+    z[1] = kInf;
+    for (int q = 1; q < n; q++)
+    {
+        float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) /
+                  (2.0f * q - 2.0f * v[k]);
+        while (s <= z[k])
+        {
+            k--;
+            s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) /
+                (2.0f * q - 2.0f * v[k]);
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = kInf;
+    }
+    k = 0;
+    for (int q = 0; q < n; q++)
+    {
+        while (z[k + 1] < q)
+            k++;
+        float dq = static_cast<float>(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+// Squared distance of every texel to the nearest seed texel (grid == 0).
+void distanceTransform2D(std::vector<float>& grid, int width, int height)
+{
+    int n = std::max(width, height);
+    std::vector<float> f(n), d(n), z(n + 1);
+    std::vector<int> v(n);
+
+    for (int x = 0; x < width; x++)
+    {
+        for (int y = 0; y < height; y++)
+            f[y] = grid[y * width + x];
+        distanceTransform1D(f.data(), d.data(), height, v.data(), z.data());
+        for (int y = 0; y < height; y++)
+            grid[y * width + x] = d[y];
+    }
+    for (int y = 0; y < height; y++)
+    {
+        float* row = &grid[y * width];
+        std::copy(row, row + width, f.begin());
+        distanceTransform1D(f.data(), row, width, v.data(), z.data());
+    }
+}
+}
+
+void buildDistanceField(unsigned char* pixels, int width, int height,
+                        float spread)
+{
+    size_t count = static_cast<size_t>(width) * height;
+    std::vector<float> toInside(count), toOutside(count), coverage(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        bool inside = pixels[i] >= 128;
+        toInside[i] = inside ? 0.0f : kInf;
+        toOutside[i] = inside ? kInf : 0.0f;
+        coverage[i] = pixels[i] / 255.0f;
+    }
+    distanceTransform2D(toInside, width, height);
+    distanceTransform2D(toOutside, width, height);
+
+    // Signed distance in texels, positive inside. Texel centers sit half a
+    // texel from the edge between them; partially covered texels use their
+    // coverage for a sub-texel estimate instead. Only this step is SIMD, the
+    // transforms above walk each line's lower envelope one texel at a time.
+    const float scale = 0.5f / spread;
+    size_t i = 0;
+#if defined(XGFX_SDF_SSE2)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 byteMax = _mm_set1_ps(255.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 din = _mm_sqrt_ps(_mm_loadu_ps(&toOutside[i]));
+        __m128 dout = _mm_sqrt_ps(_mm_loadu_ps(&toInside[i]));
+        __m128 dist = _mm_sub_ps(din, dout);
+        dist = _mm_add_ps(dist, _mm_and_ps(_mm_cmpgt_ps(dout, zero),
+                                           half));
+        dist = _mm_sub_ps(dist, _mm_and_ps(_mm_cmpgt_ps(din, zero), half));
+
+        __m128 cov = _mm_loadu_ps(&coverage[i]);
+        __m128 edge = _mm_and_ps(_mm_cmpgt_ps(cov, zero), _mm_cmplt_ps(cov, one));
+        dist = _mm_or_ps(_mm_and_ps(edge, _mm_sub_ps(cov, half)),
+                         _mm_andnot_ps(edge, dist));
+
+        __m128 value = _mm_add_ps(half, _mm_mul_ps(dist, vscale));
+        value = _mm_min_ps(_mm_max_ps(value, zero), one);
+        __m128i ints = _mm_cvtps_epi32(_mm_mul_ps(value, byteMax));
+        ints = _mm_packs_epi32(ints, ints);
+        ints = _mm_packus_epi16(ints, ints);
+        int packed = _mm_cvtsi128_si32(ints);
+        std::memcpy(pixels + i, &packed, 4);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float din = std::sqrt(toOutside[i]);
+        float dout = std::sqrt(toInside[i]);
+        float dist = din - dout;
+        if (dout > 0.0f) dist += 0.5f;
+        if (din > 0.0f) dist -= 0.5f;
+        if (coverage[i] > 0.0f && coverage[i] < 1.0f)
+            dist = coverage[i] - 0.5f;
+        float value = std::min(std::max(0.5f + dist * scale, 0.0f), 1.0f);
+        pixels[i] = static_cast<unsigned char>(std::lround(value * 255.0f));
+    }
+}
+
+void buildFontDistanceField(ImFontAtlas* atlas, float spread,
+                            std::vector<unsigned char>& pixels, int& width,
+                            int& height)
+{
+    // Clearing the atlas's pixels makes GetTexDataAsAlpha8() build it again
+    const int flags =
+        ImFontAtlasFlags_NoBakedLines | ImFontAtlasFlags_NoMouseCursors;
+    const int padding = (int)std::ceil(spread);
+    if ((atlas->Flags & flags) != flags || atlas->TexGlyphPadding < padding)
+    {
+        atlas->Flags |= flags;
+        atlas->TexGlyphPadding = std::max(atlas->TexGlyphPadding, padding);
+        atlas->ClearTexData();
+    }
+
+    unsigned char* coverage;
+    atlas->GetTexDataAsAlpha8(&coverage, &width, &height);
+    pixels.assign(coverage, coverage + width * height);
+    buildDistanceField(pixels.data(), width, height, spread);
+}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+struct ImFontAtlas;
+
+namespace xgfx
+{
+// Convert an 8-bit coverage atlas into a signed distance field in place.
+// 128 lies on the glyph edge, and `spread` is the distance in texels mapped
+// to the full 0-255 range on either side. Glyphs need at least `spread`
+// texels of padding between them. The final combine step runs four texels
+// at a time with SSE2, the two distance transforms before it are scalar.
+void buildDistanceField(unsigned char* pixels, int width, int height,
+                        float spread);
+
+// Bake `atlas` into `pixels` as a single channel distance field. Baked lines
+// and mouse cursors are drawn as images, which a field can't represent, and
+// glyphs need padding for it to fade out, so an atlas already built without
+// them is built again.
+void buildFontDistanceField(ImFontAtlas* atlas, float spread,
+                            std::vector<unsigned char>& pixels, int& width,
+                            int& height);
+}
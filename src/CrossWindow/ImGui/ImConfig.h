@@ -0,0 +1,8 @@
+#pragma once
+
+// ImGui user config used with XGFX_IMGUI_THREADED_CONTEXTS. Makes ImGui's
+// current context thread local, so managers on different threads can each
+// build and render their UI at the same time.
+struct ImGuiContext;
+extern thread_local ImGuiContext* XgfxImGuiContext;
+#define GImGui XgfxImGuiContext
@@ -1,7 +1,22 @@
 #include "ImGuiManager.h"
+#include "Trace.h"
+#include "WorkerPool.h"
 #include "imgui.h"
+#include "imgui_internal.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+// Clip rects are projected four components at a time where SSE2 is baseline
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XGFX_IMGUI_SSE2 1
+#endif
 
 namespace
 {
@@ -11,12 +26,214 @@ std::string str_tolower(std::string s)
                    [](unsigned char c) { return std::tolower(c); });
     return s;
 }
+
+// Append the rectangles a window's background is guaranteed to cover
+// opaquely, or nothing if we can't be sure it's opaque.
+void addWindowOccluders(const ImGuiWindow* window, const ImDrawList* drawList,
+                        std::vector<ImVec4>& out)
+{
+    if (window->Collapsed || (window->Flags & ImGuiWindowFlags_NoBackground) ||
+        drawList->VtxBuffer.Size == 0 || drawList->CmdBuffer.Size == 0)
+        return;
+
+    const ImGuiStyle& style = ImGui::GetStyle();
+    ImGuiWindowFlags flags = window->Flags;
+    int bgColor = ImGuiCol_WindowBg;
+    float rounding = style.WindowRounding;
+    if (flags & (ImGuiWindowFlags_Tooltip | ImGuiWindowFlags_Popup))
+    {
+        bgColor = ImGuiCol_PopupBg;
+        rounding = style.PopupRounding;
+    }
+    else if (flags & ImGuiWindowFlags_ChildWindow)
+    {
+        bgColor = ImGuiCol_ChildBg;
+        rounding = style.ChildRounding;
+    }
+    if (style.Alpha < 1.0f || style.Colors[bgColor].w < 1.0f) return;
+
+    // The title bar is covered by the window rect too
+    if (!(flags & ImGuiWindowFlags_NoTitleBar) &&
+        (style.Colors[ImGuiCol_TitleBg].w < 1.0f ||
+         style.Colors[ImGuiCol_TitleBgActive].w < 1.0f))
+        return;
+
+    // The background is the first thing drawn in a window. If the first
+    // vertex doesn't carry the background color, something like
+    // SetNextWindowBgAlpha() overrode it this frame.
+    const ImU32 expected = ImGui::GetColorU32(bgColor);
+    if (drawList->VtxBuffer[0].col != expected) return;
+
+    // The background is clipped like the window's first command, which
+    // matters for child windows scrolled partially out of their parent
+    const ImVec4& clip = drawList->CmdBuffer[0].ClipRect;
+    ImVec4 rect(ImMax(window->Pos.x, clip.x), ImMax(window->Pos.y, clip.y),
+                ImMin(window->Pos.x + window->Size.x, clip.z),
+                ImMin(window->Pos.y + window->Size.y, clip.w));
+    if (rect.z <= rect.x || rect.w <= rect.y) return;
+
+    // Rounded corners aren't covered, so use the two bands that avoid them
+    if (rounding > 0.0f)
+    {
+        float x0 = window->Pos.x + rounding;
+        float x1 = window->Pos.x + window->Size.x - rounding;
+        float y0 = window->Pos.y + rounding;
+        float y1 = window->Pos.y + window->Size.y - rounding;
+        ImVec4 vband(ImMax(rect.x, x0), rect.y, ImMin(rect.z, x1), rect.w);
+        ImVec4 hband(rect.x, ImMax(rect.y, y0), rect.z, ImMin(rect.w, y1));
+        if (vband.z > vband.x) out.push_back(vband);
+        if (hband.w > hband.y) out.push_back(hband);
+    }
+    else
+    {
+        out.push_back(rect);
+    }
+}
 }
 
 namespace xgfx
 {
+bool trimClipRect(ImVec4& clip, const ImVec4& occluder)
+{
+    if (occluder.x >= clip.z || occluder.z <= clip.x ||
+        occluder.y >= clip.w || occluder.w <= clip.y)
+        return true;
+
+    bool spansX = occluder.x <= clip.x && occluder.z >= clip.z;
+    bool spansY = occluder.y <= clip.y && occluder.w >= clip.w;
+    if (spansX && spansY) return false;
+    if (spansX)
+    {
+        if (occluder.y <= clip.y)
+            clip.y = occluder.w;
+        else if (occluder.w >= clip.w)
+            clip.w = occluder.y;
+    }
+    else if (spansY)
+    {
+        if (occluder.x <= clip.x)
+            clip.x = occluder.z;
+        else if (occluder.z >= clip.z)
+            clip.z = occluder.x;
+    }
+    return clip.z > clip.x && clip.w > clip.y;
+}
+}
+
+#if defined(XGFX_IMGUI_THREADED_CONTEXTS)
+// ImGui's current context, redirected here by ImConfig.h
+thread_local ImGuiContext* XgfxImGuiContext = nullptr;
+#endif
+
+namespace xgfx
+{
+namespace
+{
+// Tooltip and hover delays in ImGui are all shorter than this, so a hovered
+// item is polled at a low rate until its timer passes it
+const float kHoverDelayHorizon = 1.0f;
+const double kHoverPollInterval = 1.0 / 20.0;
+
+// InputText cursor blink period and the time it stays visible in it
+const float kCursorBlinkPeriod = 1.20f;
+const float kCursorBlinkOn = 0.80f;
+
+// Buffers smaller than this aren't worth trimming for their excess alone
+const size_t kTrimMinBytes = 16 * 1024;
+
+template <typename T>
+size_t vectorBytes(const ImVector<T>& v)
+{
+    return (size_t)v.Capacity * sizeof(T);
+}
+
+size_t drawListBytes(const ImDrawList* list)
+{
+    size_t bytes = vectorBytes(list->CmdBuffer) +
+                   vectorBytes(list->IdxBuffer) +
+                   vectorBytes(list->VtxBuffer) +
+                   vectorBytes(list->_ClipRectStack) +
+                   vectorBytes(list->_TextureIdStack) +
+                   vectorBytes(list->_Path) +
+                   vectorBytes(list->_Splitter._Channels);
+    for (const ImDrawChannel& channel : list->_Splitter._Channels)
+        bytes +=
+            vectorBytes(channel._CmdBuffer) + vectorBytes(channel._IdxBuffer);
+    return bytes;
+}
+
+// Reallocate a vector to fit its contents, keeping them
+template <typename T>
+void shrinkVector(ImVector<T>& v, xgfx::ImGuiTrimPolicy policy)
+{
+    if (v.Capacity <= v.Size) return;
+    if (policy == xgfx::ImGuiTrimPolicy::Excess &&
+        (v.Capacity <= v.Size * 2 || vectorBytes(v) < kTrimMinBytes))
+        return;
+    ImVector<T> fit;
+    fit.reserve(v.Size);
+    if (v.Size) memcpy(fit.Data, v.Data, (size_t)v.Size * sizeof(T));
+    fit.Size = v.Size;
+    v.swap(fit);
+}
+
+template <typename T>
+void shrinkVector(std::vector<T>& v, xgfx::ImGuiTrimPolicy policy)
+{
+    if (policy == xgfx::ImGuiTrimPolicy::Excess &&
+        (v.capacity() <= v.size() * 2 ||
+         v.capacity() * sizeof(T) < kTrimMinBytes))
+        return;
+    v.shrink_to_fit();
+}
+
+// Lists are trimmed between frames, where the path and the channels are
+// unused and the write pointers get reset before their next use.
+void trimDrawList(ImDrawList* list, xgfx::ImGuiTrimPolicy policy)
+{
+    shrinkVector(list->CmdBuffer, policy);
+    shrinkVector(list->IdxBuffer, policy);
+    shrinkVector(list->VtxBuffer, policy);
+    list->_Path.clear();
+    if (list->_Splitter._Count <= 1) list->_Splitter.ClearFreeMemory();
+}
+}
+
+ImGuiContextScope::ImGuiContextScope(ImGuiContext* context)
+    : mPrevious(ImGui::GetCurrentContext()),
+      mSwapped(context && context != mPrevious)
+{
+    if (mSwapped) ImGui::SetCurrentContext(context);
+}
+
+ImGuiContextScope::~ImGuiContextScope()
+{
+    if (mSwapped) ImGui::SetCurrentContext(mPrevious);
+}
+
+ImGuiManager::~ImGuiManager()
+{
+    if (context) ImGui::DestroyContext(context);
+}
+
+ImGuiContext* ImGuiManager::getContext() const { return context; }
+
+void ImGuiManager::makeCurrent() const
+{
+    if (context) ImGui::SetCurrentContext(context);
+}
+
+WorkerPool& ImGuiManager::getWorkerPool()
+{
+    if (!workerPool) workerPool.reset(new WorkerPool());
+    return *workerPool;
+}
+
 void ImGuiManager::create()
 {
+    context = ImGui::CreateContext();
+    ImGui::SetCurrentContext(context);
+
     // Map ImGui inputs to CrossWindow
     ImGuiIO& io = ImGui::GetIO();
     io.KeyMap[ImGuiKey_Tab] = static_cast<size_t>(xwin::Key::Tab);
@@ -138,27 +355,49 @@ void ImGuiManager::create()
 
 void ImGuiManager::updateEvent(xwin::Event e)
 {
+    XGFX_TRACE_SCOPE("ImGuiManager::updateEvent");
+    ImGuiContextScope scope(context);
     ImGuiIO& io = ImGui::GetIO();
 
     if (e.type == xwin::EventType::Resize)
     {
-        if (e.data.resize.resizing)
+        if (e.data.resize.resizing && !liveResize)
         {
             return;
         }
+        requestRedraw();
         float x = static_cast<float>(e.data.resize.width);
         float y = static_cast<float>(e.data.resize.height);
-        io.DisplaySize.x = x / io.DisplayFramebufferScale.x;
-        io.DisplaySize.y = y / io.DisplayFramebufferScale.y;
+        ImVec2 size(x / io.DisplayFramebufferScale.x,
+                    y / io.DisplayFramebufferScale.y);
+
+        // Mid-drag sizes are applied by beginFrame() at the relayout rate
+        if (e.data.resize.resizing)
+        {
+            pendingDisplaySize = size;
+            resizePending = true;
+        }
+        else
+        {
+            io.DisplaySize = size;
+            resizePending = false;
+        }
     }
     if (e.type == xwin::EventType::DPI)
     {
+        requestRedraw();
         float dpiScale = e.data.dpi.scale;
         io.DisplayFramebufferScale = ImVec2(dpiScale, dpiScale);
     }
 
+    if (e.type == xwin::EventType::Focus || e.type == xwin::EventType::Paint)
+    {
+        requestRedraw();
+    }
+
     if (e.type == xwin::EventType::MouseInput)
     {
+        requestRedraw();
         xwin::MouseInputData& mid = e.data.mouseInput;
 
         if (mid.state == xwin::ButtonState::Pressed)
@@ -173,6 +412,7 @@ void ImGuiManager::updateEvent(xwin::Event e)
 
     if (e.type == xwin::EventType::MouseMove)
     {
+        requestRedraw();
         xwin::MouseMoveData mmd = e.data.mouseMove;
 
         io.MousePos =
@@ -182,12 +422,14 @@ void ImGuiManager::updateEvent(xwin::Event e)
 
     if (e.type == xwin::EventType::MouseWheel)
     {
+        requestRedraw();
         xwin::MouseWheelData& mwd = e.data.mouseWheel;
         io.MouseWheel += static_cast<float>(mwd.delta);
     }
 
     if (e.type == xwin::EventType::Keyboard)
     {
+        requestRedraw();
         xwin::KeyboardData& kd = e.data.keyboard;
         size_t kid = static_cast<size_t>(kd.key);
         if (kid < 256)
@@ -220,4 +462,558 @@ const std::string& ImGuiManager::getCharacterBuffer() const
 }
 
 void ImGuiManager::clearCharacterBuffer() { charBuf.clear(); }
+
+const ImGuiFrameStats& ImGuiManager::getFrameStats() const
+{
+    return frameStats;
+}
+
+bool ImGuiManager::checkFrameBudget(const ImGuiFrameBudget& budget,
+                                   const char* label) const
+{
+    bool within = true;
+    if (budget.drawCalls && frameStats.drawCalls > budget.drawCalls)
+    {
+        fprintf(stderr, "%s: %u draw calls, budget is %u\n", label,
+                frameStats.drawCalls, budget.drawCalls);
+        within = false;
+    }
+    if (budget.bytesUploaded && frameStats.bytesUploaded > budget.bytesUploaded)
+    {
+        fprintf(stderr, "%s: %zu bytes uploaded, budget is %zu\n", label,
+                frameStats.bytesUploaded, budget.bytesUploaded);
+        within = false;
+    }
+    if (budget.cpuTimeMs > 0.0 && frameStats.cpuTimeMs > budget.cpuTimeMs)
+    {
+        fprintf(stderr, "%s: %.3f ms CPU time, budget is %.3f ms\n", label,
+                frameStats.cpuTimeMs, budget.cpuTimeMs);
+        within = false;
+    }
+    return within;
+}
+
+void ImGuiManager::setOcclusionCulling(bool enabled)
+{
+    occlusionCulling = enabled;
+}
+
+ImGuiMemoryReport ImGuiManager::getMemoryReport() const
+{
+    ImGuiMemoryReport report;
+    measureMemory(report, true);
+    return report;
+}
+
+void ImGuiManager::measureMemory(ImGuiMemoryReport& report,
+                                 bool perList) const
+{
+    report.stagingBytes = stagingBytes();
+    if (context)
+    {
+        ImGuiContext& g = *context;
+        for (ImGuiWindow* window : g.Windows)
+        {
+            size_t bytes = drawListBytes(window->DrawList);
+            report.drawListBytes += bytes;
+            if (perList) report.drawLists.push_back({window->Name, bytes});
+        }
+
+        // Pixels are only kept until they're freed, fonts are kept for
+        // rebuilding the atlas
+        const ImFontAtlas* atlas = g.IO.Fonts;
+        size_t texels = (size_t)atlas->TexWidth * atlas->TexHeight;
+        if (atlas->TexPixelsAlpha8) report.fontAtlasBytes += texels;
+        if (atlas->TexPixelsRGBA32) report.fontAtlasBytes += texels * 4;
+        for (const ImFontConfig& config : atlas->ConfigData)
+            if (config.FontDataOwnedByAtlas)
+                report.fontAtlasBytes += (size_t)config.FontDataSize;
+    }
+    std::sort(report.drawLists.begin(), report.drawLists.end(),
+              [](const ImGuiMemoryReport::DrawList& a,
+                 const ImGuiMemoryReport::DrawList& b) {
+                  return a.bytes > b.bytes;
+              });
+    report.totalBytes =
+        report.drawListBytes + report.fontAtlasBytes + report.stagingBytes;
+}
+
+void ImGuiManager::trimMemory(ImGuiTrimPolicy policy)
+{
+    XGFX_TRACE_SCOPE("ImGuiManager::trimMemory");
+    trimStaging(policy);
+    if (!context) return;
+
+    ImGuiContext& g = *context;
+    for (ImGuiWindow* window : g.Windows)
+        trimDrawList(window->DrawList, policy);
+
+    // The texture has the pixels now, ImGui rebuilds them if they're asked
+    // for again
+    if (policy == ImGuiTrimPolicy::All && g.IO.Fonts->TexID)
+        g.IO.Fonts->ClearTexData();
+}
+
+void ImGuiManager::setMemoryBudget(size_t bytes, ImGuiTrimPolicy policy)
+{
+    memoryBudget = bytes;
+    memoryBudgetPolicy = policy;
+}
+
+size_t ImGuiManager::stagingBytes() const
+{
+    return renderOps.capacity() * sizeof(ImGuiRenderOp) +
+           occluders.capacity() * sizeof(ImVec4) +
+           culledClipRects.capacity() * sizeof(ImVec4) +
+           culledListStarts.capacity() * sizeof(int) + charBuf.capacity();
+}
+
+void ImGuiManager::trimStaging(ImGuiTrimPolicy policy)
+{
+    shrinkVector(renderOps, policy);
+    shrinkVector(occluders, policy);
+    shrinkVector(culledClipRects, policy);
+    shrinkVector(culledListStarts, policy);
+}
+
+bool ImGuiManager::queueEvent(const xwin::Event& e)
+{
+    return eventQueue.push(e);
+}
+
+bool ImGuiManager::beginFrame()
+{
+    makeCurrent();
+    xwin::Event e;
+    while (eventQueue.pop(e))
+        updateEvent(e);
+
+    if (memoryBudget)
+    {
+        ImGuiMemoryReport report;
+        measureMemory(report, false);
+        if (report.totalBytes <= memoryBudget)
+        {
+            overBudgetFrames = 0;
+            memoryTrimFloor = 0;
+        }
+        else if (++overBudgetFrames >= kOverBudgetFrames &&
+                 report.totalBytes > memoryTrimFloor)
+        {
+            trimMemory(memoryBudgetPolicy);
+            ImGuiMemoryReport trimmed;
+            measureMemory(trimmed, false);
+            memoryTrimFloor = trimmed.totalBytes < report.totalBytes
+                                  ? 0
+                                  : trimmed.totalBytes;
+            overBudgetFrames = 0;
+        }
+    }
+
+    if (resizePending)
+    {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed =
+            std::chrono::duration<double>(now - lastRelayout).count();
+        if (elapsed < relayoutInterval && ImGui::GetDrawData())
+        {
+            reusingFrame = true;
+            return false;
+        }
+        ImGui::GetIO().DisplaySize = pendingDisplaySize;
+        resizePending = false;
+        lastRelayout = now;
+    }
+    reusingFrame = false;
+
+    if (pendingFrames > 0) pendingFrames--;
+    ImGui::NewFrame();
+    return true;
+}
+
+void ImGuiManager::setLiveResize(bool enabled, bool stretch,
+                                 double interval)
+{
+    liveResize = enabled;
+    stretchStaleFrames = stretch;
+    relayoutInterval = interval;
+}
+
+void ImGuiManager::requestRedraw() { pendingFrames = kSettleFrames; }
+
+double ImGuiManager::nextFrameDeadline() const
+{
+    if (pendingFrames > 0) return 0.0;
+
+    ImGuiContextScope scope(context);
+    ImGuiContext& g = *ImGui::GetCurrentContext();
+    ImGuiIO& io = g.IO;
+
+    // Ctrl+Tab highlight and modal dimming fade in over several frames
+    if (g.NavWindowingTarget || (g.DimBgRatio > 0.0f && g.DimBgRatio < 1.0f))
+        return 0.0;
+
+    double deadline = std::numeric_limits<double>::infinity();
+
+    // A throttled resize is applied at the next relayout
+    if (resizePending)
+    {
+        double elapsed = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - lastRelayout)
+                             .count();
+        deadline = std::max(relayoutInterval - elapsed, 0.0);
+    }
+
+    // Held keys and buttons repeat without sending new events
+    bool held = false;
+    for (int i = 0; i < IM_ARRAYSIZE(io.MouseDown) && !held; i++)
+        held = io.MouseDown[i];
+    for (int i = 0; i < IM_ARRAYSIZE(io.KeysDown) && !held; i++)
+        held = io.KeysDown[i];
+    if (held) deadline = std::min(deadline, double(io.KeyRepeatRate));
+
+    // Wake up for the next cursor blink of an active text field
+    if (g.ActiveId != 0 && g.InputTextState.ID == g.ActiveId &&
+        io.ConfigInputTextCursorBlink)
+    {
+        float t = std::fmod(g.InputTextState.CursorAnim, kCursorBlinkPeriod);
+        float next = t < kCursorBlinkOn ? kCursorBlinkOn - t
+                                        : kCursorBlinkPeriod - t;
+        deadline = std::min(deadline, double(next));
+    }
+
+    // Tooltips appear after a hover delay without any new input
+    if (g.HoveredId != 0 && g.HoveredIdTimer < kHoverDelayHorizon)
+        deadline = std::min(deadline, kHoverPollInterval);
+
+    return deadline;
+}
+
+ImVec2 ImGuiManager::framebufferSize(const ImDrawData* drawData) const
+{
+    if (reusingFrame)
+    {
+        const ImVec2& scale = ImGui::GetIO().DisplayFramebufferScale;
+        return ImVec2(pendingDisplaySize.x * scale.x,
+                      pendingDisplaySize.y * scale.y);
+    }
+    return ImVec2(drawData->DisplaySize.x * drawData->FramebufferScale.x,
+                  drawData->DisplaySize.y * drawData->FramebufferScale.y);
+}
+
+ImVec2 ImGuiManager::framebufferScale(const ImDrawData* drawData) const
+{
+    if (reusingFrame && stretchStaleFrames && drawData->DisplaySize.x > 0.0f &&
+        drawData->DisplaySize.y > 0.0f)
+    {
+        ImVec2 size = framebufferSize(drawData);
+        return ImVec2(size.x / drawData->DisplaySize.x,
+                      size.y / drawData->DisplaySize.y);
+    }
+    return drawData->FramebufferScale;
+}
+
+bool ImGuiBufferSizer::update(int count)
+{
+    int size = kMinCapacity;
+    while (size < count)
+        size *= 2;
+    if (size > capacity)
+    {
+        capacity = size;
+        lowFrames = 0;
+        lowPeak = 0;
+        return true;
+    }
+    if (count >= capacity / 4)
+    {
+        lowFrames = 0;
+        lowPeak = 0;
+        return false;
+    }
+    lowPeak = std::max(lowPeak, size);
+    if (++lowFrames < kShrinkFrames) return false;
+    bool shrunk = lowPeak < capacity;
+    capacity = lowPeak;
+    lowFrames = 0;
+    lowPeak = 0;
+    return shrunk;
+}
+
+void ImGuiBufferSizer::reset()
+{
+    capacity = 0;
+    lowFrames = 0;
+    lowPeak = 0;
+}
+
+ImTextureID ImGuiManager::createTexture(int width, int height)
+{
+    return nullptr;
+}
+
+void ImGuiManager::updateTexture(ImTextureID texture, int x, int y,
+                                 int width, int height, const uint8_t* pixels)
+{
+}
+
+void ImGuiManager::destroyTexture(ImTextureID texture) {}
+
+namespace
+{
+// Shape corners carry their index in the UV, far outside any texture
+// coordinate, and are followed by a vertex holding the half size, rounding
+// and thickness. It's kept referenced by a degenerate triangle so it stays
+// right after the corners however the backend repacks vertices.
+const float kShapeCorner = -65536.0f;
+
+void addShape(ImDrawList* drawList, const ImVec2& center, const ImVec2& axis,
+              const ImVec2& halfSize, float rounding, float thickness,
+              ImU32 col)
+{
+    // Cover the outer half of the stroke and a pixel of antialiasing, the
+    // shaders pad the shape's local coordinates the same way
+    float pad = thickness * 0.5f + 1.0f;
+    ImVec2 u(axis.x * (halfSize.x + pad), axis.y * (halfSize.x + pad));
+    ImVec2 v(-axis.y * (halfSize.y + pad), axis.x * (halfSize.y + pad));
+    const float sx[4] = {-1.0f, 1.0f, 1.0f, -1.0f};
+    const float sy[4] = {-1.0f, -1.0f, 1.0f, 1.0f};
+
+    drawList->PrimReserve(9, 5);
+    ImDrawIdx idx = (ImDrawIdx)drawList->_VtxCurrentIdx;
+    for (int c = 0; c < 4; c++)
+        drawList->PrimWriteVtx(ImVec2(center.x + u.x * sx[c] + v.x * sy[c],
+                                      center.y + u.y * sx[c] + v.y * sy[c]),
+                               ImVec2(0.0f, kShapeCorner - c), col);
+    drawList->PrimWriteVtx(halfSize, ImVec2(rounding, thickness), col);
+    const int indices[9] = {0, 1, 2, 0, 2, 3, 4, 4, 4};
+    for (int i : indices)
+        drawList->PrimWriteIdx((ImDrawIdx)(idx + i));
+}
+}
+
+void ImGuiManager::addRect(ImDrawList* drawList, const ImVec2& min,
+                           const ImVec2& max, ImU32 col, float rounding,
+                           float thickness)
+{
+    if ((col & IM_COL32_A_MASK) == 0) return;
+    if (!analyticShapes)
+    {
+        if (thickness > 0.0f)
+            drawList->AddRect(min, max, col, rounding, 0, thickness);
+        else
+            drawList->AddRectFilled(min, max, col, rounding);
+        return;
+    }
+
+    // Outlines follow the pixel centers inside the rect, like ImGui's
+    float inset = thickness > 0.0f ? 0.5f : 0.0f;
+    ImVec2 half_size((max.x - min.x) * 0.5f - inset,
+                     (max.y - min.y) * 0.5f - inset);
+    if (half_size.x <= 0.0f || half_size.y <= 0.0f) return;
+    rounding = std::min(rounding, std::min(half_size.x, half_size.y));
+    addShape(drawList,
+             ImVec2((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f),
+             ImVec2(1.0f, 0.0f), half_size, std::max(rounding, 0.0f),
+             thickness, col);
+}
+
+void ImGuiManager::addCircle(ImDrawList* drawList, const ImVec2& center,
+                             float radius, ImU32 col, float thickness)
+{
+    if ((col & IM_COL32_A_MASK) == 0 || radius < 0.5f) return;
+    if (!analyticShapes)
+    {
+        if (thickness > 0.0f)
+            drawList->AddCircle(center, radius, col, 0, thickness);
+        else
+            drawList->AddCircleFilled(center, radius, col);
+        return;
+    }
+    if (thickness > 0.0f) radius -= 0.5f;
+    addShape(drawList, center, ImVec2(1.0f, 0.0f), ImVec2(radius, radius),
+             radius, thickness, col);
+}
+
+void ImGuiManager::addLine(ImDrawList* drawList, const ImVec2& a,
+                           const ImVec2& b, ImU32 col, float thickness)
+{
+    if ((col & IM_COL32_A_MASK) == 0) return;
+    if (!analyticShapes)
+    {
+        drawList->AddLine(a, b, col, thickness);
+        return;
+    }
+
+    // A butt capped segment through the pixel centers is a rect along it
+    ImVec2 d(b.x - a.x, b.y - a.y);
+    float length = sqrtf(d.x * d.x + d.y * d.y);
+    if (length <= 0.0f) return;
+    addShape(drawList,
+             ImVec2((a.x + b.x) * 0.5f + 0.5f, (a.y + b.y) * 0.5f + 0.5f),
+             ImVec2(d.x / length, d.y / length),
+             ImVec2(length * 0.5f, thickness * 0.5f), 0.0f, 0.0f, col);
+}
+
+void ImGuiManager::recordBufferBytes(size_t bytes)
+{
+    peakBufferBytes = std::max(peakBufferBytes, bytes);
+    frameStats.bufferBytes = bytes;
+    frameStats.peakBufferBytes = peakBufferBytes;
+}
+
+void ImGuiManager::compileRenderOps(const ImDrawList* cmdList,
+                                    const ImVec2& clipOffset,
+                                    const ImVec2& clipScale,
+                                    const ImVec2& fbSize, int vtxOffset,
+                                    int idxOffset,
+                                    std::vector<ImGuiRenderOp>& ops,
+                                    const ImVec4* clipRects)
+{
+#if defined(XGFX_IMGUI_SSE2)
+    const __m128 offset =
+        _mm_setr_ps(clipOffset.x, clipOffset.y, clipOffset.x, clipOffset.y);
+    const __m128 scale =
+        _mm_setr_ps(clipScale.x, clipScale.y, clipScale.x, clipScale.y);
+    const __m128 bounds = _mm_setr_ps(fbSize.x, fbSize.y, fbSize.x, fbSize.y);
+    const __m128 zero = _mm_setzero_ps();
+#endif
+    for (int cmd_i = 0; cmd_i < cmdList->CmdBuffer.Size; cmd_i++)
+    {
+        const ImDrawCmd* pcmd = &cmdList->CmdBuffer[cmd_i];
+        ImGuiRenderOp op;
+        op.list = cmdList;
+        op.cmd = pcmd;
+        if (pcmd->UserCallback)
+        {
+            op.type = pcmd->UserCallback == ImDrawCallback_ResetRenderState
+                          ? ImGuiRenderOp::ResetRenderState
+                          : ImGuiRenderOp::Callback;
+            ops.push_back(op);
+            continue;
+        }
+        if (pcmd->ElemCount == 0) continue;
+
+        // Occluded commands were already counted by the culling pass
+        const ImVec4& rect = clipRects ? clipRects[cmd_i] : pcmd->ClipRect;
+        if (clipRects && (rect.z <= rect.x || rect.w <= rect.y)) continue;
+
+        // Project the clip rect into framebuffer space and clamp it there
+#if defined(XGFX_IMGUI_SSE2)
+        __m128 clip = _mm_loadu_ps(&rect.x);
+        clip = _mm_mul_ps(_mm_sub_ps(clip, offset), scale);
+        clip = _mm_min_ps(_mm_max_ps(clip, zero), bounds);
+        _mm_storeu_si128((__m128i*)op.scissor, _mm_cvttps_epi32(clip));
+#else
+        op.scissor[0] = (int)ImClamp((rect.x - clipOffset.x) * clipScale.x,
+                                     0.0f, fbSize.x);
+        op.scissor[1] = (int)ImClamp((rect.y - clipOffset.y) * clipScale.y,
+                                     0.0f, fbSize.y);
+        op.scissor[2] = (int)ImClamp((rect.z - clipOffset.x) * clipScale.x,
+                                     0.0f, fbSize.x);
+        op.scissor[3] = (int)ImClamp((rect.w - clipOffset.y) * clipScale.y,
+                                     0.0f, fbSize.y);
+#endif
+        if (op.scissor[2] <= op.scissor[0] || op.scissor[3] <= op.scissor[1])
+        {
+            frameStats.drawsClipped++;
+            continue;
+        }
+        op.type = ImGuiRenderOp::Draw;
+        op.texture = pcmd->TextureId;
+        op.idxOffset = pcmd->IdxOffset + idxOffset;
+        op.elemCount = pcmd->ElemCount;
+        op.vtxOffset = (int)pcmd->VtxOffset + vtxOffset;
+
+        // Commands split only by a texture change that was later undone,
+        // e.g. images remapped into a shared atlas, continue the last draw
+        if (!ops.empty())
+        {
+            ImGuiRenderOp& last = ops.back();
+            if (last.type == ImGuiRenderOp::Draw && last.list == cmdList &&
+                last.texture == op.texture &&
+                last.vtxOffset == op.vtxOffset &&
+                last.idxOffset + last.elemCount == op.idxOffset &&
+                memcmp(last.scissor, op.scissor, sizeof(op.scissor)) == 0)
+            {
+                last.elemCount += op.elemCount;
+                frameStats.drawsMerged++;
+                continue;
+            }
+        }
+        ops.push_back(op);
+    }
+}
+
+void ImGuiManager::compileRenderOps(const ImDrawData* drawData,
+                                    std::vector<ImGuiRenderOp>& ops)
+{
+    XGFX_TRACE_SCOPE("ImGuiManager::compileRenderOps");
+    ImVec2 fb_size = framebufferSize(drawData);
+    ImVec2 fb_scale = framebufferScale(drawData);
+    int vtx_offset = 0, idx_offset = 0;
+    for (int n = 0; n < drawData->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = drawData->CmdLists[n];
+        compileRenderOps(cmd_list, drawData->DisplayPos, fb_scale, fb_size,
+                         vtx_offset, idx_offset, ops, getCulledClipRects(n));
+        vtx_offset += cmd_list->VtxBuffer.Size;
+        idx_offset += cmd_list->IdxBuffer.Size;
+    }
+}
+
+void ImGuiManager::cullOccludedCommands(const ImDrawData* drawData)
+{
+    culledClipRects.clear();
+    culledListStarts.clear();
+    if (!occlusionCulling || drawData->CmdListsCount < 2) return;
+    XGFX_TRACE_SCOPE("ImGuiManager::cullOccludedCommands");
+
+    ImGuiContext& g = *ImGui::GetCurrentContext();
+    std::unordered_map<const ImDrawList*, const ImGuiWindow*> windows;
+    windows.reserve(g.Windows.Size);
+    for (int i = 0; i < g.Windows.Size; i++)
+        windows[g.Windows[i]->DrawList] = g.Windows[i];
+
+    // Lists are ordered back to front, so walk them front to back collecting
+    // the occluders of everything drawn on top of the current list
+    occluders.clear();
+    culledListStarts.assign(drawData->CmdListsCount, -1);
+    for (int n = drawData->CmdListsCount - 1; n >= 0; n--)
+    {
+        const ImDrawList* cmd_list = drawData->CmdLists[n];
+        if (!occluders.empty())
+        {
+            culledListStarts[n] = (int)culledClipRects.size();
+            for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+            {
+                const ImDrawCmd& cmd = cmd_list->CmdBuffer[cmd_i];
+                ImVec4 clip = cmd.ClipRect;
+                if (!cmd.UserCallback && cmd.ElemCount > 0)
+                {
+                    bool visible = true;
+                    for (size_t o = 0; o < occluders.size() && visible; o++)
+                        visible = trimClipRect(clip, occluders[o]);
+                    if (!visible)
+                    {
+                        clip = ImVec4(0.0f, 0.0f, 0.0f, 0.0f);
+                        frameStats.drawsOccluded++;
+                    }
+                }
+                culledClipRects.push_back(clip);
+            }
+        }
+
+        auto it = windows.find(cmd_list);
+        if (it != windows.end())
+            addWindowOccluders(it->second, cmd_list, occluders);
+    }
+}
+
+const ImVec4* ImGuiManager::getCulledClipRects(int list) const
+{
+    if (list >= (int)culledListStarts.size() || culledListStarts[list] < 0)
+        return nullptr;
+    return culledClipRects.data() + culledListStarts[list];
+}
 }
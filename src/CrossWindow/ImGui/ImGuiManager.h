@@ -1,24 +1,349 @@
 #pragma once
 
 #include "CrossWindow/Common/Event.h"
+#include "EventQueue.h"
+#include "WorkerPool.h"
+#include "imgui.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace xgfx
 {
+// Render statistics gathered during the last renderDrawData() call.
+struct ImGuiFrameStats
+{
+    unsigned vertexCount = 0;
+    unsigned indexCount = 0;
+    unsigned drawCalls = 0;
+    unsigned drawsClipped = 0;
+    unsigned drawsOccluded = 0;
+    // Adjacent commands sharing a texture and clip rect drawn as one.
+    unsigned drawsMerged = 0;
+    // Windows composited from an offscreen cache instead of redrawn.
+    unsigned cachedDraws = 0;
+    // Glyphs and rectangles drawn as instances instead of triangles.
+    unsigned instancedQuads = 0;
+    unsigned textureBinds = 0;
+    unsigned scissorChanges = 0;
+    size_t bytesUploaded = 0;
+    // Framebuffer bytes read back for screenshots and recording.
+    size_t bytesCaptured = 0;
+    unsigned bufferReallocations = 0;
+
+    // Bytes of vertex and index buffers allocated on the GPU, across every
+    // frame in flight, and the most allocated at once since init().
+    size_t bufferBytes = 0;
+    size_t peakBufferBytes = 0;
+    double cpuTimeMs = 0.0;
+
+    // GPU time spent on ImGui draws, resolved from timer queries a few frames
+    // after submission. Stays at zero for backends without timer queries.
+    double gpuTimeMs = 0.0;
+};
+
+// Limits on a frame's statistics, for catching performance regressions in
+// an application's own scripted scenes. Zero disables a limit.
+struct ImGuiFrameBudget
+{
+    unsigned drawCalls = 0;
+    size_t bytesUploaded = 0;
+    double cpuTimeMs = 0.0;
+};
+
+// How far trimMemory() goes.
+enum class ImGuiTrimPolicy
+{
+    // Shrink buffers holding more than twice what they currently use.
+    Excess,
+
+    // Also shrink every buffer to what it uses and drop the font atlas
+    // pixels kept after uploading them. ImGui rebuilds them if needed.
+    All
+};
+
+// CPU memory retained by a manager's ImGui context, in bytes.
+struct ImGuiMemoryReport
+{
+    struct DrawList
+    {
+        const char* window;
+        size_t bytes;
+    };
+
+    // Every window's draw list, largest first
+    std::vector<DrawList> drawLists;
+    size_t drawListBytes = 0;
+    size_t fontAtlasBytes = 0;
+
+    // Scratch buffers of the manager and its backend
+    size_t stagingBytes = 0;
+    size_t totalBytes = 0;
+};
+
+// Capacity policy for a streamed GPU buffer, in elements. Grows straight to
+// the power of two class a frame needs, and shrinks to the class of the
+// recent peak once usage has stayed under a quarter of the capacity for
+// kShrinkFrames frames. A spike doesn't pin its memory forever, and usage
+// hovering around a class boundary doesn't reallocate every frame.
+struct ImGuiBufferSizer
+{
+    static const int kMinCapacity = 1024;
+    static const int kShrinkFrames = 120;
+
+    int capacity = 0;
+    int lowFrames = 0;
+    int lowPeak = 0;
+
+    // Account for a frame using `count` elements. Returns true if the
+    // capacity changed.
+    bool update(int count);
+
+    void reset();
+};
+
+// A draw command compiled for the backends, with its clip rect already
+// projected into the framebuffer and clipped to it. Callbacks keep their list
+// and command so the backend can invoke them.
+struct ImGuiRenderOp
+{
+    enum Type : unsigned char
+    {
+        Draw,
+        Callback,
+        ResetRenderState
+    };
+
+    Type type;
+
+    // x0, y0, x1, y1 in framebuffer pixels from the top left corner
+    int scissor[4];
+    ImTextureID texture;
+    unsigned idxOffset;
+    unsigned elemCount;
+    int vtxOffset;
+    const ImDrawList* list;
+    const ImDrawCmd* cmd;
+};
+
+// Shrink `clip` by `occluder` where the result is still a rectangle. Returns
+// false when nothing of `clip` remains visible.
+bool trimClipRect(ImVec4& clip, const ImVec4& occluder);
+
+// Makes a context current on the calling thread for the lifetime of the
+// scope, restoring the previous one after. Does nothing for a null context.
+class ImGuiContextScope
+{
+  public:
+    explicit ImGuiContextScope(ImGuiContext* context);
+
+    ~ImGuiContextScope();
+
+    ImGuiContextScope(const ImGuiContextScope&) = delete;
+    ImGuiContextScope& operator=(const ImGuiContextScope&) = delete;
+
+  private:
+    ImGuiContext* mPrevious;
+    bool mSwapped;
+};
+
 class ImGuiManager
 {
   public:
+    virtual ~ImGuiManager();
+
+    // The ImGui context this manager created in init(). Every manager owns
+    // its own, and makes it current around its own calls.
+    ImGuiContext* getContext() const;
+
+    // Make this manager's context current on the calling thread, e.g. to
+    // build its UI after another manager's.
+    void makeCurrent() const;
+
     // Process a CrossWindow event with ImGui.
     void updateEvent(xwin::Event e);
 
+    // Queue an event for the next beginFrame() to process. Unlike
+    // updateEvent() this is safe to call from any thread, e.g. a separate
+    // message pump. Returns false if the queue is full and the event was
+    // dropped.
+    bool queueEvent(const xwin::Event& e);
+
     // Get the character buffer for the current ImGui context. Useful for
     // getting written strings.
     const std::string& getCharacterBuffer() const;
 
     void clearCharacterBuffer();
 
+    // Statistics of the last rendered frame.
+    const ImGuiFrameStats& getFrameStats() const;
+
+    // Check the last frame's statistics against a budget. Each exceeded limit
+    // is written to stderr, prefixed with `label`. Returns false if any was.
+    bool checkFrameBudget(const ImGuiFrameBudget& budget,
+                          const char* label = "ImGui") const;
+
+    // Measure the memory retained by this manager's context.
+    ImGuiMemoryReport getMemoryReport() const;
+
+    // Release memory kept from bigger frames, e.g. after a huge table
+    // scrolled out of view. Call between frames: the last frame's draw data
+    // stays valid, but the next frame may have to grow its buffers again.
+    void trimMemory(ImGuiTrimPolicy policy = ImGuiTrimPolicy::Excess);
+
+    // Trim memory with `policy` in beginFrame() once the retained total has
+    // exceeded `bytes` for a while. Zero disables the budget.
+    void setMemoryBudget(size_t bytes,
+                         ImGuiTrimPolicy policy = ImGuiTrimPolicy::Excess);
+
+    // Skip or trim draw commands hidden behind the opaque background of a
+    // window drawn later in the frame. Off by default.
+    void setOcclusionCulling(bool enabled);
+
+    // Start an ImGui frame. Use in place of ImGui::NewFrame() so the manager
+    // knows when pending input has been seen by the UI. Queued events are
+    // processed first. Leaves this manager's context current so the UI built
+    // after it goes to this manager. Returns false during
+    // a live resize between relayouts: skip building the UI and render
+    // ImGui::GetDrawData() again, it still holds last frame's lists.
+    bool beginFrame();
+
+    // Keep following the window while it's being resized, relayouting at
+    // most every `interval` seconds. In between, last frame's lists
+    // are redrawn cropped to the new size, or stretched to fill it.
+    void setLiveResize(bool enabled, bool stretch = false,
+                       double interval = 1.0 / 30.0);
+
+    // Draw the next few frames even without input, e.g. after changing
+    // application state the UI displays.
+    void requestRedraw();
+
+    // Seconds until the UI needs another frame: 0 when input is pending or
+    // something is animating, infinity when only new input can change it.
+    // Call after ImGui::Render() and sleep until the deadline or the next
+    // event, whichever comes first.
+    double nextFrameDeadline() const;
+
+    // RGBA8 textures updated in place, e.g. by widgets streaming into a
+    // cache. Backends that don't support them return nullptr.
+    virtual ImTextureID createTexture(int width, int height);
+
+    virtual void updateTexture(ImTextureID texture, int x, int y, int width,
+                               int height, const uint8_t* pixels);
+
+    virtual void destroyTexture(ImTextureID texture);
+
+    // Rectangles, circles and lines added as a single quad each, whose
+    // coverage the fragment shader computes analytically, on backends that
+    // support it. Others tessellate them like ImDrawList does. A thickness
+    // of zero fills the shape, otherwise its outline is stroked the same as
+    // ImDrawList::AddRect() and AddCircle() would.
+    void addRect(ImDrawList* drawList, const ImVec2& min, const ImVec2& max,
+                 ImU32 col, float rounding = 0.0f, float thickness = 0.0f);
+
+    void addCircle(ImDrawList* drawList, const ImVec2& center, float radius,
+                   ImU32 col, float thickness = 0.0f);
+
+    void addLine(ImDrawList* drawList, const ImVec2& a, const ImVec2& b,
+                 ImU32 col, float thickness = 1.0f);
+
+    // Worker threads shared by the backend and the views drawn with this
+    // manager, started on first use. Views taking the pool have to be
+    // destroyed or closed before the manager.
+    WorkerPool& getWorkerPool();
+
   protected:
+    // Create and make current this manager's context, and map CrossWindow
+    // inputs to it.
     void create();
+
+    // Find the commands fully covered by a later opaque window and shrink
+    // the clip rects of partially covered ones, leaving drawData as it is.
+    // Runs on display-space clip rects, before any framebuffer scaling.
+    void cullOccludedCommands(const ImDrawData* drawData);
+
+    // The clip rects the last cullOccludedCommands() left to the commands of
+    // the frame's `list`th list, empty for occluded ones. Null if it culled
+    // nothing there.
+    const ImVec4* getCulledClipRects(int list) const;
+
+    // Framebuffer size and display to framebuffer scale to render drawData
+    // with. While a live resize redraws a stale frame they describe the
+    // resized window rather than the one the lists were built for.
+    ImVec2 framebufferSize(const ImDrawData* drawData) const;
+    ImVec2 framebufferScale(const ImDrawData* drawData) const;
+
+    // Set this frame's GPU buffer bytes and track their peak.
+    void recordBufferBytes(size_t bytes);
+
+    // Bytes held by CPU side scratch buffers, and release them per
+    // `policy`. Backends with their own extend these.
+    virtual size_t stagingBytes() const;
+    virtual void trimStaging(ImGuiTrimPolicy policy);
+
+    void measureMemory(ImGuiMemoryReport& report, bool perList) const;
+
+    // Append a list's commands to `ops`, projecting clip rects from display
+    // space by `clipOffset` and `clipScale` and clipping them to `fbSize`.
+    // Fully clipped draws are dropped. The offsets locate the list in the
+    // backend's vertex and index buffers. `clipRects` replaces the commands'
+    // own, and draws whose replacement is empty are dropped as occluded.
+    void compileRenderOps(const ImDrawList* cmdList, const ImVec2& clipOffset,
+                          const ImVec2& clipScale, const ImVec2& fbSize,
+                          int vtxOffset, int idxOffset,
+                          std::vector<ImGuiRenderOp>& ops,
+                          const ImVec4* clipRects = nullptr);
+
+    // Compile every list of a frame whose lists share one pair of buffers,
+    // with the clip rects of the last cullOccludedCommands().
+    void compileRenderOps(const ImDrawData* drawData,
+                          std::vector<ImGuiRenderOp>& ops);
+
+    ImGuiContext* context = nullptr;
+    std::unique_ptr<WorkerPool> workerPool;
     std::string charBuf;
+    EventQueue<xwin::Event> eventQueue;
+    ImGuiFrameStats frameStats;
+    bool occlusionCulling = false;
+    std::vector<ImVec4> occluders;
+    // Per command clip rects of the lists occlusion culling reached, and
+    // where each list's start in them, -1 for lists in front of every
+    // occluder
+    std::vector<ImVec4> culledClipRects;
+    std::vector<int> culledListStarts;
+    std::vector<ImGuiRenderOp> renderOps;
+    ImGuiBufferSizer vertexBufferSizer;
+    ImGuiBufferSizer indexBufferSizer;
+    size_t peakBufferBytes = 0;
+    size_t memoryBudget = 0;
+    ImGuiTrimPolicy memoryBudgetPolicy = ImGuiTrimPolicy::Excess;
+
+    // A budget below the working set would otherwise trim every frame and
+    // have the buffers regrow the next, so the total has to stay over it for
+    // this many frames first
+    static const unsigned kOverBudgetFrames = 60;
+    unsigned overBudgetFrames = 0;
+    // What's left after a trim that freed nothing, not retried until the
+    // total grows past it
+    size_t memoryTrimFloor = 0;
+
+    // ImGui settles layout changes over a couple of frames, so input keeps
+    // the UI redrawing for this many frames
+    static const int kSettleFrames = 3;
+    int pendingFrames = kSettleFrames;
+
+    // Set by backends whose shaders evaluate addRect() and friends
+    bool analyticShapes = false;
+
+    bool liveResize = false;
+    bool stretchStaleFrames = false;
+    double relayoutInterval = 1.0 / 30.0;
+    bool resizePending = false;
+    bool reusingFrame = false;
+    ImVec2 pendingDisplaySize;
+    std::chrono::steady_clock::time_point lastRelayout;
 };
-}
\ No newline at end of file
+}
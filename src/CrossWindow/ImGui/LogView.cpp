@@ -0,0 +1,416 @@
+#include "LogView.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <regex>
+
+// Newlines are found sixteen bytes at a time where SSE2 is baseline
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XGFX_IMGUI_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace xgfx
+{
+namespace
+{
+// Bytes indexed between publishing lines to the UI
+const size_t kScanBytes = 4 << 20;
+
+// Lines longer than this are cut short on screen
+const uint64_t kMaxLineBytes = 4096;
+
+// and this much of them is searched, so a window of lines read for a
+// search stays bounded
+const uint64_t kMaxSearchBytes = 64 << 10;
+
+inline int countTrailingZeros(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Append the file offset after each newline in `size` bytes read from
+// `offset` to `starts`.
+void findNewlines(const uint8_t* data, size_t size, uint64_t offset,
+                  std::vector<uint64_t>& starts)
+{
+    size_t i = 0;
+#if defined(XGFX_IMGUI_SSE2)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+        for (; mask; mask &= mask - 1)
+            starts.push_back(offset + i + countTrailingZeros(mask) + 1);
+    }
+#endif
+    for (; i < size; i++)
+        if (data[i] == '\n') starts.push_back(offset + i + 1);
+}
+}
+
+struct LogView::Search
+{
+    std::regex regex;
+    uint64_t generation = 0;
+    size_t lines = 0;
+    std::vector<std::vector<uint64_t>> matches;
+    std::atomic<size_t> remaining{0};
+};
+
+LogView::LogView(WorkerPool& workers) : mWorkers(workers) {}
+
+LogView::~LogView() { close(); }
+
+bool LogView::open(const char* path)
+{
+    close();
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path)) return false;
+    mPath = path;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFile = file;
+    }
+    mStopping = false;
+    mIndexer = std::thread(&LogView::runIndexer, this);
+    return true;
+}
+
+void LogView::close()
+{
+    if (mIndexer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mWake.notify_all();
+        mIndexer.join();
+    }
+    mSearchGeneration++;
+    mWorkers.wait(mSearchJobs);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFile.reset();
+    mChunks.clear();
+    mLineStarts = 0;
+    mIndexedBytes = 0;
+    mMatches.reset();
+    mSearching = false;
+}
+
+bool LogView::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFile != nullptr;
+}
+
+size_t LogView::getLineCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // A newline at the end of the indexed data doesn't start a line yet
+    size_t lines = mLineStarts;
+    size_t chunk = mChunks.empty() ? 0 : mChunks.size() - 1;
+    if (lines > 0 && lineStart(lines - 1, chunk) == mIndexedBytes) lines--;
+    return lines;
+}
+
+uint64_t LogView::lineStart(size_t line, size_t& chunk) const
+{
+    while (chunk + 1 < mChunks.size() && mChunks[chunk + 1].firstLine <= line)
+        chunk++;
+    const LineChunk& lines = mChunks[chunk];
+    return lines.base + lines.offsets[line - lines.firstLine];
+}
+
+void LogView::runIndexer()
+{
+    std::vector<uint64_t> starts;
+    std::vector<uint8_t> scan(kScanBytes);
+    uint64_t indexed = 0;
+    while (!mStopping)
+    {
+        std::shared_ptr<const MappedFile> file;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            file = mFile;
+        }
+        const size_t size = file->size();
+        // Comes up short if the file was truncated, which the size check
+        // below notices
+        size_t got = 0;
+        if (indexed < size)
+        {
+            XGFX_TRACE_SCOPE("LogView::runIndexer");
+            got = file->read(indexed, scan.data(),
+                             std::min(size - (size_t)indexed, kScanBytes));
+            starts.clear();
+            if (indexed == 0 && got > 0) starts.push_back(0);
+            findNewlines(scan.data(), got, indexed, starts);
+            indexed += got;
+            publishLines(starts, indexed);
+        }
+        if (got > 0) continue;
+
+        // Caught up, so poll for appends
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait_for(lock, std::chrono::milliseconds(250),
+                           [this] { return mStopping.load(); });
+        }
+        if (mStopping || file->currentSize() == size) continue;
+        std::shared_ptr<MappedFile> grown = std::make_shared<MappedFile>();
+        if (!grown->open(mPath.c_str())) continue;
+
+        // A file that shrank was truncated or replaced, so start over
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (grown->size() < indexed)
+        {
+            mChunks.clear();
+            mLineStarts = 0;
+            mIndexedBytes = 0;
+            indexed = 0;
+        }
+        mFile = grown;
+    }
+}
+
+void LogView::publishLines(const std::vector<uint64_t>& starts,
+                           uint64_t indexed)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (uint64_t start : starts)
+    {
+        if (mChunks.empty() || mChunks.back().count == kChunkLines ||
+            start - mChunks.back().base > UINT32_MAX)
+        {
+            mChunks.emplace_back();
+            mChunks.back().firstLine = mLineStarts;
+            mChunks.back().base = start;
+            mChunks.back().offsets.reset(new uint32_t[kChunkLines]);
+        }
+        LineChunk& chunk = mChunks.back();
+        chunk.offsets[chunk.count++] = (uint32_t)(start - chunk.base);
+        mLineStarts++;
+    }
+    mIndexedBytes = indexed;
+}
+
+void LogView::readLines(size_t first, size_t count, uint64_t maxBytes,
+                        std::vector<char>& text,
+                        std::vector<std::pair<size_t, size_t>>& ranges) const
+{
+    // Line offsets under the lock, the reads after
+    std::vector<std::pair<uint64_t, uint64_t>> lines;
+    std::shared_ptr<const MappedFile> file;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        file = mFile;
+        const size_t last = std::min(first + count, mLineStarts);
+        if (first < last)
+        {
+            auto chunk = std::upper_bound(
+                mChunks.begin(), mChunks.end(), first,
+                [](size_t line, const LineChunk& c) {
+                    return line < c.firstLine;
+                });
+            size_t index = (size_t)(chunk - mChunks.begin()) - 1;
+            uint64_t begin = lineStart(first, index);
+            for (size_t line = first; line < last; line++)
+            {
+                uint64_t next = line + 1 < mLineStarts
+                                    ? lineStart(line + 1, index)
+                                    : mIndexedBytes + 1;
+                lines.push_back({begin, next - 1});
+                begin = next;
+            }
+        }
+    }
+
+    // Lines are cut short first, then contiguous ones read at once unless
+    // that means reading a lot more than is kept of them
+    text.clear();
+    ranges.clear();
+    if (lines.empty()) return;
+    uint64_t kept = 0;
+    for (auto& line : lines)
+    {
+        line.second = line.first + std::min(line.second - line.first, maxBytes);
+        kept += line.second - line.first;
+    }
+    const uint64_t offset = lines.front().first;
+    const uint64_t span = lines.back().second - offset;
+    if (span - kept <= kept + lines.size())
+    {
+        text.resize((size_t)span);
+        size_t got = file->read(offset, text.data(), text.size());
+        for (const auto& line : lines)
+            ranges.push_back({std::min((size_t)(line.first - offset), got),
+                              std::min((size_t)(line.second - offset), got)});
+    }
+    else
+    {
+        for (const auto& line : lines)
+        {
+            size_t begin = text.size();
+            text.resize(begin + (size_t)(line.second - line.first));
+            size_t got = file->read(line.first, text.data() + begin,
+                                    text.size() - begin);
+            text.resize(begin + got);
+            ranges.push_back({begin, begin + got});
+        }
+    }
+    for (auto& range : ranges)
+        if (range.second > range.first && text[range.second - 1] == '\r')
+            range.second--;
+}
+
+bool LogView::search(const std::string& pattern)
+{
+    if (pattern.empty())
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSearchGeneration++;
+        mMatches.reset();
+        mSearching = false;
+        return true;
+    }
+
+    std::shared_ptr<Search> search = std::make_shared<Search>();
+    try
+    {
+        search->regex = std::regex(pattern, std::regex::ECMAScript |
+                                                std::regex::optimize);
+    }
+    catch (const std::regex_error&)
+    {
+        return false;
+    }
+    search->lines = getLineCount();
+    size_t parts = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    search->matches.resize(parts);
+    search->remaining = parts;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        search->generation = ++mSearchGeneration;
+        mSearching = true;
+    }
+    for (size_t part = 0; part < parts; part++)
+        mWorkers.submit(mSearchJobs,
+                        [this, search, part] { runSearch(search, part); });
+    return true;
+}
+
+void LogView::runSearch(const std::shared_ptr<Search>& search, size_t part)
+{
+    XGFX_TRACE_SCOPE("LogView::runSearch");
+    const size_t parts = search->matches.size();
+    const size_t first = search->lines * part / parts;
+    const size_t last = search->lines * (part + 1) / parts;
+    std::vector<char> text;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::vector<uint64_t>& matches = search->matches[part];
+    for (size_t line = first;
+         line < last && search->generation == mSearchGeneration;
+         line += 4096)
+    {
+        readLines(line, std::min(last - line, (size_t)4096),
+                  kMaxSearchBytes, text, ranges);
+        for (size_t i = 0; i < ranges.size(); i++)
+            if (std::regex_search(text.data() + ranges[i].first,
+                                  text.data() + ranges[i].second,
+                                  search->regex))
+                matches.push_back(line + i);
+    }
+
+    // The last part to finish publishes every part's matches in order
+    if (search->remaining.fetch_sub(1) != 1) return;
+    size_t total = 0;
+    for (const auto& slice : search->matches)
+        total += slice.size();
+    std::shared_ptr<std::vector<uint64_t>> result =
+        std::make_shared<std::vector<uint64_t>>();
+    result->reserve(total);
+    for (const auto& slice : search->matches)
+        result->insert(result->end(), slice.begin(), slice.end());
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (search->generation != mSearchGeneration) return;
+    mMatches = result;
+    mSearching = false;
+}
+
+bool LogView::isSearching() const { return mSearching; }
+
+size_t LogView::getMatchCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMatches ? mMatches->size() : 0;
+}
+
+void LogView::setShowMatchesOnly(bool enabled) { mShowMatchesOnly = enabled; }
+
+void LogView::draw(const char* id, const ImVec2& size)
+{
+    if (!isOpen()) return;
+    XGFX_TRACE_SCOPE("LogView::draw");
+    ImGui::PushID(id);
+    if (ImGui::InputText("Search", mSearchBuf, sizeof(mSearchBuf),
+                         ImGuiInputTextFlags_EnterReturnsTrue))
+        search(mSearchBuf);
+    ImGui::SameLine();
+    ImGui::Checkbox("Matches only", &mShowMatchesOnly);
+    ImGui::PopID();
+
+    std::shared_ptr<const std::vector<uint64_t>> matches;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        matches = mMatches;
+    }
+    const bool only_matches = mShowMatchesOnly && matches;
+    const size_t count = only_matches ? matches->size() : getLineCount();
+
+    if (ImGui::BeginChild(id, size, true,
+                          ImGuiWindowFlags_HorizontalScrollbar))
+    {
+        // Keep following new lines while scrolled to the bottom
+        const bool follow = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+        ImGuiListClipper clipper;
+        clipper.Begin(
+            (int)std::min(count, (size_t)std::numeric_limits<int>::max()),
+            ImGui::GetTextLineHeightWithSpacing());
+        while (clipper.Step())
+        {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd;)
+            {
+                // Matches are fetched a line at a time, contiguous lines
+                // all at once
+                size_t first = only_matches ? (size_t)(*matches)[i] : i;
+                size_t lines = only_matches ? 1 : clipper.DisplayEnd - i;
+                readLines(first, lines, kMaxLineBytes, mText, mRanges);
+                for (const auto& range : mRanges)
+                    ImGui::TextUnformatted(mText.data() + range.first,
+                                           mText.data() + range.second);
+                i += (int)lines;
+            }
+        }
+        if (follow) ImGui::SetScrollHereY(1.0f);
+    }
+    ImGui::EndChild();
+}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "WorkerPool.h"
+#include "imgui.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xgfx
+{
+/**
+ * Shows a log file of any size without reading it into memory. A
+ * background thread indexes where its lines start, scanning for newlines
+ * with SSE2, then keeps polling for appended data. Only the lines in view
+ * are read, with positioned reads rather than through a mapping so a file
+ * truncated underneath the view can't fault, and laid out and drawn. While
+ * scrolled to the bottom the view follows new lines.
+ */
+class LogView
+{
+  public:
+    // Searches run on `workers`, usually the manager's getWorkerPool().
+    // The indexer keeps its own thread since it polls the file until
+    // close().
+    explicit LogView(WorkerPool& workers);
+
+    ~LogView();
+
+    LogView(const LogView&) = delete;
+    LogView& operator=(const LogView&) = delete;
+
+    bool open(const char* path);
+
+    void close();
+
+    bool isOpen() const;
+
+    // Lines indexed so far.
+    size_t getLineCount() const;
+
+    // Search the lines indexed so far for an ECMAScript regular expression,
+    // in parallel on worker threads. Returns false if `pattern` is invalid.
+    // An empty pattern clears the search.
+    bool search(const std::string& pattern);
+
+    bool isSearching() const;
+
+    // Lines matching the last search, once it's done.
+    size_t getMatchCount() const;
+
+    // Show only lines matching the last search.
+    void setShowMatchesOnly(bool enabled);
+
+    void draw(const char* id, const ImVec2& size = ImVec2(0.0f, 0.0f));
+
+  private:
+    static const size_t kChunkLines = 65536;
+
+    // A search's state, shared by its jobs. The last one to finish
+    // publishes the matches.
+    struct Search;
+
+    // Starts of up to kChunkLines consecutive lines, as 32 bit offsets from
+    // the first one's. A chunk ends early where an offset wouldn't fit.
+    struct LineChunk
+    {
+        size_t firstLine = 0;
+        uint64_t base = 0;
+        size_t count = 0;
+        std::unique_ptr<uint32_t[]> offsets;
+    };
+
+    // Scans for newlines and follows appends until close().
+    void runIndexer();
+
+    // Append line starts found by the indexer, covering the file up to
+    // `indexed` bytes.
+    void publishLines(const std::vector<uint64_t>& starts, uint64_t indexed);
+
+    // Where `line` starts, with `chunk` the index of a chunk at or before
+    // the line's, advanced to it. Needs mMutex.
+    uint64_t lineStart(size_t line, size_t& chunk) const;
+
+    // Read lines [first, first + count) into `text`, each cut short at
+    // `maxBytes`, and set `ranges` to where they are in it without their
+    // line endings. Lines gone from a truncated file come back empty.
+    void readLines(size_t first, size_t count, uint64_t maxBytes,
+                   std::vector<char>& text,
+                   std::vector<std::pair<size_t, size_t>>& ranges) const;
+
+    void runSearch(const std::shared_ptr<Search>& search, size_t part);
+
+    std::string mPath;
+    std::thread mIndexer;
+    std::atomic<bool> mStopping{false};
+    std::condition_variable mWake;
+    WorkerPool& mWorkers;
+    WorkerGroup mSearchJobs;
+
+    // The latest mapping and the line index, under mMutex. Each growth of
+    // the file is a new mapping, older ones stay mapped while in use.
+    mutable std::mutex mMutex;
+    std::shared_ptr<const MappedFile> mFile;
+    std::vector<LineChunk> mChunks;
+    size_t mLineStarts = 0;
+    uint64_t mIndexedBytes = 0;
+
+    std::atomic<uint64_t> mSearchGeneration{0};
+    std::atomic<bool> mSearching{false};
+    std::shared_ptr<const std::vector<uint64_t>> mMatches;
+    bool mShowMatchesOnly = false;
+    char mSearchBuf[256] = {};
+    std::vector<char> mText;
+    std::vector<std::pair<size_t, size_t>> mRanges;
+};
+}
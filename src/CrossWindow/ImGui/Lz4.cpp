@@ -0,0 +1,169 @@
+#include "Lz4.h"
+
+#include <cstring>
+
+namespace xgfx
+{
+namespace lz4
+{
+namespace
+{
+const int kHashLog = 12;
+const size_t kMinMatch = 4;
+// The block format requires the last 5 bytes to be literals, and the last
+// match to start at least 12 bytes before the end.
+const size_t kLastLiterals = 5;
+const size_t kMatchStartLimit = 12;
+const size_t kMaxOffset = 65535;
+
+uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - kHashLog);
+}
+
+uint8_t* writeLength(uint8_t* op, size_t length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+uint8_t* writeLiterals(uint8_t* op, uint8_t* token, const uint8_t* literals,
+                       size_t length)
+{
+    *token = static_cast<uint8_t>((length < 15 ? length : 15) << 4);
+    if (length >= 15) op = writeLength(op, length - 15);
+    if (length) memcpy(op, literals, length);
+    return op + length;
+}
+
+bool readLength(const uint8_t*& ip, const uint8_t* end, size_t& length)
+{
+    uint8_t b;
+    do
+    {
+        if (ip >= end) return false;
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+}
+
+size_t compressBound(size_t size) { return size + size / 255 + 16; }
+
+size_t compress(const uint8_t* src, size_t size, uint8_t* dst)
+{
+    uint8_t* op = dst;
+    size_t anchor = 0;
+
+    if (size > kMatchStartLimit)
+    {
+        uint32_t table[1 << kHashLog];
+        memset(table, 0, sizeof(table));
+        const size_t matchEndLimit = size - kLastLiterals;
+        const size_t matchStartLimit = size - kMatchStartLimit;
+
+        // Step further the longer we go without a match, so incompressible
+        // data doesn't cost a hash lookup per byte
+        size_t ip = 1;
+        unsigned misses = 0;
+        while (ip < matchStartLimit)
+        {
+            uint32_t sequence = read32(src + ip);
+            uint32_t h = hash(sequence);
+            size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(ip);
+            if (ip - ref > kMaxOffset || read32(src + ref) != sequence)
+            {
+                ip += 1 + (misses++ >> 5);
+                continue;
+            }
+            misses = 0;
+
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+            {
+                ip--;
+                ref--;
+            }
+            size_t length = kMinMatch;
+            while (ip + length < matchEndLimit &&
+                   src[ip + length] == src[ref + length])
+                length++;
+
+            uint8_t* token = op++;
+            op = writeLiterals(op, token, src + anchor, ip - anchor);
+            uint16_t offset = static_cast<uint16_t>(ip - ref);
+            *op++ = static_cast<uint8_t>(offset & 0xff);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+            size_t matchLength = length - kMinMatch;
+            *token |= static_cast<uint8_t>(matchLength < 15 ? matchLength : 15);
+            if (matchLength >= 15) op = writeLength(op, matchLength - 15);
+
+            ip += length;
+            anchor = ip;
+            if (ip - 2 < matchStartLimit)
+                table[hash(read32(src + ip - 2))] =
+                    static_cast<uint32_t>(ip - 2);
+        }
+    }
+
+    uint8_t* token = op++;
+    op = writeLiterals(op, token, src + anchor, size - anchor);
+    return static_cast<size_t>(op - dst);
+}
+
+bool decompress(const uint8_t* src, size_t size, uint8_t* dst,
+                size_t dstSize)
+{
+    const uint8_t* ip = src;
+    const uint8_t* end = src + size;
+    uint8_t* op = dst;
+    uint8_t* dstEnd = dst + dstSize;
+
+    while (ip < end)
+    {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(ip, end, literals)) return false;
+        if (literals > static_cast<size_t>(end - ip) ||
+            literals > static_cast<size_t>(dstEnd - op))
+            return false;
+        if (literals) memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // The last sequence has no match
+        if (ip == end) break;
+
+        if (end - ip < 2) return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst))
+            return false;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(ip, end, length)) return false;
+        length += kMinMatch;
+        if (length > static_cast<size_t>(dstEnd - op)) return false;
+
+        // Matches may overlap their own output, so copy bytewise
+        const uint8_t* match = op - offset;
+        for (size_t i = 0; i < length; i++)
+            op[i] = match[i];
+        op += length;
+    }
+    return op == dstEnd;
+}
+}
+}
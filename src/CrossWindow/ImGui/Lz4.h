@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xgfx
+{
+namespace lz4
+{
+// Largest compressed size of `size` input bytes.
+size_t compressBound(size_t size);
+
+// Compress into an LZ4 block, readable by any LZ4 block decoder. `dst` must
+// hold compressBound(size) bytes. Returns the compressed size.
+size_t compress(const uint8_t* src, size_t size, uint8_t* dst);
+
+// Decompress an LZ4 block that expands to exactly `dstSize` bytes. Returns
+// false on malformed input instead of reading or writing out of bounds.
+bool decompress(const uint8_t* src, size_t size, uint8_t* dst,
+                size_t dstSize);
+}
+}
@@ -0,0 +1,170 @@
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstdio>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace xgfx
+{
+namespace
+{
+#if defined(_WIN32)
+const intptr_t kNoFile = (intptr_t)INVALID_HANDLE_VALUE;
+#else
+const intptr_t kNoFile = -1;
+#endif
+}
+
+MappedFile::MappedFile() : mFile(kNoFile) {}
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const char* path)
+{
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    mFile = (intptr_t)file;
+    LARGE_INTEGER size;
+    if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &size))
+        mSize = (size_t)size.QuadPart;
+#else
+    mFile = ::open(path, O_RDONLY);
+    struct stat info;
+    if (mFile >= 0 && fstat((int)mFile, &info) == 0)
+        mSize = (size_t)info.st_size;
+#endif
+    if (mFile == kNoFile || !map(false))
+    {
+        fprintf(stderr, "ERROR: Failed to map %s!\n", path);
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::create(const char* path, size_t size)
+{
+    close();
+    mSize = size;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    mFile = (intptr_t)file;
+    bool sized = file != INVALID_HANDLE_VALUE;
+#else
+    mFile = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    bool sized = mFile >= 0 && ftruncate((int)mFile, (off_t)size) == 0;
+#endif
+    if (!sized || !map(true))
+    {
+        fprintf(stderr, "ERROR: Failed to create %s!\n", path);
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::map(bool writable)
+{
+    mWritable = writable;
+
+    // Empty files can't be mapped, but are still open
+    if (mSize == 0) return true;
+#if defined(_WIN32)
+    // Mapping a writable file past its end grows it
+    ULARGE_INTEGER size;
+    size.QuadPart = mSize;
+    HANDLE mapping =
+        CreateFileMappingA((HANDLE)mFile, nullptr,
+                           writable ? PAGE_READWRITE : PAGE_READONLY,
+                           size.HighPart, size.LowPart, nullptr);
+    if (!mapping) return false;
+    mMapping = (intptr_t)mapping;
+    mData = (uint8_t*)MapViewOfFile(
+        mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, mSize);
+#else
+    void* data = mmap(nullptr, mSize, PROT_READ | (writable ? PROT_WRITE : 0),
+                      MAP_SHARED, (int)mFile, 0);
+    mData = data == MAP_FAILED ? nullptr : (uint8_t*)data;
+#endif
+    return mData != nullptr;
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+    if (mData) UnmapViewOfFile(mData);
+    if (mMapping) CloseHandle((HANDLE)mMapping);
+    if (mFile != kNoFile) CloseHandle((HANDLE)mFile);
+#else
+    if (mData) munmap(mData, mSize);
+    if (mFile != kNoFile) ::close((int)mFile);
+#endif
+    mFile = kNoFile;
+    mMapping = 0;
+    mData = nullptr;
+    mSize = 0;
+    mWritable = false;
+}
+
+bool MappedFile::isOpen() const { return mFile != kNoFile; }
+
+const uint8_t* MappedFile::data() const { return mData; }
+
+uint8_t* MappedFile::writableData() { return mWritable ? mData : nullptr; }
+
+size_t MappedFile::size() const { return mSize; }
+
+size_t MappedFile::currentSize() const
+{
+#if defined(_WIN32)
+    LARGE_INTEGER size;
+    if (mFile != kNoFile && GetFileSizeEx((HANDLE)mFile, &size))
+        return (size_t)size.QuadPart;
+#else
+    struct stat info;
+    if (mFile != kNoFile && fstat((int)mFile, &info) == 0)
+        return (size_t)info.st_size;
+#endif
+    return mSize;
+}
+
+size_t MappedFile::read(uint64_t offset, void* dst, size_t size) const
+{
+    size_t done = 0;
+    while (done < size && mFile != kNoFile)
+    {
+#if defined(_WIN32)
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)(offset + done);
+        overlapped.OffsetHigh = (DWORD)((offset + done) >> 32);
+        size_t chunk = size - done;
+        if (chunk > (1u << 30)) chunk = 1u << 30;
+        DWORD got = 0;
+        if (!ReadFile((HANDLE)mFile, (uint8_t*)dst + done, (DWORD)chunk, &got,
+                      &overlapped) ||
+            got == 0)
+            break;
+#else
+        ssize_t got = pread((int)mFile, (uint8_t*)dst + done, size - done,
+                            (off_t)(offset + done));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+#endif
+        done += (size_t)got;
+    }
+    return done;
+}
+}
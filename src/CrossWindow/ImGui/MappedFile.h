@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xgfx
+{
+// A file mapped into memory, so widgets can page through files far bigger
+// than RAM and let the OS cache what's used.
+class MappedFile
+{
+  public:
+    MappedFile();
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map an existing file read only.
+    bool open(const char* path);
+
+    // Create or truncate a file of `size` bytes and map it read write.
+    bool create(const char* path, size_t size);
+
+    void close();
+
+    bool isOpen() const;
+
+    const uint8_t* data() const;
+
+    // Null unless the file was mapped with create().
+    uint8_t* writableData();
+
+    size_t size() const;
+
+    // Size of the file now, which is more than size() if it was appended to
+    // since it was mapped.
+    size_t currentSize() const;
+
+    // Copy up to `size` bytes at `offset` with a positioned read instead of
+    // through the mapping, returning how many there were. Touching a mapping
+    // past the end of a file truncated since faults, this just comes up
+    // short.
+    size_t read(uint64_t offset, void* dst, size_t size) const;
+
+  private:
+    bool map(bool writable);
+
+    intptr_t mFile;
+    intptr_t mMapping = 0;
+    uint8_t* mData = nullptr;
+    size_t mSize = 0;
+    bool mWritable = false;
+};
+}
@@ -1,34 +1,1617 @@
-#include "OpenGLImGuiManager.h"
+#include "OpenGL.h"
+#include "FontSdf.h"
+#include "Trace.h"
+#include "WorkerPool.h"
 
 // OpenGL
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Program binaries are core since GL 4.1 and parallel compiles are an
+// extension, so only use them if the GL loader was generated with them.
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+#define XGFX_GL_PROGRAM_BINARY 1
+#endif
+
 namespace xgfx
 {
-OpenGLImGuiManager::OpenGLImGuiManager() {}
+namespace
+{
+// Print the compile log and return false when a shader failed to compile.
+bool checkShader(GLuint handle, const char* desc)
+{
+    GLint status = 0, log_length = 0;
+    glGetShaderiv(handle, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(handle, GL_INFO_LOG_LENGTH, &log_length);
+    if ((GLboolean)status == GL_FALSE)
+        fprintf(stderr, "ERROR: Failed to compile the ImGui %s shader!\n",
+                desc);
+    if (log_length > 1)
+    {
+        std::vector<char> buf(log_length + 1);
+        glGetShaderInfoLog(handle, log_length, NULL, buf.data());
+        fprintf(stderr, "%s\n", buf.data());
+    }
+    return (GLboolean)status == GL_TRUE;
+}
+
+// Print the link log and return false when the program failed to link.
+bool checkProgram(GLuint handle)
+{
+    GLint status = 0, log_length = 0;
+    glGetProgramiv(handle, GL_LINK_STATUS, &status);
+    glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &log_length);
+    if ((GLboolean)status == GL_FALSE)
+        fprintf(stderr, "ERROR: Failed to link the ImGui shader program!\n");
+    if (log_length > 1)
+    {
+        std::vector<char> buf(log_length + 1);
+        glGetProgramInfoLog(handle, log_length, NULL, buf.data());
+        fprintf(stderr, "%s\n", buf.data());
+    }
+    return (GLboolean)status == GL_TRUE;
+}
+
+#if defined(XGFX_GL_PROGRAM_BINARY)
+// Program binaries are only valid for the exact driver and sources that
+// produced them, so all of those go into the cache key.
+std::string programCacheKey(const char* glslVersion, const char* vertexShader,
+                            const char* fragmentShader)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* src : {glslVersion, vertexShader, fragmentShader})
+        for (const char* c = src; *c; ++c)
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+
+    char hashStr[17];
+    snprintf(hashStr, sizeof(hashStr), "%016llx",
+             static_cast<unsigned long long>(hash));
+
+    std::string key;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        const GLubyte* str = glGetString(name);
+        key += str ? reinterpret_cast<const char*>(str) : "";
+        key += '\n';
+    }
+    key += hashStr;
+    return key;
+}
+
+const uint32_t kProgramCacheMagic = 0x43494758; // "XGIC"
+
+// Create a program from a cached binary, or return 0 if there's no usable
+// cache entry for this key.
+GLuint loadProgramBinary(const std::string& path, const std::string& key)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return 0;
+
+    uint32_t header[2] = {};
+    std::string fileKey;
+    uint32_t format = 0, length = 0;
+    std::vector<char> binary;
+    bool valid = std::fread(header, sizeof(header), 1, file) == 1 &&
+                 header[0] == kProgramCacheMagic && header[1] < 4096;
+    if (valid)
+    {
+        fileKey.resize(header[1]);
+        valid = std::fread(&fileKey[0], 1, header[1], file) == header[1] &&
+                fileKey == key && std::fread(&format, 4, 1, file) == 1 &&
+                std::fread(&length, 4, 1, file) == 1 && length > 0;
+    }
+    if (valid)
+    {
+        binary.resize(length);
+        valid = std::fread(binary.data(), 1, length, file) == length;
+    }
+    std::fclose(file);
+    if (!valid) return 0;
+
+    // Drivers reject binaries from other driver versions; fall back to
+    // compiling from source in that case.
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, (GLenum)format, binary.data(), (GLsizei)length);
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if ((GLboolean)status == GL_FALSE)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void saveProgramBinary(const std::string& path, const std::string& key,
+                       GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    if (length <= 0) return;
+
+    // Write to a temporary file unique to this process and call first, so
+    // concurrently starting instances never read or rename a partial cache.
+#if defined(_WIN32)
+    int pid = _getpid();
+#else
+    int pid = (int)getpid();
+#endif
+    static std::atomic<unsigned> counter{0};
+    std::string tmpPath = path + "." + std::to_string(pid) + "." +
+                          std::to_string(counter.fetch_add(1)) + ".tmp";
+    std::FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file) return;
+    uint32_t header[2] = {kProgramCacheMagic, (uint32_t)key.size()};
+    uint32_t format32 = (uint32_t)format, length32 = (uint32_t)length;
+    bool written = std::fwrite(header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(key.data(), 1, key.size(), file) == key.size() &&
+                   std::fwrite(&format32, 4, 1, file) == 1 &&
+                   std::fwrite(&length32, 4, 1, file) == 1 &&
+                   std::fwrite(binary.data(), 1, length, file) == (size_t)length;
+    std::fclose(file);
+    if (written)
+    {
+        std::remove(path.c_str());
+        written = std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+    if (!written) std::remove(tmpPath.c_str());
+}
+#endif
+
+// 64 bit FNV-1a, enough to tell whether a window's draw list changed.
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+{
+    if (!hash) hash = 14695981039346656037ull;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Hashes 8 bytes per step in four independent lanes so the multiplies
+// overlap. Each step is invertible, so changing any one word always
+// changes the result. For hashing whole vertex and index buffers, where
+// hashBytes() costs about as much as drawing them.
+uint64_t hashWords(const void* data, size_t size, uint64_t hash)
+{
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t lanes[4] = {hash, hash + 1, hash + 2, hash + 3};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        uint64_t words[4];
+        memcpy(words, bytes + i, sizeof(words));
+        for (int k = 0; k < 4; k++)
+            lanes[k] = (lanes[k] ^ words[k]) * prime;
+    }
+    hash = hashBytes(bytes + i, size - i, hash);
+    for (int k = 0; k < 4; k++)
+    {
+        hash = (hash ^ lanes[k] ^ (lanes[k] >> 32)) * prime;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+// Copy into `dst` keeping its capacity, where assignment would reallocate.
+template <typename T>
+void copyVector(ImVector<T>& dst, const ImVector<T>& src)
+{
+    dst.resize(src.Size);
+    if (src.Size) memcpy(dst.Data, src.Data, (size_t)src.Size * sizeof(T));
+}
+}
+
+OpenGLImGuiManager::OpenGLImGuiManager() {}
+
+OpenGLImGuiManager::~OpenGLImGuiManager() { destroyDeviceObjects(); }
+
+void OpenGLImGuiManager::init()
+{
+    IMGUI_CHECKVERSION();
+
+    // Create our context and setup CrossWindow event mapping:
+    ImGuiManager::create();
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = "imgui_crosswindow_opengl";
+
+    // glDrawElementsBaseVertex is core since GL 3.2, this needs the GL
+    // functions to be loaded already.
+    if (glDrawElementsBaseVertex)
+        io.BackendFlags |=
+            ImGuiBackendFlags_RendererHasVtxOffset; // We can honor the
+                                                    // ImDrawCmd::VtxOffset
+                                                    // field, allowing for
+                                                    // large meshes.
+}
+
+void OpenGLImGuiManager::setupRenderState(ImDrawData* drawData, int fbWidth,
+                                          int fbHeight, unsigned vertexArray)
+{
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::setupRenderState");
+
+    // Setup render state: alpha-blending enabled, no face culling, no depth
+    // testing, scissor enabled, polygon fill
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    // Setup viewport, orthographic projection matrix
+    // Our visible imgui space lies from drawData->DisplayPps (top left) to
+    // drawData->DisplayPos+data_data->DisplaySize (bottom right). DisplayMin
+    // is typically (0,0) for single viewport apps. A stale frame redrawn
+    // during a live resize covers the framebuffer at its own scale instead.
+    glViewport(0, 0, (GLsizei)fbWidth, (GLsizei)fbHeight);
+    ImVec2 scale = framebufferScale(drawData);
+    mProjection = ImVec4(drawData->DisplayPos.x,
+                         drawData->DisplayPos.x + fbWidth / scale.x,
+                         drawData->DisplayPos.y,
+                         drawData->DisplayPos.y + fbHeight / scale.y);
+    glUseProgram(mShaderHandle);
+    glUniform1i(mAttribLocationTex, 0);
+    glUniform1i(mAttribLocationMode, 0);
+    glUniform1i(mAttribLocationInstanced, 0);
+    glUniform1i(mAttribLocationVertices, 1);
+    setProjection(mProjection);
+    if (glBindSampler)
+        glBindSampler(0,
+                      0); // We use combined texture/sampler state. Applications
+                          // using GL 3.3 may set that otherwise.
+
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, mVboHandle);
+    glEnableVertexAttribArray(mAttribLocationPosition);
+    glEnableVertexAttribArray(mAttribLocationUV);
+    glEnableVertexAttribArray(mAttribLocationColor);
+    setVertexAttributes();
+
+    // Orphaning the vertex buffer keeps it attached
+    if (mVertexTexture)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, mVertexTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, mVboHandle);
+        glActiveTexture(GL_TEXTURE0);
+    }
+}
+
+void OpenGLImGuiManager::setProjection(const ImVec4& rect)
+{
+    float L = rect.x;
+    float R = rect.y;
+    float T = rect.z;
+    float B = rect.w;
+    const float ortho_projection[4][4] = {
+        {2.0f / (R - L), 0.0f, 0.0f, 0.0f},
+        {0.0f, 2.0f / (T - B), 0.0f, 0.0f},
+        {0.0f, 0.0f, -1.0f, 0.0f},
+        {(R + L) / (L - R), (T + B) / (B - T), 0.0f, 1.0f},
+    };
+    glUniformMatrix4fv(mAttribLocationProjMtx, 1, GL_FALSE,
+                       &ortho_projection[0][0]);
+}
+
+void OpenGLImGuiManager::setVertexAttributes()
+{
+    glVertexAttribPointer(mAttribLocationPosition, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(ImDrawVert),
+                          (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
+    glVertexAttribPointer(mAttribLocationUV, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(ImDrawVert),
+                          (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
+    glVertexAttribPointer(mAttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(ImDrawVert),
+                          (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
+}
+
+void OpenGLImGuiManager::setInstanceAttributes(size_t offset)
+{
+    glVertexAttribPointer(
+        mAttribLocationInstPos, 2, GL_FLOAT, GL_FALSE, sizeof(QuadInstance),
+        (GLvoid*)(offset + IM_OFFSETOF(QuadInstance, x)));
+    glVertexAttribPointer(
+        mAttribLocationInstSize, 2, GL_UNSIGNED_SHORT, GL_FALSE,
+        sizeof(QuadInstance),
+        (GLvoid*)(offset + IM_OFFSETOF(QuadInstance, width)));
+    glVertexAttribPointer(
+        mAttribLocationInstUV, 4, GL_UNSIGNED_SHORT, GL_TRUE,
+        sizeof(QuadInstance), (GLvoid*)(offset + IM_OFFSETOF(QuadInstance, uv)));
+    glVertexAttribPointer(
+        mAttribLocationInstColor, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+        sizeof(QuadInstance),
+        (GLvoid*)(offset + IM_OFFSETOF(QuadInstance, col)));
+}
+
+void OpenGLImGuiManager::drawCommands(ImDrawData* drawData,
+                                      const ImDrawList* cmdList,
+                                      const ImVec2& clipOffset,
+                                      const ImVec2& clipScale, int fbWidth,
+                                      int fbHeight, const ListDraw& draw,
+                                      unsigned vertexArray, DrawState& state,
+                                      const ImVec4* clipRects)
+{
+    XGFX_TRACE_SCOPE("ImGui draw loop");
+    const bool base_vertex = (ImGui::GetIO().BackendFlags &
+                              ImGuiBackendFlags_RendererHasVtxOffset) != 0;
+
+    // Quad spans are looked up by ImGui's own indices within the list
+    renderOps.clear();
+    compileRenderOps(cmdList, clipOffset, clipScale,
+                     ImVec2((float)fbWidth, (float)fbHeight),
+                     draw.quads ? 0 : draw.vtxOffset,
+                     draw.quads ? 0 : draw.idxOffset, renderOps, clipRects);
+    for (const ImGuiRenderOp& op : renderOps)
+    {
+        if (op.type != ImGuiRenderOp::Draw)
+        {
+            bindQuadInstances(false, vertexArray, state);
+
+            // User callback (registered via ImDrawList::AddCallback)
+            // (ImDrawCallback_ResetRenderState is a special callback value
+            // used by the user to request the renderer to reset render
+            // state.)
+            if (op.type == ImGuiRenderOp::ResetRenderState)
+                setupRenderState(drawData, fbWidth, fbHeight, vertexArray);
+            else
+                op.cmd->UserCallback(op.list, op.cmd);
+
+            // The callback may have touched any state we were tracking
+            state.textureBound = false;
+            state.scissor[2] = -1;
+            continue;
+        }
+
+        // Textures still uploading aren't shown yet
+        GLuint texture = (GLuint)(intptr_t)op.texture;
+        if (!mPendingTextures.empty() && mPendingTextures.count(texture))
+            continue;
+
+        // GL scissors from the bottom left corner
+        int scissor[4] = {op.scissor[0], fbHeight - op.scissor[3],
+                          op.scissor[2] - op.scissor[0],
+                          op.scissor[3] - op.scissor[1]};
+        setScissor(scissor, state);
+
+        // Bind texture, Draw
+        if (!state.textureBound || texture != state.texture)
+        {
+            // The distance field atlas needs its own shading
+            bool was_sdf = mFontSdf && state.texture == mFontTexture;
+            bool is_sdf = mFontSdf && texture == mFontTexture;
+            if (!state.textureBound || is_sdf != was_sdf)
+                glUniform1i(mAttribLocationMode, is_sdf ? 1 : 0);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            state.texture = texture;
+            state.textureBound = true;
+            frameStats.textureBinds++;
+        }
+        if (draw.quads)
+        {
+            drawQuadSpans(op, draw, vertexArray, state);
+            continue;
+        }
+        const GLenum idx_type =
+            sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        const GLvoid* idx_offset =
+            (const GLvoid*)(intptr_t)(op.idxOffset * sizeof(ImDrawIdx));
+        if (base_vertex)
+            glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)op.elemCount,
+                                     idx_type, idx_offset,
+                                     (GLint)op.vtxOffset);
+        else
+            glDrawElements(GL_TRIANGLES, (GLsizei)op.elemCount, idx_type,
+                           idx_offset);
+        frameStats.drawCalls++;
+    }
+    bindQuadInstances(false, vertexArray, state);
+}
+
+bool OpenGLImGuiManager::buildQuadInstances(const ImDrawList* cmdList,
+                                            ListDraw& draw)
+{
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::buildQuadInstances");
+    for (int cmd_i = 0; cmd_i < cmdList->CmdBuffer.Size; cmd_i++)
+        if (cmdList->CmdBuffer[cmd_i].VtxOffset != 0) return false;
+
+    const ImDrawVert* vtx = cmdList->VtxBuffer.Data;
+    const ImDrawIdx* idx = cmdList->IdxBuffer.Data;
+    const unsigned vtx_count = (unsigned)cmdList->VtxBuffer.Size;
+    draw.quadVtx = (int)mQuadVertices.size();
+    draw.quadIdx = (int)mQuadIndices.size();
+    draw.instOffset = (int)mQuadInstances.size();
+    draw.spanBegin = (int)mQuadSpans.size();
+    mQuadRemap.assign(vtx_count, -1);
+
+    // ImGui emits glyphs and solid rectangles as four vertices going around
+    // from the top left, and two triangles sharing the first and third.
+    // Those that are axis aligned, with one color and UVs following the
+    // corners, are drawn the same as an instance.
+    auto to_quad = [&](unsigned i, QuadInstance& quad) {
+        unsigned a = idx[i];
+        if (idx[i + 1] != a + 1 || idx[i + 2] != a + 2 || idx[i + 3] != a ||
+            idx[i + 4] != a + 2 || idx[i + 5] != a + 3 || a + 3 >= vtx_count)
+            return false;
+        const ImDrawVert* v = vtx + a;
+        if (v[0].pos.y != v[1].pos.y || v[1].pos.x != v[2].pos.x ||
+            v[2].pos.y != v[3].pos.y || v[3].pos.x != v[0].pos.x ||
+            v[0].uv.y != v[1].uv.y || v[1].uv.x != v[2].uv.x ||
+            v[2].uv.y != v[3].uv.y || v[3].uv.x != v[0].uv.x ||
+            v[0].col != v[1].col || v[0].col != v[2].col ||
+            v[0].col != v[3].col)
+            return false;
+        float width = (v[2].pos.x - v[0].pos.x) * 16.0f;
+        float height = (v[2].pos.y - v[0].pos.y) * 16.0f;
+        if (!(width > 0.0f && width <= 65535.0f && height > 0.0f &&
+              height <= 65535.0f))
+            return false;
+        const float uv[4] = {v[0].uv.x, v[0].uv.y, v[2].uv.x, v[2].uv.y};
+        for (int c = 0; c < 4; c++)
+        {
+            if (!(uv[c] >= 0.0f && uv[c] <= 1.0f)) return false;
+            quad.uv[c] = (uint16_t)(uv[c] * 65535.0f + 0.5f);
+        }
+        quad.x = v[0].pos.x;
+        quad.y = v[0].pos.y;
+        quad.width = (uint16_t)(width + 0.5f);
+        quad.height = (uint16_t)(height + 0.5f);
+        quad.col = v[0].col;
+        return true;
+    };
+
+    const unsigned min_run = (unsigned)std::max(mInstancedQuadMinRun, 1);
+    QuadInstance quad;
+    for (int cmd_i = 0; cmd_i < cmdList->CmdBuffer.Size; cmd_i++)
+    {
+        const ImDrawCmd& cmd = cmdList->CmdBuffer[cmd_i];
+        if (cmd.UserCallback || cmd.ElemCount == 0) continue;
+
+        // Spans never cross commands, so each draw finds whole spans
+        bool open = false;
+        unsigned i = cmd.IdxOffset;
+        const unsigned end = cmd.IdxOffset + cmd.ElemCount;
+        while (i < end)
+        {
+            size_t inst_begin = mQuadInstances.size();
+            unsigned run_end = i;
+            while (run_end + 6 <= end && to_quad(run_end, quad))
+            {
+                mQuadInstances.push_back(quad);
+                run_end += 6;
+            }
+            unsigned run = (run_end - i) / 6;
+            if (run >= min_run)
+            {
+                QuadSpan span;
+                span.idxBegin = i;
+                span.idxEnd = run_end;
+                span.first = (unsigned)(inst_begin - draw.instOffset);
+                span.count = run;
+                span.instanced = true;
+                mQuadSpans.push_back(span);
+                open = false;
+                i = run_end;
+                continue;
+            }
+
+            // Short runs aren't worth a draw, they stay triangles along with
+            // everything else
+            mQuadInstances.resize(inst_begin);
+            if (!open)
+            {
+                QuadSpan span;
+                span.idxBegin = i;
+                span.idxEnd = i;
+                span.first = (unsigned)(mQuadIndices.size() - draw.quadIdx);
+                mQuadSpans.push_back(span);
+                open = true;
+            }
+            QuadSpan& span = mQuadSpans.back();
+            unsigned tri_end = run ? run_end : i + 3;
+            for (; i < tri_end; i++)
+            {
+                int& to = mQuadRemap[idx[i]];
+                if (to < 0)
+                {
+                    to = (int)(mQuadVertices.size() - draw.quadVtx);
+                    mQuadVertices.push_back(vtx[idx[i]]);
+                }
+                mQuadIndices.push_back((ImDrawIdx)to);
+            }
+            span.idxEnd = i;
+            span.count = (unsigned)(mQuadIndices.size() - draw.quadIdx) -
+                         span.first;
+        }
+    }
+    draw.vtxCount = (int)mQuadVertices.size() - draw.quadVtx;
+    draw.idxCount = (int)mQuadIndices.size() - draw.quadIdx;
+    draw.spanEnd = (int)mQuadSpans.size();
+    return true;
+}
+
+void OpenGLImGuiManager::drawQuadSpans(const ImGuiRenderOp& op,
+                                       const ListDraw& draw,
+                                       unsigned vertexArray, DrawState& state)
+{
+    const GLenum idx_type =
+        sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    const unsigned idx_end = op.idxOffset + op.elemCount;
+    auto spans_end = mQuadSpans.begin() + draw.spanEnd;
+    auto span = std::lower_bound(
+        mQuadSpans.begin() + draw.spanBegin, spans_end, op.idxOffset,
+        [](const QuadSpan& s, unsigned i) { return s.idxEnd <= i; });
+    for (; span != spans_end && span->idxBegin < idx_end; ++span)
+    {
+        bindQuadInstances(span->instanced, vertexArray, state);
+        if (span->instanced)
+        {
+            // Without base instance draws the attributes have to start at
+            // the span's first instance
+            setInstanceAttributes((size_t)(draw.instOffset + span->first) *
+                                  sizeof(QuadInstance));
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                                  (GLsizei)span->count);
+            frameStats.instancedQuads += span->count;
+        }
+        else
+        {
+            const GLvoid* idx_offset = (const GLvoid*)(intptr_t)(
+                (draw.idxOffset + span->first) * sizeof(ImDrawIdx));
+            glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)span->count,
+                                     idx_type, idx_offset,
+                                     (GLint)draw.vtxOffset);
+        }
+        frameStats.drawCalls++;
+    }
+}
+
+void OpenGLImGuiManager::bindQuadInstances(bool instanced,
+                                           unsigned vertexArray,
+                                           DrawState& state)
+{
+    if (state.instanced == instanced) return;
+    glBindVertexArray(instanced ? mQuadVertexArray : vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, instanced ? mInstanceVboHandle : mVboHandle);
+    glUniform1i(mAttribLocationInstanced, instanced ? 1 : 0);
+    state.instanced = instanced;
+}
+
+void OpenGLImGuiManager::setInstancedQuads(bool enabled, int minRun)
+{
+    mInstancedQuads = enabled;
+    mInstancedQuadMinRun = minRun;
+}
+
+void OpenGLImGuiManager::setAnalyticShapes(bool enabled)
+{
+    mAnalyticShapes = enabled;
+    analyticShapes = enabled && mVertexTexture;
+}
+
+void OpenGLImGuiManager::setScissor(const int scissor[4], DrawState& state)
+{
+    if (memcmp(scissor, state.scissor, sizeof(state.scissor)) == 0) return;
+    glScissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+    memcpy(state.scissor, scissor, sizeof(state.scissor));
+    frameStats.scissorChanges++;
+}
+
+OpenGLImGuiManager::WindowCache*
+OpenGLImGuiManager::updateWindowCache(ImDrawData* drawData,
+                                      const ImDrawList* cmdList,
+                                      const ImVec2& fbSize)
+{
+    if (cmdList->VtxBuffer.Size < mWindowCacheMinVertices) return nullptr;
+
+    // Only the font atlas may be sampled, other textures can change without
+    // the list changing, and callbacks could draw anything. The cache covers
+    // the union of the clip rects in framebuffer pixels.
+    ImVec2 scale = framebufferScale(drawData);
+    ImVec2 pos = drawData->DisplayPos;
+    float x0 = fbSize.x, y0 = fbSize.y, x1 = 0.0f, y1 = 0.0f;
+    uint64_t hash = hashBytes(&pos, sizeof(pos), 0);
+    hash = hashBytes(&scale, sizeof(scale), hash);
+    for (int cmd_i = 0; cmd_i < cmdList->CmdBuffer.Size; cmd_i++)
+    {
+        const ImDrawCmd& cmd = cmdList->CmdBuffer[cmd_i];
+        if (cmd.UserCallback ||
+            (cmd.ElemCount > 0 &&
+             (GLuint)(intptr_t)cmd.TextureId != mFontTexture))
+            return nullptr;
+        if (cmd.ElemCount == 0) continue;
+        x0 = std::min(x0, (cmd.ClipRect.x - pos.x) * scale.x);
+        y0 = std::min(y0, (cmd.ClipRect.y - pos.y) * scale.y);
+        x1 = std::max(x1, (cmd.ClipRect.z - pos.x) * scale.x);
+        y1 = std::max(y1, (cmd.ClipRect.w - pos.y) * scale.y);
+        unsigned fields[3] = {cmd.VtxOffset, cmd.IdxOffset, cmd.ElemCount};
+        hash = hashBytes(&cmd.ClipRect, sizeof(cmd.ClipRect), hash);
+        hash = hashBytes(fields, sizeof(fields), hash);
+    }
+    int px0 = std::max(0, (int)std::floor(x0));
+    int py0 = std::max(0, (int)std::floor(y0));
+    int px1 = std::min((int)fbSize.x, (int)std::ceil(x1));
+    int py1 = std::min((int)fbSize.y, (int)std::ceil(y1));
+    if (px1 <= px0 || py1 <= py0) return nullptr;
+
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::updateWindowCache");
+    int sizes[2] = {cmdList->VtxBuffer.Size, cmdList->IdxBuffer.Size};
+    hash = hashBytes(sizes, sizeof(sizes), hash);
+
+    // The commands and buffer sizes already tell most changes apart, the
+    // buffers themselves are only hashed when those match
+    WindowCache& cache = mWindowCaches[cmdList];
+    cache.lastFrame = mWindowCacheFrame;
+    uint64_t layout = hash;
+    bool same_layout = cache.layout == layout;
+    if (same_layout)
+    {
+        hash = hashWords(cmdList->VtxBuffer.Data,
+                         cmdList->VtxBuffer.Size * sizeof(ImDrawVert), hash);
+        hash = hashWords(cmdList->IdxBuffer.Data,
+                         cmdList->IdxBuffer.Size * sizeof(ImDrawIdx), hash);
+    }
+
+    // A list is cached once its layout and then its full hash have held
+    // from one frame to the next, so windows that change every frame don't
+    // pay for the extra pass
+    if (!same_layout || cache.hash != hash || cache.x != px0 ||
+        cache.y != py0 || cache.width != px1 - px0 ||
+        cache.height != py1 - py0)
+    {
+        cache.layout = layout;
+        cache.hash = same_layout ? hash : 0;
+        cache.x = px0;
+        cache.y = py0;
+        cache.width = px1 - px0;
+        cache.height = py1 - py0;
+        cache.valid = false;
+        cache.stable = false;
+        return nullptr;
+    }
+    cache.stable = true;
+    return &cache;
+}
+
+void OpenGLImGuiManager::renderWindowCache(ImDrawData* drawData,
+                                           const ImDrawList* cmdList,
+                                           WindowCache& cache,
+                                           const ListDraw& draw,
+                                           unsigned vertexArray,
+                                           DrawState& state)
+{
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::renderWindowCache");
+    if (!cache.texture || cache.textureWidth != cache.width ||
+        cache.textureHeight != cache.height)
+    {
+        if (!cache.texture) glGenTextures(1, &cache.texture);
+        if (!cache.framebuffer) glGenFramebuffers(1, &cache.framebuffer);
+        glBindTexture(GL_TEXTURE_2D, cache.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cache.width, cache.height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindFramebuffer(GL_FRAMEBUFFER, cache.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, cache.texture, 0);
+        cache.textureWidth = cache.width;
+        cache.textureHeight = cache.height;
+        state.textureBound = false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, cache.framebuffer);
+    glViewport(0, 0, cache.width, cache.height);
+    glDisable(GL_SCISSOR_TEST);
+    const GLfloat transparent[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, transparent);
+    glEnable(GL_SCISSOR_TEST);
+
+    // Accumulate premultiplied color so the texture composites exactly like
+    // drawing the list directly would have blended. The whole list goes in,
+    // since what covers it can change while the cache stays valid.
+    ImVec2 scale = framebufferScale(drawData);
+    ImVec2 origin(drawData->DisplayPos.x + cache.x / scale.x,
+                  drawData->DisplayPos.y + cache.y / scale.y);
+    setProjection(ImVec4(origin.x, origin.x + cache.width / scale.x, origin.y,
+                         origin.y + cache.height / scale.y));
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                        GL_ONE_MINUS_SRC_ALPHA);
+    DrawState cache_state;
+    drawCommands(drawData, cmdList, origin, scale, cache.width, cache.height,
+                 draw, vertexArray, cache_state);
+
+    // Back to the frame's target
+    glBindFramebuffer(GL_FRAMEBUFFER, mTargetFramebuffer);
+    ImVec2 fb_size = framebufferSize(drawData);
+    glViewport(0, 0, (GLsizei)fb_size.x, (GLsizei)fb_size.y);
+    setProjection(mProjection);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.texture = cache_state.texture;
+    state.textureBound = cache_state.textureBound;
+    state.scissor[2] = -1;
+    cache.valid = true;
+}
+
+void OpenGLImGuiManager::drawWindowCache(ImDrawData* drawData,
+                                         const WindowCache& cache,
+                                         int fbHeight, DrawState& state)
+{
+    ImVec2 scale = framebufferScale(drawData);
+    float x0 = drawData->DisplayPos.x + cache.x / scale.x;
+    float y0 = drawData->DisplayPos.y + cache.y / scale.y;
+    float x1 = x0 + cache.width / scale.x;
+    float y1 = y0 + cache.height / scale.y;
+    const ImDrawVert quad[4] = {
+        {ImVec2(x0, y0), ImVec2(0.0f, 1.0f), IM_COL32_WHITE},
+        {ImVec2(x1, y0), ImVec2(1.0f, 1.0f), IM_COL32_WHITE},
+        {ImVec2(x0, y1), ImVec2(0.0f, 0.0f), IM_COL32_WHITE},
+        {ImVec2(x1, y1), ImVec2(1.0f, 0.0f), IM_COL32_WHITE},
+    };
+    glBindBuffer(GL_ARRAY_BUFFER, mQuadVboHandle);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STREAM_DRAW);
+    setVertexAttributes();
+
+    int scissor[4] = {cache.x, fbHeight - cache.y - cache.height, cache.width,
+                      cache.height};
+    setScissor(scissor, state);
+    if (!state.textureBound || state.texture != cache.texture)
+    {
+        if (mFontSdf) glUniform1i(mAttribLocationMode, 0);
+        glBindTexture(GL_TEXTURE_2D, cache.texture);
+        state.texture = cache.texture;
+        state.textureBound = true;
+        frameStats.textureBinds++;
+    }
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    frameStats.drawCalls++;
+    frameStats.cachedDraws++;
+
+    glBindBuffer(GL_ARRAY_BUFFER, mVboHandle);
+    setVertexAttributes();
+}
+
+void OpenGLImGuiManager::evictWindowCaches()
+{
+    for (auto it = mWindowCaches.begin(); it != mWindowCaches.end();)
+    {
+        if (it->second.lastFrame != mWindowCacheFrame)
+        {
+            if (it->second.framebuffer)
+                glDeleteFramebuffers(1, &it->second.framebuffer);
+            if (it->second.texture) glDeleteTextures(1, &it->second.texture);
+            it = mWindowCaches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    mWindowCacheFrame++;
+}
+
+ImTextureID OpenGLImGuiManager::loadTexture(std::vector<uint8_t> pixels,
+                                            int width, int height,
+                                            PixelFormat format,
+                                            bool premultiply)
+{
+    if (width <= 0 || height <= 0 ||
+        pixels.size() < (size_t)width * height * 4)
+    {
+        fprintf(stderr, "ERROR: Texture pixels don't match its size!\n");
+        return nullptr;
+    }
+
+    // Allocate the storage now so the ID is valid, it's filled once the
+    // pixels are converted
+    std::unique_ptr<TextureUpload> upload(new TextureUpload());
+    GLint last_texture;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    glGenTextures(1, &upload->texture);
+    glBindTexture(GL_TEXTURE_2D, upload->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, last_texture);
+
+    upload->width = width;
+    upload->height = height;
+    upload->format = format;
+    upload->premultiply = premultiply;
+    upload->pixels = std::move(pixels);
+    mPendingTextures.insert(upload->texture);
+    ImTextureID id = (ImTextureID)(intptr_t)upload->texture;
+    mUploads.push_back(std::move(upload));
+    updateTextureUploads();
+    return id;
+}
+
+ImTextureID OpenGLImGuiManager::createTexture(int width, int height)
+{
+    GLint last_texture;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, last_texture);
+    return (ImTextureID)(intptr_t)texture;
+}
+
+void OpenGLImGuiManager::updateTexture(ImTextureID texture, int x, int y,
+                                       int width, int height,
+                                       const uint8_t* pixels)
+{
+    const GLuint handle = (GLuint)(intptr_t)texture;
+    const size_t bytes = (size_t)width * height * 4;
+    GLint last_texture, last_unpack_buffer;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &last_unpack_buffer);
+    glBindTexture(GL_TEXTURE_2D, handle);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // RGBA8 needs no conversion, so the pixels go into the buffer here and
+    // the copy is issued right away, ahead of this frame's draws
+    int buffer = -1;
+    for (int b = 0; b < kPixelBufferCount; b++)
+    {
+        if (mPixelBufferBusy[b]) continue;
+        if (!mPixelBuffers[b]) glGenBuffers(1, &mPixelBuffers[b]);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPixelBuffers[b]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)bytes, nullptr,
+                     GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            memcpy(mapped, pixels, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            buffer = b;
+        }
+        break;
+    }
+    if (buffer >= 0)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA,
+                        GL_UNSIGNED_BYTE, nullptr);
+
+        // Keeps the buffer until the copy is done
+        std::unique_ptr<TextureUpload> upload(new TextureUpload());
+        upload->texture = handle;
+        upload->region = true;
+        upload->width = width;
+        upload->height = height;
+        upload->buffer = buffer;
+        upload->copied = true;
+        if (glFenceSync)
+            upload->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        mPixelBufferBusy[buffer] = true;
+        mUploads.push_back(std::move(upload));
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA,
+                        GL_UNSIGNED_BYTE, pixels);
+    }
+    frameStats.bytesUploaded += bytes;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, last_unpack_buffer);
+    glBindTexture(GL_TEXTURE_2D, last_texture);
+}
+
+bool OpenGLImGuiManager::isTextureReady(ImTextureID texture) const
+{
+    return mPendingTextures.count((unsigned)(intptr_t)texture) == 0;
+}
+
+void OpenGLImGuiManager::destroyTexture(ImTextureID texture)
+{
+    GLuint handle = (GLuint)(intptr_t)texture;
+    bool uploading = false;
+    for (auto& upload : mUploads)
+    {
+        if (upload->texture == handle)
+        {
+            // Retired by updateTextureUploads() once nothing uses it
+            upload->destroyed = true;
+            uploading = true;
+        }
+    }
+    if (!uploading) glDeleteTextures(1, &handle);
+}
+
+ImTextureID OpenGLImGuiManager::addAtlasImage(std::vector<uint8_t> pixels,
+                                              int width, int height,
+                                              PixelFormat format,
+                                              bool premultiply)
+{
+    if (width <= 0 || height <= 0 ||
+        pixels.size() < (size_t)width * height * 4)
+    {
+        fprintf(stderr, "ERROR: Atlas image pixels don't match its size!\n");
+        return nullptr;
+    }
+    if (width + 2 > mAtlasPageSize || height + 2 > mAtlasPageSize)
+    {
+        fprintf(stderr, "ERROR: Image is too large for the image atlas!\n");
+        return nullptr;
+    }
+
+    // Convert in place, then copy into the middle of the padded image and
+    // repeat the edges out into the border
+    convertPixels(pixels.data(), pixels.data(), (size_t)width * height,
+                  format, premultiply);
+    std::unique_ptr<AtlasImage> image(new AtlasImage());
+    image->width = width;
+    image->height = height;
+    const int stride = (width + 2) * 4;
+    image->pixels.resize((size_t)stride * (height + 2));
+    for (int y = 0; y < height + 2; y++)
+    {
+        int src_y = std::min(std::max(y - 1, 0), height - 1);
+        const uint8_t* src = pixels.data() + (size_t)src_y * width * 4;
+        uint8_t* dst = image->pixels.data() + (size_t)y * stride;
+        memcpy(dst, src, 4);
+        memcpy(dst + 4, src, (size_t)width * 4);
+        memcpy(dst + stride - 4, src + (width - 1) * 4, 4);
+    }
+
+    // The image's own address is its ID, which can't collide with a GL
+    // texture name
+    ImTextureID id = (ImTextureID)image.get();
+    mAtlasImages[id] = std::move(image);
+    return id;
+}
+
+void OpenGLImGuiManager::removeAtlasImage(ImTextureID image)
+{
+    auto it = mAtlasImages.find(image);
+    if (it == mAtlasImages.end()) return;
+    AtlasImage* entry = it->second.get();
+    if (entry->page >= 0)
+    {
+        std::vector<AtlasImage*>& images = mAtlasPages[entry->page].images;
+        images.erase(std::find(images.begin(), images.end(), entry));
+    }
+    mAtlasImages.erase(it);
+}
+
+void OpenGLImGuiManager::setImageAtlas(int pageSize, int maxPages)
+{
+    if (pageSize == mAtlasPageSize && maxPages == mAtlasMaxPages) return;
+    destroyImageAtlas();
+    mAtlasPageSize = pageSize;
+    mAtlasMaxPages = std::max(maxPages, 1);
+}
+
+ImDrawData* OpenGLImGuiManager::remapAtlasImages(ImDrawData* drawData)
+{
+    if (mAtlasImages.empty()) return drawData;
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::remapAtlasImages");
+    mAtlasFrame++;
+    GLint last_texture, last_unpack_buffer;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &last_unpack_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    bool remapped = false;
+    mAtlasCmdLists.resize(drawData->CmdListsCount);
+    for (int n = 0; n < drawData->CmdListsCount; n++)
+    {
+        ImDrawList* src_list = drawData->CmdLists[n];
+        ImDrawList* cmd_list = src_list;
+        for (int cmd_i = 0; cmd_i < src_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd& src_cmd = src_list->CmdBuffer[cmd_i];
+            if (src_cmd.UserCallback || src_cmd.ElemCount == 0) continue;
+            auto it = mAtlasImages.find(src_cmd.TextureId);
+            if (it == mAtlasImages.end()) continue;
+            AtlasImage& image = *it->second;
+
+            // Copy the list on its first atlas image
+            if (cmd_list == src_list)
+            {
+                AtlasList& copy = mAtlasLists[src_list];
+                if (!copy.list)
+                    copy.list =
+                        IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData());
+                copy.lastFrame = mAtlasFrame;
+                cmd_list = copy.list;
+                copyVector(cmd_list->CmdBuffer, src_list->CmdBuffer);
+                copyVector(cmd_list->VtxBuffer, src_list->VtxBuffer);
+                copyVector(cmd_list->IdxBuffer, src_list->IdxBuffer);
+                cmd_list->Flags = src_list->Flags;
+                mAtlasRemapped.assign((cmd_list->VtxBuffer.Size + 31) / 32,
+                                      0);
+                remapped = true;
+            }
+            ImDrawCmd& cmd = cmd_list->CmdBuffer[cmd_i];
+
+            // Every page is already in use this frame
+            if (image.page < 0 && !packAtlasImage(image))
+            {
+                cmd.ElemCount = 0;
+                continue;
+            }
+            AtlasPage& page = mAtlasPages[image.page];
+            page.lastFrame = mAtlasFrame;
+
+            // Only the vertices the command's indices reference are its own.
+            // Channels of an ImDrawListSplitter share the vertex buffer, so
+            // other draws' vertices can lie between them.
+            const ImDrawIdx* idx = cmd_list->IdxBuffer.Data + cmd.IdxOffset;
+            const float scale_u = image.uv1.x - image.uv0.x;
+            const float scale_v = image.uv1.y - image.uv0.y;
+            for (unsigned i = 0; i < cmd.ElemCount; i++)
+            {
+                unsigned v = cmd.VtxOffset + idx[i];
+                uint32_t bit = 1u << (v & 31);
+                if (mAtlasRemapped[v >> 5] & bit) continue;
+                mAtlasRemapped[v >> 5] |= bit;
+                ImDrawVert& vert = cmd_list->VtxBuffer.Data[v];
+                vert.uv.x = image.uv0.x + vert.uv.x * scale_u;
+                vert.uv.y = image.uv0.y + vert.uv.y * scale_v;
+            }
+            cmd.TextureId = (ImTextureID)(intptr_t)page.texture;
+        }
+        mAtlasCmdLists[n] = cmd_list;
+    }
+
+    // Drop the copies of lists no longer drawing atlas images
+    for (auto it = mAtlasLists.begin(); it != mAtlasLists.end();)
+    {
+        if (it->second.lastFrame != mAtlasFrame)
+        {
+            IM_DELETE(it->second.list);
+            it = mAtlasLists.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, last_unpack_buffer);
+    glBindTexture(GL_TEXTURE_2D, last_texture);
+    if (!remapped) return drawData;
+
+    mAtlasDrawData = *drawData;
+#if IMGUI_VERSION_NUM >= 18973
+    mAtlasDrawData.CmdLists.resize(0);
+    for (ImDrawList* list : mAtlasCmdLists)
+        mAtlasDrawData.CmdLists.push_back(list);
+#else
+    mAtlasDrawData.CmdLists = mAtlasCmdLists.data();
+#endif
+    return &mAtlasDrawData;
+}
+
+bool OpenGLImGuiManager::packAtlasImage(AtlasImage& image)
+{
+    const int width = image.width + 2, height = image.height + 2;
+    int x = 0, y = 0;
+    size_t p = 0;
+    while (p < mAtlasPages.size() &&
+           !mAtlasPages[p].packer.pack(width, height, x, y))
+        p++;
+    if (p == mAtlasPages.size())
+    {
+        if ((int)mAtlasPages.size() < mAtlasMaxPages)
+        {
+            AtlasPage page;
+            glGenTextures(1, &page.texture);
+            glBindTexture(GL_TEXTURE_2D, page.texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                            GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                            GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mAtlasPageSize,
+                         mAtlasPageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         nullptr);
+            page.packer.reset(mAtlasPageSize, mAtlasPageSize);
+            mAtlasPages.push_back(std::move(page));
+        }
+        else
+        {
+            // Clear the least recently drawn page, pages drawn from this
+            // frame already have draws pointing at them
+            size_t lru = mAtlasPages.size();
+            for (size_t i = 0; i < mAtlasPages.size(); i++)
+            {
+                unsigned used = mAtlasPages[i].lastFrame;
+                if (used != mAtlasFrame &&
+                    (lru == mAtlasPages.size() ||
+                     used < mAtlasPages[lru].lastFrame))
+                    lru = i;
+            }
+            if (lru == mAtlasPages.size()) return false;
+            p = lru;
+            AtlasPage& page = mAtlasPages[p];
+            for (AtlasImage* evicted : page.images)
+                evicted->page = -1;
+            page.images.clear();
+            page.packer.reset(mAtlasPageSize, mAtlasPageSize);
+        }
+        if (!mAtlasPages[p].packer.pack(width, height, x, y)) return false;
+    }
+
+    AtlasPage& page = mAtlasPages[p];
+    glBindTexture(GL_TEXTURE_2D, page.texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA,
+                    GL_UNSIGNED_BYTE, image.pixels.data());
+    frameStats.bytesUploaded += image.pixels.size();
+
+    const float texel = 1.0f / (float)mAtlasPageSize;
+    image.uv0 = ImVec2((x + 1) * texel, (y + 1) * texel);
+    image.uv1 = ImVec2((x + 1 + image.width) * texel,
+                       (y + 1 + image.height) * texel);
+    image.page = (int)p;
+    page.images.push_back(&image);
+    return true;
+}
+
+void OpenGLImGuiManager::destroyImageAtlas()
+{
+    // Images keep their pixels and are packed again on their next draw
+    for (AtlasPage& page : mAtlasPages)
+    {
+        for (AtlasImage* image : page.images)
+            image->page = -1;
+        if (page.texture) glDeleteTextures(1, &page.texture);
+    }
+    mAtlasPages.clear();
+    for (auto& list : mAtlasLists)
+        IM_DELETE(list.second.list);
+    mAtlasLists.clear();
+}
+
+void OpenGLImGuiManager::updateTextureUploads()
+{
+    if (mUploads.empty()) return;
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::updateTextureUploads");
+    WorkerPool& workers = getWorkerPool();
+    GLint last_texture, last_unpack_buffer;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &last_unpack_buffer);
 
-OpenGLImGuiManager::~OpenGLImGuiManager() { destroyDeviceObjects(); }
+    for (size_t i = 0; i < mUploads.size();)
+    {
+        TextureUpload& upload = *mUploads[i];
+        size_t bytes = (size_t)upload.width * upload.height * 4;
 
-void OpenGLImGuiManager::init()
+        // Map a free pixel buffer and convert into it on a worker
+        if (upload.buffer < 0 && !upload.destroyed)
+        {
+            for (int b = 0; b < kPixelBufferCount; b++)
+            {
+                if (mPixelBufferBusy[b]) continue;
+                if (!mPixelBuffers[b]) glGenBuffers(1, &mPixelBuffers[b]);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPixelBuffers[b]);
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)bytes,
+                             nullptr, GL_STREAM_DRAW);
+                upload.mapped = glMapBufferRange(
+                    GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)bytes,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+                if (!upload.mapped) break;
+                upload.buffer = b;
+                mPixelBufferBusy[b] = true;
+                TextureUpload* job = &upload;
+                workers.submit(mUploadJobs, [job] {
+                    convertPixels(job->pixels.data(), (uint8_t*)job->mapped,
+                                  (size_t)job->width * job->height,
+                                  job->format, job->premultiply);
+                    std::vector<uint8_t>().swap(job->pixels);
+                    job->converted.store(true, std::memory_order_release);
+                });
+                break;
+            }
+        }
+
+        // Copy the converted pixels to the texture on the GPU's timeline
+        if (upload.buffer >= 0 && !upload.copied &&
+            upload.converted.load(std::memory_order_acquire))
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPixelBuffers[upload.buffer]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            upload.mapped = nullptr;
+            if (!upload.destroyed)
+            {
+                glBindTexture(GL_TEXTURE_2D, upload.texture);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, upload.width,
+                                upload.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                                nullptr);
+                frameStats.bytesUploaded += bytes;
+
+                // Fences are core since GL 3.2, without them the texture is
+                // shown right away and the driver orders the copy
+                if (glFenceSync)
+                    upload.fence =
+                        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+            upload.copied = true;
+        }
+
+        // Retire it once the copy is done
+        bool done = upload.copied || (upload.destroyed && upload.buffer < 0);
+        if (upload.fence)
+        {
+            GLsync fence = (GLsync)upload.fence;
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            done = status == GL_ALREADY_SIGNALED ||
+                   status == GL_CONDITION_SATISFIED;
+            if (done) glDeleteSync(fence);
+        }
+        if (done)
+        {
+            if (upload.buffer >= 0) mPixelBufferBusy[upload.buffer] = false;
+
+            // A destroyed texture goes with the last upload into it
+            bool last = upload.destroyed;
+            for (size_t j = 0; last && j < mUploads.size(); j++)
+                last = j == i || mUploads[j]->texture != upload.texture;
+            if (last) glDeleteTextures(1, &upload.texture);
+            if (!upload.region) mPendingTextures.erase(upload.texture);
+            mUploads.erase(mUploads.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, last_unpack_buffer);
+    glBindTexture(GL_TEXTURE_2D, last_texture);
+}
+
+void OpenGLImGuiManager::destroyTextureUploads()
 {
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
+    if (workerPool) workerPool->wait(mUploadJobs);
+    for (auto& upload : mUploads)
+    {
+        if (upload->mapped)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPixelBuffers[upload->buffer]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        if (upload->fence) glDeleteSync((GLsync)upload->fence);
 
-    // Setup CrossWindow event mapping:
-    ImGuiManager::create();
+        // Textures only being updated still belong to their creator
+        if (!upload->region || upload->destroyed)
+            glDeleteTextures(1, &upload->texture);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    mUploads.clear();
+    mPendingTextures.clear();
+    for (int b = 0; b < kPixelBufferCount; b++)
+    {
+        if (mPixelBuffers[b]) glDeleteBuffers(1, &mPixelBuffers[b]);
+        mPixelBuffers[b] = 0;
+        mPixelBufferBusy[b] = false;
+    }
+}
+
+void OpenGLImGuiManager::captureFrame(
+    std::function<void(CaptureImage&)> done)
+{
+    mCaptureRequests.push_back(std::move(done));
+}
+
+void OpenGLImGuiManager::saveScreenshot(const std::string& path,
+                                        CaptureFormat format)
+{
+    captureFrame([path, format](CaptureImage& image) {
+        writeCapture(path.c_str(), image, format);
+    });
+}
+
+void OpenGLImGuiManager::startRecording(const std::string& prefix,
+                                        CaptureFormat format)
+{
+    mRecording = true;
+    mRecordingPrefix = prefix;
+    mRecordingFormat = format;
+}
+
+void OpenGLImGuiManager::stopRecording() { mRecording = false; }
+
+bool OpenGLImGuiManager::isRecording() const { return mRecording; }
+
+void OpenGLImGuiManager::flushCaptures()
+{
+    // Map every readback, then let the workers finish with them
+    updateCaptures(true);
+    if (workerPool) workerPool->wait(mCaptureJobs);
+    updateCaptures(false);
+}
+
+unsigned OpenGLImGuiManager::getDroppedCaptures() const
+{
+    return mDroppedCaptures;
+}
+
+void OpenGLImGuiManager::readbackFrame(int fbWidth, int fbHeight)
+{
+    if (mCaptureRequests.empty() && !mRecording) return;
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::readbackFrame");
+
+    // Bound the images held in memory while the workers catch up
+    const unsigned max_in_flight =
+        2 * std::max(1u, std::thread::hardware_concurrency());
+    int buffer = -1;
+    for (int b = 0; b < kCaptureBufferCount && buffer < 0; b++)
+        if (!mCaptureBufferBusy[b]) buffer = b;
+    if (buffer < 0 || mCapturesInFlight.load(std::memory_order_relaxed) >=
+                          max_in_flight)
+    {
+        // Requested captures take the next frame, recording skips this one
+        if (mRecording) mDroppedCaptures++;
+        return;
+    }
+
+    std::unique_ptr<FrameCapture> capture(new FrameCapture());
+    capture->done.swap(mCaptureRequests);
+    if (mRecording)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%06llu%s",
+                 (unsigned long long)mCaptureFrame,
+                 mRecordingFormat == CaptureFormat::Png ? ".png" : ".raw");
+        std::string path = mRecordingPrefix + name;
+        CaptureFormat format = mRecordingFormat;
+        capture->done.push_back([path, format](CaptureImage& image) {
+            writeCapture(path.c_str(), image, format);
+        });
+    }
+    capture->frame = mCaptureFrame;
+    capture->width = fbWidth;
+    capture->height = fbHeight;
+    capture->buffer = buffer;
+
+    size_t bytes = (size_t)fbWidth * fbHeight * 4;
+    GLint last_pack_buffer, last_read_framebuffer;
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &last_pack_buffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &last_read_framebuffer);
+    if (!mCaptureBuffers[buffer]) glGenBuffers(1, &mCaptureBuffers[buffer]);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, mCaptureBuffers[buffer]);
+    if (mCaptureBufferBytes[buffer] != bytes)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bytes, nullptr,
+                     GL_STREAM_READ);
+        mCaptureBufferBytes[buffer] = bytes;
+    }
+
+    // BGRA is what window framebuffers usually hold, so the GPU copies it
+    // as is and the workers swizzle it
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mTargetFramebuffer);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glReadPixels(0, 0, fbWidth, fbHeight, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    if (glFenceSync)
+        capture->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, last_read_framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, last_pack_buffer);
+
+    mCaptureBufferBusy[buffer] = true;
+    mCapturesInFlight.fetch_add(1, std::memory_order_relaxed);
+    frameStats.bytesCaptured += bytes;
+    mCaptures.push_back(std::move(capture));
+}
+
+void OpenGLImGuiManager::updateCaptures(bool wait)
+{
+    if (mCaptures.empty()) return;
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::updateCaptures");
+    WorkerPool& workers = getWorkerPool();
+    GLint last_pack_buffer;
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &last_pack_buffer);
+
+    for (size_t i = 0; i < mCaptures.size();)
+    {
+        FrameCapture& capture = *mCaptures[i];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, mCaptureBuffers[capture.buffer]);
+
+        // Map the buffer once the GPU has written it and convert out of it
+        // on a worker. Without fences the map waits for the copy instead.
+        if (!capture.mapped)
+        {
+            bool ready = true;
+            if (capture.fence)
+            {
+                GLsync fence = (GLsync)capture.fence;
+                GLenum status =
+                    wait ? glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                            1000000000ull)
+                         : glClientWaitSync(fence, 0, 0);
+                ready = status == GL_ALREADY_SIGNALED ||
+                        status == GL_CONDITION_SATISFIED;
+                if (ready)
+                {
+                    glDeleteSync(fence);
+                    capture.fence = nullptr;
+                }
+            }
+            if (ready)
+            {
+                capture.mapped = glMapBufferRange(
+                    GL_PIXEL_PACK_BUFFER, 0,
+                    (GLsizeiptr)capture.width * capture.height * 4,
+                    GL_MAP_READ_BIT);
+                if (!capture.mapped)
+                {
+                    fprintf(stderr, "ERROR: Failed to map a capture!\n");
+                    mCaptureBufferBusy[capture.buffer] = false;
+                    mCapturesInFlight.fetch_sub(1, std::memory_order_relaxed);
+                    mCaptures.erase(mCaptures.begin() + i);
+                    continue;
+                }
+
+                FrameCapture* job = &capture;
+                std::vector<std::function<void(CaptureImage&)>> done;
+                done.swap(capture.done);
+                std::atomic<unsigned>* in_flight = &mCapturesInFlight;
+                workers.submit(mCaptureJobs, [job, done, in_flight] {
+                    CaptureImage image;
+                    image.frame = job->frame;
+                    image.width = job->width;
+                    image.height = job->height;
+                    image.pixels.resize((size_t)image.width * image.height *
+                                        4);
+                    convertReadback((const uint8_t*)job->mapped,
+                                    image.pixels.data(), image.width,
+                                    image.height);
+
+                    // The buffer is unmapped and the capture freed from here
+                    job->converted.store(true, std::memory_order_release);
+                    for (const auto& callback : done)
+                        callback(image);
+                    in_flight->fetch_sub(1, std::memory_order_relaxed);
+                });
+            }
+        }
+
+        // Free the buffer once the worker has its own copy
+        if (capture.mapped &&
+            capture.converted.load(std::memory_order_acquire))
+        {
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            mCaptureBufferBusy[capture.buffer] = false;
+            mCaptures.erase(mCaptures.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, last_pack_buffer);
+}
+
+void OpenGLImGuiManager::destroyCaptures()
+{
+    // Frames already read back are still handled
+    flushCaptures();
+    for (auto& capture : mCaptures)
+    {
+        if (capture->fence) glDeleteSync((GLsync)capture->fence);
+        mCapturesInFlight.fetch_sub(1, std::memory_order_relaxed);
+    }
+    mCaptures.clear();
+    for (int b = 0; b < kCaptureBufferCount; b++)
+    {
+        if (mCaptureBuffers[b]) glDeleteBuffers(1, &mCaptureBuffers[b]);
+        mCaptureBuffers[b] = 0;
+        mCaptureBufferBytes[b] = 0;
+        mCaptureBufferBusy[b] = false;
+    }
+}
+
+size_t OpenGLImGuiManager::stagingBytes() const
+{
+    size_t bytes = ImGuiManager::stagingBytes() +
+                   mListDraws.capacity() * sizeof(ListDraw) +
+                   mWindowCaches.size() * sizeof(WindowCache) +
+                   mQuadInstances.capacity() * sizeof(QuadInstance) +
+                   mQuadSpans.capacity() * sizeof(QuadSpan) +
+                   mQuadVertices.capacity() * sizeof(ImDrawVert) +
+                   mQuadIndices.capacity() * sizeof(ImDrawIdx) +
+                   mQuadRemap.capacity() * sizeof(int);
+    for (const auto& image : mAtlasImages)
+        bytes += sizeof(AtlasImage) + image.second->pixels.capacity();
+    for (const auto& list : mAtlasLists)
+        bytes += list.second.list->CmdBuffer.Capacity * sizeof(ImDrawCmd) +
+                 list.second.list->VtxBuffer.Capacity * sizeof(ImDrawVert) +
+                 list.second.list->IdxBuffer.Capacity * sizeof(ImDrawIdx);
+    bytes += mAtlasRemapped.capacity() * sizeof(uint32_t);
+    return bytes;
+}
+
+void OpenGLImGuiManager::trimStaging(ImGuiTrimPolicy policy)
+{
+    ImGuiManager::trimStaging(policy);
+    if (policy != ImGuiTrimPolicy::All) return;
+    mListDraws.shrink_to_fit();
+
+    // Only needed while drawing a frame
+    mQuadInstances = std::vector<QuadInstance>();
+    mQuadSpans = std::vector<QuadSpan>();
+    mQuadVertices = std::vector<ImDrawVert>();
+    mQuadIndices = std::vector<ImDrawIdx>();
+    mQuadRemap = std::vector<int>();
+
+    // Copied again from the lists they remap on the next frame
+    for (auto& list : mAtlasLists)
+        IM_DELETE(list.second.list);
+    mAtlasLists.clear();
+    mAtlasRemapped = std::vector<uint32_t>();
+}
+
+void OpenGLImGuiManager::setWindowCaching(bool enabled, int minVertices)
+{
+    mWindowCaching = enabled;
+    mWindowCacheMinVertices = minVertices;
+    if (!enabled)
+    {
+        mWindowCacheFrame++;
+        evictWindowCaches();
+    }
 }
 
 void OpenGLImGuiManager::renderDrawData(ImDrawData* drawData)
 {
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::renderDrawData");
+    ImGuiContextScope scope(context);
+    auto cpuStart = std::chrono::high_resolution_clock::now();
+    double lastGpuTimeMs = frameStats.gpuTimeMs;
+    frameStats = ImGuiFrameStats();
+    frameStats.gpuTimeMs = lastGpuTimeMs;
+
     // Avoid rendering when minimized, scale coordinates for retina displays
     // (screen coordinates != framebuffer coordinates)
     ImGuiIO& io = ImGui::GetIO();
-    int fb_width =
-        (int)(drawData->DisplaySize.x * io.DisplayFramebufferScale.x);
-    int fb_height =
-        (int)(drawData->DisplaySize.y * io.DisplayFramebufferScale.y);
+    ImVec2 fb_size = framebufferSize(drawData);
+    ImVec2 fb_scale = framebufferScale(drawData);
+    int fb_width = (int)fb_size.x;
+    int fb_height = (int)fb_size.y;
     if (fb_width <= 0 || fb_height <= 0) return;
-    drawData->ScaleClipRects(io.DisplayFramebufferScale);
+    cullOccludedCommands(drawData);
 
     // Backup GL state
     GLenum last_active_texture;
@@ -38,6 +1621,13 @@ void OpenGLImGuiManager::renderDrawData(ImDrawData* drawData)
     glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
     GLint last_texture;
     glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    GLint last_texture_buffer = 0;
+    if (mVertexTexture)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glGetIntegerv(GL_TEXTURE_BINDING_BUFFER, &last_texture_buffer);
+        glActiveTexture(GL_TEXTURE0);
+    }
     GLint last_sampler;
     glGetIntegerv(GL_SAMPLER_BINDING, &last_sampler);
     GLint last_array_buffer;
@@ -66,40 +1656,33 @@ void OpenGLImGuiManager::renderDrawData(ImDrawData* drawData)
     GLboolean last_enable_cull_face = glIsEnabled(GL_CULL_FACE);
     GLboolean last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
     GLboolean last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &mTargetFramebuffer);
+    updateTextureUploads();
+    updateCaptures(false);
+    drawData = remapAtlasImages(drawData);
 
-    // Setup render state: alpha-blending enabled, no face culling, no depth
-    // testing, scissor enabled, polygon fill
-    glEnable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_SCISSOR_TEST);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-    // Setup viewport, orthographic projection matrix
-    // Our visible imgui space lies from drawData->DisplayPps (top left) to
-    // drawData->DisplayPos+data_data->DisplaySize (bottom right). DisplayMin
-    // is typically (0,0) for single viewport apps.
-    glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
-    float L = drawData->DisplayPos.x;
-    float R = drawData->DisplayPos.x + drawData->DisplaySize.x;
-    float T = drawData->DisplayPos.y;
-    float B = drawData->DisplayPos.y + drawData->DisplaySize.y;
-    const float ortho_projection[4][4] = {
-        {2.0f / (R - L), 0.0f, 0.0f, 0.0f},
-        {0.0f, 2.0f / (T - B), 0.0f, 0.0f},
-        {0.0f, 0.0f, -1.0f, 0.0f},
-        {(R + L) / (L - R), (T + B) / (B - T), 0.0f, 1.0f},
-    };
-    glUseProgram(mShaderHandle);
-    glUniform1i(mAttribLocationTex, 0);
-    glUniformMatrix4fv(mAttribLocationProjMtx, 1, GL_FALSE,
-                       &ortho_projection[0][0]);
-    if (glBindSampler)
-        glBindSampler(0,
-                      0); // We use combined texture/sampler state. Applications
-                          // using GL 3.3 may set that otherwise.
+    // Time our draws on the GPU, picking up the result of the oldest query
+    // in the ring if the GPU is done with it
+    GLuint timer_query = 0;
+    if (mTimerQueries[0] && glGetQueryObjectui64v)
+    {
+        unsigned slot = mTimerQueryIndex++ % kTimerQueryCount;
+        timer_query = mTimerQueries[slot];
+        if (mTimerQueryIssued[slot])
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(timer_query, GL_QUERY_RESULT_AVAILABLE,
+                               &available);
+            if (available)
+            {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(timer_query, GL_QUERY_RESULT, &elapsed);
+                frameStats.gpuTimeMs = static_cast<double>(elapsed) / 1.0e6;
+            }
+        }
+        glBeginQuery(GL_TIME_ELAPSED, timer_query);
+        mTimerQueryIssued[slot] = true;
+    }
 
     // Recreate the VAO every time
     // (This is to easily allow multiple GL contexts. VAO are not shared among
@@ -107,77 +1690,201 @@ void OpenGLImGuiManager::renderDrawData(ImDrawData* drawData)
     // have an obvious key to use to cache them.)
     GLuint vao_handle = 0;
     glGenVertexArrays(1, &vao_handle);
-    glBindVertexArray(vao_handle);
-    glBindBuffer(GL_ARRAY_BUFFER, mVboHandle);
-    glEnableVertexAttribArray(mAttribLocationPosition);
-    glEnableVertexAttribArray(mAttribLocationUV);
-    glEnableVertexAttribArray(mAttribLocationColor);
-    glVertexAttribPointer(mAttribLocationPosition, 2, GL_FLOAT, GL_FALSE,
-                          sizeof(ImDrawVert),
-                          (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
-    glVertexAttribPointer(mAttribLocationUV, 2, GL_FLOAT, GL_FALSE,
-                          sizeof(ImDrawVert),
-                          (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
-    glVertexAttribPointer(mAttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE,
-                          sizeof(ImDrawVert),
-                          (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
 
-    // Draw
-    ImVec2 pos = drawData->DisplayPos;
+    // With base vertex draws every list goes into one pair of buffers sized
+    // by the shared policy, reallocated only when their size class changes
+    // and orphaned otherwise. Without it each list is uploaded before its
+    // draws.
+    const bool merged_upload =
+        (io.BackendFlags & ImGuiBackendFlags_RendererHasVtxOffset) != 0;
+
+    // Instanced draws and attribute divisors are core since GL 3.3. Quad
+    // instances read nothing but per instance attributes, from their own VAO.
+    const bool instanced_quads = mInstancedQuads && merged_upload &&
+                                 mInstanceVboHandle && glDrawArraysInstanced &&
+                                 glVertexAttribDivisor;
+    mQuadVertexArray = 0;
+    if (instanced_quads)
+    {
+        glGenVertexArrays(1, &mQuadVertexArray);
+        glBindVertexArray(mQuadVertexArray);
+        for (GLint location :
+             {mAttribLocationInstPos, mAttribLocationInstSize,
+              mAttribLocationInstUV, mAttribLocationInstColor})
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+    setupRenderState(drawData, fb_width, fb_height, vao_handle);
+
+    // Decide which lists are drawn from their window cache before uploading,
+    // so lists composited from a cached texture don't need their vertices
+    mListDraws.resize(drawData->CmdListsCount);
+    mQuadInstances.clear();
+    mQuadSpans.clear();
+    mQuadVertices.clear();
+    mQuadIndices.clear();
+    int vtx_total = 0, idx_total = 0;
     for (int n = 0; n < drawData->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = drawData->CmdLists[n];
-        const ImDrawIdx* idx_buffer_offset = 0;
+        ListDraw& draw = mListDraws[n];
+        draw.cache = mWindowCaching
+                         ? updateWindowCache(drawData, cmd_list, fb_size)
+                         : nullptr;
+        draw.reuse = draw.cache && draw.cache->valid;
+        draw.quads = instanced_quads && !draw.reuse &&
+                     buildQuadInstances(cmd_list, draw);
+        if (!draw.quads)
+        {
+            draw.vtxCount = cmd_list->VtxBuffer.Size;
+            draw.idxCount = cmd_list->IdxBuffer.Size;
+        }
+        draw.vtxOffset = merged_upload ? vtx_total : 0;
+        draw.idxOffset = merged_upload ? idx_total : 0;
+        if (!draw.reuse)
+        {
+            vtx_total += draw.vtxCount;
+            idx_total += draw.idxCount;
+        }
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, mVboHandle);
-        glBufferData(GL_ARRAY_BUFFER,
-                     (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert),
-                     (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+    if (merged_upload)
+    {
+        XGFX_TRACE_SCOPE("ImGui upload");
+        if (vertexBufferSizer.update(vtx_total))
+            frameStats.bufferReallocations++;
+        if (indexBufferSizer.update(idx_total))
+            frameStats.bufferReallocations++;
+        size_t vtx_capacity =
+            (size_t)vertexBufferSizer.capacity * sizeof(ImDrawVert);
+        size_t idx_capacity =
+            (size_t)indexBufferSizer.capacity * sizeof(ImDrawIdx);
+
+        // The instance buffer is dropped along with the feature
+        size_t inst_capacity = 0;
+        if (instanced_quads ||
+            (mInstanceBufferSizer.capacity && mInstanceVboHandle))
+        {
+            if (!instanced_quads)
+                mInstanceBufferSizer.reset();
+            else if (mInstanceBufferSizer.update((int)mQuadInstances.size()))
+                frameStats.bufferReallocations++;
+            inst_capacity =
+                (size_t)mInstanceBufferSizer.capacity * sizeof(QuadInstance);
+            size_t inst_bytes = mQuadInstances.size() * sizeof(QuadInstance);
+            glBindBuffer(GL_ARRAY_BUFFER, mInstanceVboHandle);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)inst_capacity, nullptr,
+                         GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)inst_bytes,
+                            (const GLvoid*)mQuadInstances.data());
+            frameStats.bytesUploaded += inst_bytes;
+        }
 
+        glBindBuffer(GL_ARRAY_BUFFER, mVboHandle);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vtx_capacity, nullptr,
+                     GL_STREAM_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mElementsHandle);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx),
-                     (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)idx_capacity,
+                     nullptr, GL_STREAM_DRAW);
+        recordBufferBytes(vtx_capacity + idx_capacity + inst_capacity);
+        for (int n = 0; n < drawData->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = drawData->CmdLists[n];
+            const ListDraw& draw = mListDraws[n];
+            if (draw.reuse) continue;
+            const ImDrawVert* vtx = draw.quads
+                                        ? mQuadVertices.data() + draw.quadVtx
+                                        : cmd_list->VtxBuffer.Data;
+            const ImDrawIdx* idx = draw.quads
+                                       ? mQuadIndices.data() + draw.quadIdx
+                                       : cmd_list->IdxBuffer.Data;
+            size_t vtx_bytes = (size_t)draw.vtxCount * sizeof(ImDrawVert);
+            size_t idx_bytes = (size_t)draw.idxCount * sizeof(ImDrawIdx);
+            glBufferSubData(GL_ARRAY_BUFFER,
+                            (GLintptr)draw.vtxOffset * sizeof(ImDrawVert),
+                            (GLsizeiptr)vtx_bytes, (const GLvoid*)vtx);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                            (GLintptr)draw.idxOffset * sizeof(ImDrawIdx),
+                            (GLsizeiptr)idx_bytes, (const GLvoid*)idx);
+            frameStats.bytesUploaded += vtx_bytes + idx_bytes;
+        }
+    }
+
+    // Draw
+    frameStats.vertexCount = static_cast<unsigned>(drawData->TotalVtxCount);
+    frameStats.indexCount = static_cast<unsigned>(drawData->TotalIdxCount);
+    DrawState state;
+    size_t list_buffer_bytes = 0;
+    for (int n = 0; n < drawData->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = drawData->CmdLists[n];
+        const ListDraw& draw = mListDraws[n];
 
-        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+#if defined(XGFX_IMGUI_TRACE)
+        // Label each window's draws for apitrace/RenderDoc captures
+        if (glPushDebugGroup)
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1,
+                             cmd_list->_OwnerName ? cmd_list->_OwnerName
+                                                  : "ImDrawList");
+#endif
+
+        // glBufferData orphans and reallocates the buffer storage each time
+        if (!merged_upload && !draw.reuse)
         {
-            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
-            if (pcmd->UserCallback)
-            {
-                // User callback (registered via ImDrawList::AddCallback)
-                pcmd->UserCallback(cmd_list, pcmd);
-            }
-            else
-            {
-                ImVec4 clip_rect =
-                    ImVec4(pcmd->ClipRect.x - pos.x, pcmd->ClipRect.y - pos.y,
-                           pcmd->ClipRect.z - pos.x, pcmd->ClipRect.w - pos.y);
-                if (clip_rect.x < fb_width && clip_rect.y < fb_height &&
-                    clip_rect.z >= 0.0f && clip_rect.w >= 0.0f)
-                {
-                    // Apply scissor/clipping rectangle
-                    glScissor((int)clip_rect.x, (int)(fb_height - clip_rect.w),
-                              (int)(clip_rect.z - clip_rect.x),
-                              (int)(clip_rect.w - clip_rect.y));
-
-                    // Bind texture, Draw
-                    glBindTexture(GL_TEXTURE_2D,
-                                  (GLuint)(intptr_t)pcmd->TextureId);
-                    glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount,
-                                   sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT
-                                                          : GL_UNSIGNED_INT,
-                                   idx_buffer_offset);
-                }
-            }
-            idx_buffer_offset += pcmd->ElemCount;
+            XGFX_TRACE_SCOPE("ImGui upload");
+            size_t vtx_bytes =
+                (size_t)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+            size_t idx_bytes =
+                (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+            glBindBuffer(GL_ARRAY_BUFFER, mVboHandle);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vtx_bytes,
+                         (const GLvoid*)cmd_list->VtxBuffer.Data,
+                         GL_STREAM_DRAW);
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mElementsHandle);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)idx_bytes,
+                         (const GLvoid*)cmd_list->IdxBuffer.Data,
+                         GL_STREAM_DRAW);
+            frameStats.bytesUploaded += vtx_bytes + idx_bytes;
+            frameStats.bufferReallocations += 2;
+            list_buffer_bytes =
+                std::max(list_buffer_bytes, vtx_bytes + idx_bytes);
         }
+
+        if (draw.cache && !draw.reuse)
+            renderWindowCache(drawData, cmd_list, *draw.cache, draw,
+                              vao_handle, state);
+        if (draw.cache && draw.cache->valid)
+            drawWindowCache(drawData, *draw.cache, fb_height, state);
+        else
+            drawCommands(drawData, cmd_list, drawData->DisplayPos, fb_scale,
+                         fb_width, fb_height, draw, vao_handle, state,
+                         getCulledClipRects(n));
+
+#if defined(XGFX_IMGUI_TRACE)
+        if (glPopDebugGroup) glPopDebugGroup();
+#endif
     }
+    if (!merged_upload) recordBufferBytes(list_buffer_bytes);
+    if (mWindowCaching) evictWindowCaches();
     glDeleteVertexArrays(1, &vao_handle);
+    if (mQuadVertexArray) glDeleteVertexArrays(1, &mQuadVertexArray);
+    mQuadVertexArray = 0;
+    if (timer_query) glEndQuery(GL_TIME_ELAPSED);
+    readbackFrame(fb_width, fb_height);
+    mCaptureFrame++;
 
     // Restore modified GL state
     glUseProgram(last_program);
     glBindTexture(GL_TEXTURE_2D, last_texture);
     if (glBindSampler) glBindSampler(0, last_sampler);
+    if (mVertexTexture)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, last_texture_buffer);
+    }
     glActiveTexture(last_active_texture);
     glBindVertexArray(last_vertex_array);
     glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
@@ -205,10 +1912,19 @@ void OpenGLImGuiManager::renderDrawData(ImDrawData* drawData)
                (GLsizei)last_viewport[3]);
     glScissor(last_scissor_box[0], last_scissor_box[1],
               (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+
+    frameStats.cpuTimeMs =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - cpuStart)
+            .count();
 }
 
 bool OpenGLImGuiManager::createFontTexture()
 {
+    XGFX_TRACE_SCOPE("OpenGLImGuiManager::createFontTexture");
+    ImGuiContextScope scope(context);
+    if (mFontSdf) return createFontDistanceField();
+
     // Build texture atlas
     ImGuiIO& io = ImGui::GetIO();
     unsigned char* pixels;
@@ -243,8 +1959,44 @@ bool OpenGLImGuiManager::createFontTexture()
     return true;
 }
 
+bool OpenGLImGuiManager::createFontDistanceField()
+{
+    ImGuiContextScope scope(context);
+    ImGuiIO& io = ImGui::GetIO();
+    std::vector<unsigned char> pixels;
+    int width, height;
+    buildFontDistanceField(io.Fonts, mFontSdfSpread, pixels, width, height);
+
+    // Upload a single channel texture, the shader reads the field from red
+    GLint last_texture, last_alignment;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &last_alignment);
+    glGenTextures(1, &mFontTexture);
+    glBindTexture(GL_TEXTURE_2D, mFontTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED,
+                 GL_UNSIGNED_BYTE, pixels.data());
+
+    io.Fonts->TexID = (void*)(intptr_t)mFontTexture;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, last_alignment);
+    glBindTexture(GL_TEXTURE_2D, last_texture);
+
+    return true;
+}
+
+void OpenGLImGuiManager::setFontSdf(bool enabled, float spread)
+{
+    mFontSdf = enabled;
+    mFontSdfSpread = spread;
+}
+
 void OpenGLImGuiManager::destroyFontTexture()
 {
+    ImGuiContextScope scope(context);
     if (mFontTexture)
     {
         ImGuiIO& io = ImGui::GetIO();
@@ -263,53 +2015,152 @@ bool OpenGLImGuiManager::createDeviceObjects()
     glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
 
     // Create shaders
+    // Quad instances expand a static quad from the vertex ID, their size is
+    // in 1/16 pixels. Shape corners are flagged by their UV and fetch the
+    // half size, rounding and thickness from the vertex after the corners.
     const GLchar* vertex_shader =
         "uniform mat4 ProjMtx;\n"
+        "uniform int Instanced;\n"
+        "uniform samplerBuffer Vertices;\n"
         "in vec2 Position;\n"
         "in vec2 UV;\n"
         "in vec4 Color;\n"
+        "in vec2 InstPos;\n"
+        "in vec2 InstSize;\n"
+        "in vec4 InstUV;\n"
+        "in vec4 InstColor;\n"
         "out vec2 Frag_UV;\n"
         "out vec4 Frag_Color;\n"
+        "flat out vec4 Frag_Shape;\n"
+        "out vec2 Frag_Local;\n"
         "void main()\n"
         "{\n"
-        "	Frag_UV = UV;\n"
-        "	Frag_Color = Color;\n"
-        "	gl_Position = ProjMtx * vec4(Position.xy,0,1);\n"
+        "	Frag_Shape = vec4(-1.0);\n"
+        "	Frag_Local = vec2(0.0);\n"
+        "	if (Instanced == 1)\n"
+        "	{\n"
+        "		vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+        "		vec2 pos = InstPos + InstSize * 0.0625 * corner;\n"
+        "		Frag_UV = mix(InstUV.xy, InstUV.zw, corner);\n"
+        "		Frag_Color = InstColor;\n"
+        "		gl_Position = ProjMtx * vec4(pos,0,1);\n"
+        "	}\n"
+        "	else\n"
+        "	{\n"
+        "		Frag_UV = UV;\n"
+        "		Frag_Color = Color;\n"
+        "		gl_Position = ProjMtx * vec4(Position.xy,0,1);\n"
+        "		if (UV.y <= -65536.0)\n"
+        "		{\n"
+        "			int corner = int(-65536.0 - UV.y);\n"
+        "			int param = (gl_VertexID - corner + 4) * 5;\n"
+        "			Frag_Shape = vec4(texelFetch(Vertices, param).r,\n"
+        "				texelFetch(Vertices, param + 1).r,\n"
+        "				texelFetch(Vertices, param + 2).r,\n"
+        "				texelFetch(Vertices, param + 3).r);\n"
+        "			vec2 side = vec2(corner == 1 || corner == 2 ? 1.0 : -1.0,\n"
+        "				corner >= 2 ? 1.0 : -1.0);\n"
+        "			Frag_Local = side * (Frag_Shape.xy + Frag_Shape.w * 0.5 + 1.0);\n"
+        "		}\n"
+        "	}\n"
         "}\n";
 
+    // Mode 1 shades the distance field font atlas, with about one pixel of
+    // antialiasing at any scale. Shapes are a rounded rect's distance,
+    // stroked when they have a thickness.
     const GLchar* fragment_shader =
         "uniform sampler2D Texture;\n"
+        "uniform int Mode;\n"
         "in vec2 Frag_UV;\n"
         "in vec4 Frag_Color;\n"
+        "flat in vec4 Frag_Shape;\n"
+        "in vec2 Frag_Local;\n"
         "out vec4 Out_Color;\n"
         "void main()\n"
         "{\n"
-        "	Out_Color = Frag_Color * texture( Texture, Frag_UV.st);\n"
+        "	float pixel = max(length(fwidth(Frag_Local)) * 0.7071, 0.0001);\n"
+        "	if (Frag_Shape.x >= 0.0)\n"
+        "	{\n"
+        "		vec2 q = abs(Frag_Local) - Frag_Shape.xy + Frag_Shape.z;\n"
+        "		float dist = min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) -\n"
+        "			Frag_Shape.z;\n"
+        "		if (Frag_Shape.w > 0.0)\n"
+        "			dist = abs(dist) - Frag_Shape.w * 0.5;\n"
+        "		float alpha = clamp(0.5 - dist / pixel, 0.0, 1.0);\n"
+        "		Out_Color = vec4(Frag_Color.rgb, Frag_Color.a * alpha);\n"
+        "	}\n"
+        "	else if (Mode == 1)\n"
+        "	{\n"
+        "		float dist = texture( Texture, Frag_UV.st).r;\n"
+        "		float width = max(fwidth(dist) * 0.7071, 0.0001);\n"
+        "		float alpha = smoothstep(0.5 - width, 0.5 + width, dist);\n"
+        "		Out_Color = vec4(Frag_Color.rgb, Frag_Color.a * alpha);\n"
+        "	}\n"
+        "	else\n"
+        "		Out_Color = Frag_Color * texture( Texture, Frag_UV.st);\n"
         "}\n";
 
     const GLchar* vertex_shader_with_version[2] = {mGLSLVersion, vertex_shader};
     const GLchar* fragment_shader_with_version[2] = {mGLSLVersion,
                                                      fragment_shader};
 
-    mShaderHandle = glCreateProgram();
-    mVertHandle = glCreateShader(GL_VERTEX_SHADER);
-    mFragHandle = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(mVertHandle, 2, vertex_shader_with_version, NULL);
-    glShaderSource(mFragHandle, 2, fragment_shader_with_version, NULL);
-    glCompileShader(mVertHandle);
-    glCompileShader(mFragHandle);
-    glAttachShader(mShaderHandle, mVertHandle);
-    glAttachShader(mShaderHandle, mFragHandle);
-    glLinkProgram(mShaderHandle);
+    // Try the program binary cache before compiling from source
+    bool use_cache = false;
+    std::string cache_key;
+#if defined(XGFX_GL_PROGRAM_BINARY)
+    use_cache = !mProgramCachePath.empty() && glProgramBinary &&
+                glGetProgramBinary;
+    if (use_cache)
+    {
+        cache_key =
+            programCacheKey(mGLSLVersion, vertex_shader, fragment_shader);
+        mShaderHandle = loadProgramBinary(mProgramCachePath, cache_key);
+    }
+#endif
 
-    mAttribLocationTex = glGetUniformLocation(mShaderHandle, "Texture");
-    mAttribLocationProjMtx = glGetUniformLocation(mShaderHandle, "ProjMtx");
-    mAttribLocationPosition = glGetAttribLocation(mShaderHandle, "Position");
-    mAttribLocationUV = glGetAttribLocation(mShaderHandle, "UV");
-    mAttribLocationColor = glGetAttribLocation(mShaderHandle, "Color");
+    bool compiled_from_source = !mShaderHandle;
+    if (compiled_from_source)
+    {
+        // Let the driver compile on its own threads, we only check the
+        // results after building the font atlas below
+#if defined(GL_KHR_parallel_shader_compile)
+        if (glMaxShaderCompilerThreadsKHR)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+#endif
+
+        mShaderHandle = glCreateProgram();
+        mVertHandle = glCreateShader(GL_VERTEX_SHADER);
+        mFragHandle = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(mVertHandle, 2, vertex_shader_with_version, NULL);
+        glShaderSource(mFragHandle, 2, fragment_shader_with_version, NULL);
+        glCompileShader(mVertHandle);
+        glCompileShader(mFragHandle);
+        glAttachShader(mShaderHandle, mVertHandle);
+        glAttachShader(mShaderHandle, mFragHandle);
+#if defined(XGFX_GL_PROGRAM_BINARY)
+        if (use_cache && glProgramParameteri)
+            glProgramParameteri(mShaderHandle,
+                                GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glLinkProgram(mShaderHandle);
+    }
 
     glGenBuffers(1, &mVboHandle);
     glGenBuffers(1, &mElementsHandle);
+    glGenBuffers(1, &mQuadVboHandle);
+    glGenBuffers(1, &mInstanceVboHandle);
+
+    // Buffer textures are core since GL 3.1
+    if (glTexBuffer) glGenTextures(1, &mVertexTexture);
+    analyticShapes = mAnalyticShapes && mVertexTexture;
+
+    // Timer queries are core since GL 3.3
+    if (glGetQueryObjectui64v)
+    {
+        glGenQueries(kTimerQueryCount, mTimerQueries);
+        for (int i = 0; i < kTimerQueryCount; i++)
+            mTimerQueryIssued[i] = false;
+    }
 
     createFontTexture();
 
@@ -318,14 +2169,63 @@ bool OpenGLImGuiManager::createDeviceObjects()
     glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
     glBindVertexArray(last_vertex_array);
 
+    if (compiled_from_source)
+    {
+        bool vert_ok = checkShader(mVertHandle, "vertex");
+        bool frag_ok = checkShader(mFragHandle, "fragment");
+        if (!checkProgram(mShaderHandle) || !vert_ok || !frag_ok)
+            return false;
+#if defined(XGFX_GL_PROGRAM_BINARY)
+        if (use_cache)
+            saveProgramBinary(mProgramCachePath, cache_key, mShaderHandle);
+#endif
+    }
+
+    mAttribLocationTex = glGetUniformLocation(mShaderHandle, "Texture");
+    mAttribLocationMode = glGetUniformLocation(mShaderHandle, "Mode");
+    mAttribLocationProjMtx = glGetUniformLocation(mShaderHandle, "ProjMtx");
+    mAttribLocationPosition = glGetAttribLocation(mShaderHandle, "Position");
+    mAttribLocationUV = glGetAttribLocation(mShaderHandle, "UV");
+    mAttribLocationColor = glGetAttribLocation(mShaderHandle, "Color");
+    mAttribLocationInstanced = glGetUniformLocation(mShaderHandle, "Instanced");
+    mAttribLocationVertices = glGetUniformLocation(mShaderHandle, "Vertices");
+    mAttribLocationInstPos = glGetAttribLocation(mShaderHandle, "InstPos");
+    mAttribLocationInstSize = glGetAttribLocation(mShaderHandle, "InstSize");
+    mAttribLocationInstUV = glGetAttribLocation(mShaderHandle, "InstUV");
+    mAttribLocationInstColor = glGetAttribLocation(mShaderHandle, "InstColor");
+
     return true;
 }
 
+void OpenGLImGuiManager::setProgramCachePath(const std::string& path)
+{
+    mProgramCachePath = path;
+}
+
 void OpenGLImGuiManager::destroyDeviceObjects()
 {
     if (mVboHandle) glDeleteBuffers(1, &mVboHandle);
     if (mElementsHandle) glDeleteBuffers(1, &mElementsHandle);
-    mVboHandle = mElementsHandle = 0;
+    if (mQuadVboHandle) glDeleteBuffers(1, &mQuadVboHandle);
+    if (mInstanceVboHandle) glDeleteBuffers(1, &mInstanceVboHandle);
+    mVboHandle = mElementsHandle = mQuadVboHandle = mInstanceVboHandle = 0;
+    vertexBufferSizer.reset();
+    indexBufferSizer.reset();
+    mInstanceBufferSizer.reset();
+    if (mVertexTexture) glDeleteTextures(1, &mVertexTexture);
+    mVertexTexture = 0;
+    analyticShapes = false;
+
+    // Nothing was drawn this frame, so every cache is evicted
+    mWindowCacheFrame++;
+    evictWindowCaches();
+
+    if (mTimerQueries[0]) glDeleteQueries(kTimerQueryCount, mTimerQueries);
+    for (int i = 0; i < kTimerQueryCount; i++)
+    {
+        mTimerQueries[i] = 0;
+        mTimerQueryIssued[i] = false;
+    }
 
     if (mShaderHandle && mVertHandle)
         glDetachShader(mShaderHandle, mVertHandle);
@@ -341,5 +2241,8 @@ void OpenGLImGuiManager::destroyDeviceObjects()
     mShaderHandle = 0;
 
     destroyFontTexture();
+    destroyTextureUploads();
+    destroyCaptures();
+    destroyImageAtlas();
 }
 }
\ No newline at end of file
@@ -1,11 +1,23 @@
 #pragma once
 
+#include "Capture.h"
 #include "ImGuiManager.h"
+#include "Pixels.h"
+#include "SkylinePacker.h"
+#include "WorkerPool.h"
 #include "imgui.h"
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 namespace xgfx
 {
-
 /**
  * A fork of ImGUI's OpenGL 3 implementation.
  * imgui/backends/imgui_impl_opengl3.cpp
@@ -21,24 +33,391 @@ class OpenGLImGuiManager : public ImGuiManager
 
     ~OpenGLImGuiManager();
 
+    // Create the ImGui context. Call once the GL functions are loaded so the
+    // backend can detect base vertex support.
     void init();
 
     void renderDrawData(ImDrawData* drawData);
 
+    void setupRenderState(ImDrawData* drawData, int fbWidth, int fbHeight,
+                          unsigned vertexArray);
+
     bool createFontTexture();
 
+    // Bake the font atlas as a signed distance field so text stays crisp at
+    // any DPI or zoom without rebuilding the atlas. Load fonts at the largest
+    // size you display and scale them down, `spread` is the field's range in
+    // atlas texels. Set before createDeviceObjects().
+    void setFontSdf(bool enabled, float spread = 4.0f);
+
+    bool createFontDistanceField();
+
     void destroyFontTexture();
 
     bool createDeviceObjects();
 
+    // Persist the linked shader program to this file and reload it on later
+    // launches instead of compiling from source. Set before
+    // createDeviceObjects(), leave empty to disable.
+    void setProgramCachePath(const std::string& path);
+
     void destroyDeviceObjects();
 
+    // Render windows whose draw lists stay the same from frame to frame into
+    // offscreen textures and composite those instead of replaying their
+    // draws. Only lists of at least `minVertices` that draw nothing but the
+    // font atlas and have no callbacks are cached.
+    void setWindowCaching(bool enabled, int minVertices = 2000);
+
+    // Draw runs of glyphs and solid rectangles as instanced quads, one
+    // 24 byte record each instead of four vertices and six indices. Runs
+    // shorter than `minRun` quads stay with the rest of the triangles, as
+    // each run costs a draw call. Needs GL 3.3.
+    void setInstancedQuads(bool enabled, int minRun = 8);
+
+    // Let addRect(), addCircle() and addLine() emit one quad per shape for
+    // the shaders to evaluate, reading its parameters back from the vertex
+    // buffer through a buffer texture. Needs GL 3.1.
+    void setAnalyticShapes(bool enabled);
+
+    // Read back the framebuffer as the next renderDrawData() leaves it and
+    // call `done` with it on a worker thread. The copy goes into a ring of
+    // pixel buffer objects that are mapped a few frames later, once their
+    // fence signals, so capturing never waits on the GPU.
+    void captureFrame(std::function<void(CaptureImage&)> done);
+
+    // Write the next rendered frame to `path` in the background.
+    void saveScreenshot(const std::string& path,
+                        CaptureFormat format = CaptureFormat::Png);
+
+    // Write every rendered frame to `prefix` followed by a six digit frame
+    // number and the format's extension. Frames arriving while the pixel
+    // buffers or the workers are all busy are skipped, leaving a gap in the
+    // numbering, and counted by getDroppedCaptures().
+    void startRecording(const std::string& prefix,
+                        CaptureFormat format = CaptureFormat::Png);
+
+    void stopRecording();
+
+    bool isRecording() const;
+
+    // Block until every capture of a rendered frame has been handled, e.g.
+    // before exiting.
+    void flushCaptures();
+
+    unsigned getDroppedCaptures() const;
+
+    // Create a texture for ImGui::Image() and upload `pixels` to it in the
+    // background. Conversion to RGBA runs on worker threads and the copy
+    // goes through a ring of pixel buffer objects, so neither stalls the
+    // UI. The ID is usable right away, draws with it are skipped until the
+    // GPU has finished the upload.
+    ImTextureID loadTexture(std::vector<uint8_t> pixels, int width,
+                            int height, PixelFormat format = PixelFormat::RGBA8,
+                            bool premultiply = false);
+
+    bool isTextureReady(ImTextureID texture) const;
+
+    // Create a texture for updateTexture(), which copies `pixels` into a
+    // free pixel buffer and from there into the texture, only stalling on
+    // the texture when every buffer is still in flight. Draws after the
+    // call see the update.
+    ImTextureID createTexture(int width, int height) override;
+
+    void updateTexture(ImTextureID texture, int x, int y, int width,
+                       int height, const uint8_t* pixels) override;
+
+    // Delete a texture from loadTexture() or createTexture(), even one
+    // still uploading.
+    void destroyTexture(ImTextureID texture) override;
+
+    // Add a small image, such as an icon, to the shared image atlas. Draw it
+    // with ImGui::Image() and the default UVs, the manager swaps in the atlas
+    // page and the image's place on it, so images on the same page batch
+    // into one draw. Images are packed on first use, and when every page is
+    // full the least recently drawn one is cleared and repacked.
+    ImTextureID addAtlasImage(std::vector<uint8_t> pixels, int width,
+                              int height,
+                              PixelFormat format = PixelFormat::RGBA8,
+                              bool premultiply = false);
+
+    // Its space on the page is only reclaimed once the page is evicted.
+    void removeAtlasImage(ImTextureID image);
+
+    // Atlas pages are `pageSize` texels square, at most `maxPages` of them
+    // are kept. Bigger images need loadTexture() instead.
+    void setImageAtlas(int pageSize = 1024, int maxPages = 4);
+
     char mGLSLVersion[32] = "#version 150\n";
+    std::string mProgramCachePath;
     unsigned mFontTexture = 0;
+    bool mFontSdf = false;
+    float mFontSdfSpread = 4.0f;
     int mShaderHandle = 0, mVertHandle = 0, mFragHandle = 0;
-    int mAttribLocationTex = 0, mAttribLocationProjMtx = 0;
+    int mAttribLocationTex = 0, mAttribLocationProjMtx = 0,
+        mAttribLocationMode = 0;
     int mAttribLocationPosition = 0, mAttribLocationUV = 0,
         mAttribLocationColor = 0;
+    int mAttribLocationInstanced = 0, mAttribLocationVertices = 0;
+    int mAttribLocationInstPos = 0, mAttribLocationInstSize = 0,
+        mAttribLocationInstUV = 0, mAttribLocationInstColor = 0;
     unsigned int mVboHandle = 0, mElementsHandle = 0;
+    unsigned int mInstanceVboHandle = 0;
+    bool mAnalyticShapes = false;
+    unsigned int mVertexTexture = 0;
+
+    // GL_TIME_ELAPSED queries, read back a few frames after they're issued so
+    // we never wait on the GPU.
+    static const int kTimerQueryCount = 4;
+    unsigned int mTimerQueries[kTimerQueryCount] = {};
+    bool mTimerQueryIssued[kTimerQueryCount] = {};
+    unsigned int mTimerQueryIndex = 0;
+
+  protected:
+    // Bound state tracked across a frame's draws to skip redundant calls.
+    struct DrawState
+    {
+        unsigned texture = 0;
+        bool textureBound = false;
+        bool instanced = false;
+        int scissor[4] = {0, 0, -1, -1};
+    };
+
+    // A window's draws rendered into a texture, in framebuffer pixels.
+    struct WindowCache
+    {
+        unsigned framebuffer = 0, texture = 0;
+        int textureWidth = 0, textureHeight = 0;
+        int x = 0, y = 0, width = 0, height = 0;
+        // Hash of the commands and buffer sizes, then of the whole list
+        uint64_t layout = 0, hash = 0;
+        bool stable = false;
+        bool valid = false;
+        unsigned lastFrame = 0;
+    };
+
+    // An axis aligned quad drawn by expanding a static quad in the vertex
+    // shader.
+    struct QuadInstance
+    {
+        float x, y;
+        // In 1/16 pixels
+        uint16_t width, height;
+        // u0, v0, u1, v1 normalized to 16 bits
+        uint16_t uv[4];
+        ImU32 col;
+    };
+
+    // A run of a list's indices, drawn either as quad instances or as
+    // triangles from the list's remaining vertices.
+    struct QuadSpan
+    {
+        // ImGui's indices within the list
+        unsigned idxBegin = 0, idxEnd = 0;
+        // Instances, or indices into the remaining triangles
+        unsigned first = 0, count = 0;
+        bool instanced = false;
+    };
+
+    struct ListDraw
+    {
+        WindowCache* cache = nullptr;
+        bool reuse = false;
+        // Offsets into the frame's buffers, zero when each list is uploaded
+        // on its own
+        int vtxOffset = 0, idxOffset = 0;
+        int vtxCount = 0, idxCount = 0;
+
+        // With instanced quads, where the list's remaining triangles start
+        // in mQuadVertices and mQuadIndices, and its spans and instances
+        bool quads = false;
+        int quadVtx = 0, quadIdx = 0;
+        int instOffset = 0;
+        int spanBegin = 0, spanEnd = 0;
+    };
+
+    void setProjection(const ImVec4& rect);
+
+    void setVertexAttributes();
+
+    // Point the quad instance attributes at the instance `offset` bytes into
+    // the instance buffer.
+    void setInstanceAttributes(size_t offset);
+
+    void setScissor(const int scissor[4], DrawState& state);
+
+    // Draw a list's commands, clipped to `clipRects` instead of their own
+    // when given.
+    void drawCommands(ImDrawData* drawData, const ImDrawList* cmdList,
+                      const ImVec2& clipOffset, const ImVec2& clipScale,
+                      int fbWidth, int fbHeight, const ListDraw& draw,
+                      unsigned vertexArray, DrawState& state,
+                      const ImVec4* clipRects = nullptr);
+
+    // Split a list into quad instances and the remaining triangles, appended
+    // to the frame's quad buffers. Returns false for lists that need
+    // ImDrawCmd::VtxOffset, which are drawn as they are.
+    bool buildQuadInstances(const ImDrawList* cmdList, ListDraw& draw);
+
+    void drawQuadSpans(const ImGuiRenderOp& op, const ListDraw& draw,
+                       unsigned vertexArray, DrawState& state);
+
+    // Switch between the list's vertices and quad instances.
+    void bindQuadInstances(bool instanced, unsigned vertexArray,
+                           DrawState& state);
+
+    WindowCache* updateWindowCache(ImDrawData* drawData,
+                                   const ImDrawList* cmdList,
+                                   const ImVec2& fbSize);
+
+    void renderWindowCache(ImDrawData* drawData, const ImDrawList* cmdList,
+                           WindowCache& cache, const ListDraw& draw,
+                           unsigned vertexArray, DrawState& state);
+
+    void drawWindowCache(ImDrawData* drawData, const WindowCache& cache,
+                         int fbHeight, DrawState& state);
+
+    void evictWindowCaches();
+
+    // An upload goes from waiting for a pixel buffer, to being converted
+    // into it on a worker, to copying into the texture until its fence
+    // signals. Region uploads from updateTexture() start out copying.
+    struct TextureUpload
+    {
+        unsigned texture = 0;
+        bool region = false;
+        int width = 0, height = 0;
+        PixelFormat format = PixelFormat::RGBA8;
+        bool premultiply = false;
+        std::vector<uint8_t> pixels;
+        int buffer = -1;
+        void* mapped = nullptr;
+        std::atomic<bool> converted{false};
+        bool copied = false;
+        void* fence = nullptr;
+        bool destroyed = false;
+    };
+
+    // Starts uploads, and retires the ones the GPU has finished.
+    void updateTextureUploads();
+
+    void destroyTextureUploads();
+
+    // Enough for a frame of tiles streamed through updateTexture()
+    static const int kPixelBufferCount = 16;
+    unsigned int mPixelBuffers[kPixelBufferCount] = {};
+    bool mPixelBufferBusy[kPixelBufferCount] = {};
+    std::vector<std::unique_ptr<TextureUpload>> mUploads;
+    std::unordered_set<unsigned> mPendingTextures;
+    WorkerGroup mUploadJobs;
+
+    // A frame read back into a pixel buffer, mapped once its fence signals
+    // and converted out of it on a worker.
+    struct FrameCapture
+    {
+        std::vector<std::function<void(CaptureImage&)>> done;
+        uint64_t frame = 0;
+        int width = 0, height = 0;
+        int buffer = -1;
+        void* fence = nullptr;
+        void* mapped = nullptr;
+        std::atomic<bool> converted{false};
+    };
+
+    // Start reading back the frame for the captures requested so far.
+    void readbackFrame(int fbWidth, int fbHeight);
+
+    // Hands finished readbacks to the workers and frees the pixel buffers
+    // they're done with. With `wait`, blocks until the GPU has written them.
+    void updateCaptures(bool wait);
+
+    void destroyCaptures();
+
+    static const int kCaptureBufferCount = 4;
+    unsigned int mCaptureBuffers[kCaptureBufferCount] = {};
+    size_t mCaptureBufferBytes[kCaptureBufferCount] = {};
+    bool mCaptureBufferBusy[kCaptureBufferCount] = {};
+    std::vector<std::unique_ptr<FrameCapture>> mCaptures;
+    std::vector<std::function<void(CaptureImage&)>> mCaptureRequests;
+    bool mRecording = false;
+    std::string mRecordingPrefix;
+    CaptureFormat mRecordingFormat = CaptureFormat::Png;
+    uint64_t mCaptureFrame = 0;
+    unsigned mDroppedCaptures = 0;
+    // Images being converted or encoded, the jobs of mCaptureJobs
+    std::atomic<unsigned> mCapturesInFlight{0};
+    WorkerGroup mCaptureJobs;
+
+    // A copy of the image is kept so it can be repacked after eviction.
+    struct AtlasImage
+    {
+        // RGBA with the edge texels repeated around it, so filtering never
+        // picks up a neighbour
+        std::vector<uint8_t> pixels;
+        int width = 0, height = 0;
+        int page = -1;
+        ImVec2 uv0, uv1;
+    };
+
+    struct AtlasPage
+    {
+        unsigned texture = 0;
+        SkylinePacker packer;
+        std::vector<AtlasImage*> images;
+        unsigned lastFrame = 0;
+    };
+
+    // Return draw data with draws of atlas images pointed at their page and
+    // place on it. Lists drawing them are remapped in copies, as the
+    // caller's draw data may be rendered again, e.g. during a live resize.
+    ImDrawData* remapAtlasImages(ImDrawData* drawData);
+
+    bool packAtlasImage(AtlasImage& image);
+
+    void destroyImageAtlas();
+
+    std::unordered_map<ImTextureID, std::unique_ptr<AtlasImage>> mAtlasImages;
+    std::vector<AtlasPage> mAtlasPages;
+    int mAtlasPageSize = 1024;
+    int mAtlasMaxPages = 4;
+    unsigned mAtlasFrame = 0;
+
+    struct AtlasList
+    {
+        ImDrawList* list = nullptr;
+        unsigned lastFrame = 0;
+    };
+
+    // Remapped copies of the lists drawing atlas images, by original list
+    std::unordered_map<const ImDrawList*, AtlasList> mAtlasLists;
+    std::vector<ImDrawList*> mAtlasCmdLists;
+    // A bit per vertex of the list being remapped
+    std::vector<uint32_t> mAtlasRemapped;
+    ImDrawData mAtlasDrawData;
+
+    size_t stagingBytes() const override;
+
+    void trimStaging(ImGuiTrimPolicy policy) override;
+
+    bool mWindowCaching = false;
+    int mWindowCacheMinVertices = 2000;
+    unsigned mWindowCacheFrame = 0;
+    std::unordered_map<const ImDrawList*, WindowCache> mWindowCaches;
+    std::vector<ListDraw> mListDraws;
+    unsigned int mQuadVboHandle = 0;
+
+    bool mInstancedQuads = false;
+    int mInstancedQuadMinRun = 8;
+    std::vector<QuadInstance> mQuadInstances;
+    std::vector<QuadSpan> mQuadSpans;
+    std::vector<ImDrawVert> mQuadVertices;
+    std::vector<ImDrawIdx> mQuadIndices;
+    std::vector<int> mQuadRemap;
+    ImGuiBufferSizer mInstanceBufferSizer;
+    // Only valid during renderDrawData()
+    unsigned mQuadVertexArray = 0;
+
+    int mTargetFramebuffer = 0;
+    ImVec4 mProjection;
 };
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "Pixels.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XGFX_IMGUI_SSE2 1
+#endif
+
+namespace xgfx
+{
+namespace
+{
+// x / 255 rounded, exact for x up to 255 * 255
+inline uint32_t div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+#if defined(XGFX_IMGUI_SSE2)
+inline __m128i div255(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Multiply two pixels widened to 16 bits by their alpha, leaving alpha
+inline __m128i premultiply2(__m128i p)
+{
+    const __m128i color_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i alpha_one = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    __m128i alpha = _mm_shufflehi_epi16(
+        _mm_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)),
+        _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_or_si128(_mm_and_si128(alpha, color_mask), alpha_one);
+    return div255(_mm_mullo_epi16(p, alpha));
+}
+#endif
+}
+
+void convertPixels(const uint8_t* src, uint8_t* dst, size_t count,
+                   PixelFormat format, bool premultiply)
+{
+    const bool swizzle = format == PixelFormat::BGRA8;
+    size_t i = 0;
+#if defined(XGFX_IMGUI_SSE2)
+    // Four pixels at a time
+    const __m128i green_alpha = _mm_set1_epi32((int)0xFF00FF00);
+    const __m128i red_blue = _mm_set1_epi32(0x00FF00FF);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        if (swizzle)
+        {
+            __m128i rb = _mm_and_si128(p, red_blue);
+            rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            p = _mm_or_si128(_mm_and_si128(p, green_alpha), rb);
+        }
+        if (premultiply)
+        {
+            __m128i lo = premultiply2(_mm_unpacklo_epi8(p, zero));
+            __m128i hi = premultiply2(_mm_unpackhi_epi8(p, zero));
+            p = _mm_packus_epi16(lo, hi);
+        }
+        _mm_storeu_si128((__m128i*)(dst + i * 4), p);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        uint8_t p[4];
+        memcpy(p, src + i * 4, 4);
+        if (swizzle)
+        {
+            uint8_t b = p[0];
+            p[0] = p[2];
+            p[2] = b;
+        }
+        if (premultiply)
+            for (int c = 0; c < 3; c++)
+                p[c] = (uint8_t)div255((uint32_t)p[c] * p[3]);
+        memcpy(dst + i * 4, p, 4);
+    }
+}
+}
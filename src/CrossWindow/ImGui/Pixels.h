@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xgfx
+{
+// Byte order of 8-bit per channel images.
+enum class PixelFormat
+{
+    RGBA8,
+    BGRA8
+};
+
+// Convert `count` pixels of `format` to RGBA8, optionally multiplying the
+// color by alpha. `src` and `dst` may be the same buffer.
+void convertPixels(const uint8_t* src, uint8_t* dst, size_t count,
+                   PixelFormat format, bool premultiply);
+}
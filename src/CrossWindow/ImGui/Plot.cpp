@@ -0,0 +1,267 @@
+#include "Plot.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Ranges are reduced four lanes at a time where SSE2 is baseline
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XGFX_IMGUI_SSE2 1
+#endif
+
+namespace xgfx
+{
+namespace
+{
+const size_t kFanout = 8;
+
+// Widen [lo, hi] by the range of `count` entries of `mins` and `maxs`.
+void accumulateRange(const float* mins, const float* maxs, size_t count,
+                     float& lo, float& hi)
+{
+    size_t i = 0;
+#if defined(XGFX_IMGUI_SSE2)
+    if (count >= 4)
+    {
+        __m128 lo4 = _mm_set1_ps(lo), hi4 = _mm_set1_ps(hi);
+        for (; i + 4 <= count; i += 4)
+        {
+            lo4 = _mm_min_ps(lo4, _mm_loadu_ps(mins + i));
+            hi4 = _mm_max_ps(hi4, _mm_loadu_ps(maxs + i));
+        }
+        lo4 = _mm_min_ps(lo4, _mm_movehl_ps(lo4, lo4));
+        lo4 = _mm_min_ss(lo4, _mm_shuffle_ps(lo4, lo4, 1));
+        hi4 = _mm_max_ps(hi4, _mm_movehl_ps(hi4, hi4));
+        hi4 = _mm_max_ss(hi4, _mm_shuffle_ps(hi4, hi4, 1));
+        lo = _mm_cvtss_f32(lo4);
+        hi = _mm_cvtss_f32(hi4);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        lo = std::min(lo, mins[i]);
+        hi = std::max(hi, maxs[i]);
+    }
+}
+}
+
+void PlotSeries::append(const float* values, size_t count)
+{
+    if (count == 0) return;
+    size_t start = mSamples.size();
+    mSamples.insert(mSamples.end(), values, values + count);
+
+    // Recompute each level's blocks from the one holding the first changed
+    // entry of the level below
+    const float* mins = mSamples.data();
+    const float* maxs = mSamples.data();
+    size_t entries = mSamples.size();
+    for (size_t l = 0; entries > kFanout; l++)
+    {
+        if (mLevels.size() <= l) mLevels.emplace_back();
+        Level& level = mLevels[l];
+        size_t first = start / kFanout;
+        size_t blocks = (entries + kFanout - 1) / kFanout;
+        level.mins.resize(blocks);
+        level.maxs.resize(blocks);
+        for (size_t b = first; b < blocks; b++)
+        {
+            float lo = std::numeric_limits<float>::infinity();
+            float hi = -lo;
+            size_t offset = b * kFanout;
+            accumulateRange(mins + offset, maxs + offset,
+                            std::min(kFanout, entries - offset), lo, hi);
+            level.mins[b] = lo;
+            level.maxs[b] = hi;
+        }
+        mins = level.mins.data();
+        maxs = level.maxs.data();
+        entries = blocks;
+        start = first;
+    }
+}
+
+void PlotSeries::append(float value) { append(&value, 1); }
+
+void PlotSeries::clear()
+{
+    mSamples.clear();
+    mLevels.clear();
+}
+
+size_t PlotSeries::size() const { return mSamples.size(); }
+
+const float* PlotSeries::data() const { return mSamples.data(); }
+
+void PlotSeries::decimate(double first, double last, int columns,
+                          float* mins, float* maxs) const
+{
+    const double step = (last - first) / columns;
+    const double count = (double)mSamples.size();
+    for (int c = 0; c < columns; c++)
+    {
+        float lo = std::numeric_limits<float>::infinity();
+        float hi = -lo;
+        double begin = std::max(first + step * c, 0.0);
+        double end = std::min(first + step * (c + 1), count);
+        if (begin < end)
+        {
+            size_t s0 = (size_t)begin;
+            size_t s1 = std::max((size_t)std::ceil(end), s0 + 1);
+
+            // The coarsest level with at least two blocks per bucket, whose
+            // blocks may reach slightly past the bucket's edges
+            const float* level_mins = mSamples.data();
+            const float* level_maxs = mSamples.data();
+            size_t block = 1;
+            for (size_t l = 0; l < mLevels.size(); l++)
+            {
+                if (block * kFanout * 2 > s1 - s0) break;
+                level_mins = mLevels[l].mins.data();
+                level_maxs = mLevels[l].maxs.data();
+                block *= kFanout;
+            }
+            size_t e0 = s0 / block, e1 = (s1 + block - 1) / block;
+            accumulateRange(level_mins + e0, level_maxs + e0, e1 - e0, lo, hi);
+        }
+        mins[c] = lo;
+        maxs[c] = hi;
+    }
+}
+
+void PlotView::addSeries(const PlotSeries* series, ImU32 color)
+{
+    mSeries.push_back({series, color});
+}
+
+void PlotView::clearSeries() { mSeries.clear(); }
+
+void PlotView::setRange(double first, double last)
+{
+    mFirst = first;
+    mLast = last;
+    mFollow = false;
+}
+
+void PlotView::draw(const char* id, const ImVec2& size)
+{
+    if (size.x < 1.0f || size.y < 1.0f) return;
+    XGFX_TRACE_SCOPE("PlotView::draw");
+    const ImVec2 pos = ImGui::GetCursorScreenPos();
+    const ImVec2 end(pos.x + size.x, pos.y + size.y);
+    ImGui::InvisibleButton(id, size);
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->AddRectFilled(pos, end, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+    size_t count = 0;
+    for (const Series& s : mSeries)
+        count = std::max(count, s.series->size());
+    if (count == 0) return;
+    if (mLast <= mFirst)
+    {
+        mFirst = 0.0;
+        mLast = (double)count;
+        mFollow = true;
+    }
+    if (mFollow && mLast < count)
+    {
+        mFirst += count - mLast;
+        mLast = (double)count;
+    }
+
+    // Drag to pan, scroll to zoom about the cursor
+    ImGuiIO& io = ImGui::GetIO();
+    double per_pixel = (mLast - mFirst) / size.x;
+    if (ImGui::IsItemActive() && ImGui::IsMouseDragging(0, 0.0f))
+    {
+        double shift = -io.MouseDelta.x * per_pixel;
+        mFirst += shift;
+        mLast += shift;
+    }
+    if (ImGui::IsItemHovered() && io.MouseWheel != 0.0f)
+    {
+        double anchor = mFirst + (ImGui::GetMousePos().x - pos.x) * per_pixel;
+        double width = std::min(
+            std::max((mLast - mFirst) * pow(1.2, -io.MouseWheel), 8.0),
+            (double)count * 4.0);
+        double scale = width / (mLast - mFirst);
+        mFirst = anchor - (anchor - mFirst) * scale;
+        mLast = mFirst + width;
+    }
+    mFollow = mLast >= count;
+    per_pixel = (mLast - mFirst) / size.x;
+
+    // Reduce every series first, so the vertical scale fits them all
+    const int columns = (int)size.x;
+    const bool decimated = per_pixel > 1.0;
+    float lo = std::numeric_limits<float>::infinity();
+    float hi = -lo;
+    mMins.resize((size_t)columns * mSeries.size());
+    mMaxs.resize(mMins.size());
+    for (size_t s = 0; s < mSeries.size(); s++)
+    {
+        const PlotSeries& series = *mSeries[s].series;
+        if (decimated)
+        {
+            float* mins = mMins.data() + s * columns;
+            float* maxs = mMaxs.data() + s * columns;
+            series.decimate(mFirst, mLast, columns, mins, maxs);
+            accumulateRange(mins, maxs, columns, lo, hi);
+        }
+        else
+        {
+            size_t first = (size_t)std::max(std::floor(mFirst), 0.0);
+            size_t last = std::min((size_t)std::ceil(mLast) + 1,
+                                   series.size());
+            if (first < last)
+                accumulateRange(series.data() + first, series.data() + first,
+                                last - first, lo, hi);
+        }
+    }
+    if (!(lo <= hi)) return;
+    if (hi - lo < 1e-6f)
+    {
+        lo -= 0.5f;
+        hi += 0.5f;
+    }
+    const float y_scale = size.y / (hi - lo);
+
+    // A point at each sample, or a column's min and max when decimated
+    draw_list->PushClipRect(pos, end, true);
+    for (size_t s = 0; s < mSeries.size(); s++)
+    {
+        const PlotSeries& series = *mSeries[s].series;
+        mPoints.clear();
+        if (decimated)
+        {
+            const float* mins = mMins.data() + s * columns;
+            const float* maxs = mMaxs.data() + s * columns;
+            // Columns outside the data, e.g. left of sample 0, are empty
+            for (int c = 0; c < columns; c++)
+            {
+                if (!(mins[c] <= maxs[c])) continue;
+                float x = pos.x + c + 0.5f;
+                mPoints.push_back(ImVec2(x, end.y - (mins[c] - lo) * y_scale));
+                mPoints.push_back(ImVec2(x, end.y - (maxs[c] - lo) * y_scale));
+            }
+        }
+        else
+        {
+            size_t first = (size_t)std::max(std::floor(mFirst), 0.0);
+            size_t last = std::min((size_t)std::ceil(mLast) + 1,
+                                   series.size());
+            for (size_t i = first; i < last; i++)
+                mPoints.push_back(
+                    ImVec2(pos.x + (float)((i - mFirst) / per_pixel),
+                           end.y - (series.data()[i] - lo) * y_scale));
+        }
+        if (mPoints.size() > 1)
+            draw_list->AddPolyline(mPoints.data(), (int)mPoints.size(),
+                                   mSeries[s].color, ImDrawFlags_None, 1.0f);
+    }
+    draw_list->PopClipRect();
+}
+}
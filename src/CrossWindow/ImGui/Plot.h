@@ -0,0 +1,74 @@
+#pragma once
+
+#include "imgui.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace xgfx
+{
+// A series of samples with a min/max pyramid over it: each level holds the
+// range of blocks of 8 entries of the one below. Appending only updates
+// the blocks at the end.
+class PlotSeries
+{
+  public:
+    void append(const float* values, size_t count);
+
+    void append(float value);
+
+    void clear();
+
+    size_t size() const;
+
+    const float* data() const;
+
+    // Split samples [first, last) into `columns` even buckets and write the
+    // range of each, read from the coarsest level with a few entries per
+    // bucket. Buckets past the end get a min above their max.
+    void decimate(double first, double last, int columns, float* mins,
+                  float* maxs) const;
+
+  private:
+    struct Level
+    {
+        std::vector<float> mins, maxs;
+    };
+
+    std::vector<float> mSamples;
+    std::vector<Level> mLevels;
+};
+
+/**
+ * Plots series of any length with a bounded vertex count. When there are
+ * more samples than pixels, each pixel column is drawn as the min/max range
+ * of its samples, about two points a column. Scroll to zoom, drag to pan.
+ * While the view reaches the end of the data it follows new samples.
+ */
+class PlotView
+{
+  public:
+    // The series must outlive the view or be removed with clearSeries().
+    void addSeries(const PlotSeries* series, ImU32 color);
+
+    void clearSeries();
+
+    // Show samples [first, last). An empty range fits all samples.
+    void setRange(double first, double last);
+
+    void draw(const char* id, const ImVec2& size);
+
+  private:
+    struct Series
+    {
+        const PlotSeries* series;
+        ImU32 color;
+    };
+
+    std::vector<Series> mSeries;
+    double mFirst = 0.0, mLast = 0.0;
+    bool mFollow = true;
+    std::vector<float> mMins, mMaxs;
+    std::vector<ImVec2> mPoints;
+};
+}
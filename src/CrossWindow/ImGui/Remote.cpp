@@ -0,0 +1,1023 @@
+#include "Remote.h"
+#include "Lz4.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace xgfx
+{
+namespace
+{
+#if defined(_WIN32)
+typedef SOCKET SocketHandle;
+const int kSendFlags = 0;
+
+void closeSocket(intptr_t s) { closesocket(static_cast<SocketHandle>(s)); }
+
+int pollSocket(intptr_t s, int timeoutMs)
+{
+    WSAPOLLFD fd = {static_cast<SocketHandle>(s), POLLRDNORM, 0};
+    return WSAPoll(&fd, 1, timeoutMs);
+}
+
+bool startSockets()
+{
+    static bool started = false;
+    if (!started)
+    {
+        WSADATA data;
+        started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }
+    return started;
+}
+#else
+typedef int SocketHandle;
+#if defined(MSG_NOSIGNAL)
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+void closeSocket(intptr_t s) { ::close(static_cast<SocketHandle>(s)); }
+
+int pollSocket(intptr_t s, int timeoutMs)
+{
+    pollfd fd = {static_cast<SocketHandle>(s), POLLIN, 0};
+    return poll(&fd, 1, timeoutMs);
+}
+
+bool startSockets() { return true; }
+#endif
+
+const intptr_t kNoSocket = -1;
+const size_t kMessageHeaderSize = 5;
+const uint32_t kMaxMessageSize = 256u << 20;
+
+// Keep frames flowing out without waiting for acks, and stop a closed viewer
+// from raising SIGPIPE where MSG_NOSIGNAL doesn't exist
+void configureConnection(intptr_t s, bool tcp)
+{
+    int one = 1;
+    if (tcp)
+        setsockopt(static_cast<SocketHandle>(s), IPPROTO_TCP, TCP_NODELAY,
+                   reinterpret_cast<const char*>(&one), sizeof(one));
+#if defined(SO_NOSIGPIPE)
+    setsockopt(static_cast<SocketHandle>(s), SOL_SOCKET, SO_NOSIGPIPE, &one,
+               sizeof(one));
+#endif
+}
+
+// Resolve `host` and call `fn(socket, addrinfo)` for each address until it
+// returns true, giving ownership of the socket to it.
+template <typename Fn>
+intptr_t openTcp(const char* host, unsigned short port, bool passive, Fn fn)
+{
+    if (!startSockets()) return kNoSocket;
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host, service, &hints, &addresses) != 0)
+    {
+        fprintf(stderr, "Remote ImGui: couldn't resolve %s\n",
+                host ? host : "any address");
+        return kNoSocket;
+    }
+    intptr_t result = kNoSocket;
+    for (addrinfo* a = addresses; a && result == kNoSocket; a = a->ai_next)
+    {
+        SocketHandle s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (static_cast<intptr_t>(s) == kNoSocket) continue;
+        if (fn(s, a))
+            result = static_cast<intptr_t>(s);
+        else
+            closeSocket(static_cast<intptr_t>(s));
+    }
+    freeaddrinfo(addresses);
+    return result;
+}
+
+enum MessageType : uint8_t
+{
+    MessageFrame = 1,
+    MessageEvent = 2
+};
+
+const uint32_t kFrameMagic = 0x46524758; // "XGRF"
+const uint32_t kMaxFrameSize = 128u << 20;
+const float kPositionScale = 4.0f;
+const float kUvScale = 65535.0f;
+
+enum ListMode : uint8_t
+{
+    ListUnchanged = 0,
+    ListFull = 1,
+    ListDelta = 2
+};
+
+enum CommandKind : uint8_t
+{
+    CommandDraw = 0,
+    CommandFont = 1,
+    CommandResetRenderState = 2
+};
+
+template <typename T> void put(std::vector<uint8_t>& out, const T& value)
+{
+    size_t at = out.size();
+    out.resize(at + sizeof(T));
+    memcpy(&out[at], &value, sizeof(T));
+}
+
+void putBytes(std::vector<uint8_t>& out, const void* data, size_t size)
+{
+    if (!size) return;
+    size_t at = out.size();
+    out.resize(at + size);
+    memcpy(&out[at], data, size);
+}
+
+// Bounds checked reads, a failed read latches `ok` to false
+struct Reader
+{
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    Reader(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+
+    const uint8_t* take(size_t size)
+    {
+        if (!ok || static_cast<size_t>(end - p) < size)
+        {
+            ok = false;
+            return nullptr;
+        }
+        const uint8_t* at = p;
+        p += size;
+        return at;
+    }
+
+    template <typename T> T get()
+    {
+        T value = T();
+        if (const uint8_t* at = take(sizeof(T))) memcpy(&value, at, sizeof(T));
+        return value;
+    }
+};
+
+// Windows keep their draw list's owner name between frames, so it's what
+// matches a list to its previous frame
+uint32_t hashName(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for (const char* c = name ? name : ""; *c; c++)
+        hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+    return hash;
+}
+
+uint16_t quantizePosition(float v)
+{
+    float q = std::round(v * kPositionScale);
+    q = std::min(std::max(q, -32768.0f), 32767.0f);
+    return static_cast<uint16_t>(static_cast<int16_t>(q));
+}
+
+uint16_t quantizeUv(float v)
+{
+    float q = std::round(std::min(std::max(v, 0.0f), 1.0f) * kUvScale);
+    return static_cast<uint16_t>(q);
+}
+
+// Write `count` values as differences, against `base` when the list kept its
+// shape since last frame or against the previous value otherwise
+template <typename T>
+void putDeltas(std::vector<uint8_t>& out, const T* values, const T* base,
+               size_t count)
+{
+    size_t at = out.size();
+    out.resize(at + count * sizeof(T));
+    uint8_t* dst = &out[at];
+    T prev = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        T ref = base ? base[i] : prev;
+        T delta = static_cast<T>(values[i] - ref);
+        memcpy(dst + i * sizeof(T), &delta, sizeof(T));
+        prev = values[i];
+    }
+}
+
+// Undo putDeltas() in place. `values` holds the base when `delta` is set.
+template <typename T>
+bool getDeltas(Reader& r, T* values, size_t count, bool delta)
+{
+    const uint8_t* src = r.take(count * sizeof(T));
+    if (!src) return false;
+    T prev = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        T d;
+        memcpy(&d, src + i * sizeof(T), sizeof(T));
+        values[i] = static_cast<T>((delta ? values[i] : prev) + d);
+        prev = values[i];
+    }
+    return true;
+}
+
+bool encodeEvent(const xwin::Event& e, std::vector<uint8_t>& out)
+{
+    out.clear();
+    put(out, static_cast<uint32_t>(e.type));
+    switch (e.type)
+    {
+    case xwin::EventType::Resize:
+        put(out, e.data.resize);
+        return true;
+    case xwin::EventType::DPI:
+        put(out, e.data.dpi);
+        return true;
+    case xwin::EventType::Focus:
+        put(out, e.data.focus);
+        return true;
+    case xwin::EventType::Keyboard:
+        put(out, e.data.keyboard);
+        return true;
+    case xwin::EventType::MouseMove:
+        put(out, e.data.mouseMove);
+        return true;
+    case xwin::EventType::MouseWheel:
+        put(out, e.data.mouseWheel);
+        return true;
+    case xwin::EventType::MouseInput:
+        put(out, e.data.mouseInput);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool decodeEvent(const std::vector<uint8_t>& in, xwin::Event& e)
+{
+    Reader r(in.data(), in.size());
+    e = xwin::Event(static_cast<xwin::EventType>(r.get<uint32_t>()), nullptr);
+    switch (e.type)
+    {
+    case xwin::EventType::Resize:
+        e.data.resize = r.get<xwin::ResizeData>();
+        break;
+    case xwin::EventType::DPI:
+        e.data.dpi = r.get<xwin::DpiData>();
+        break;
+    case xwin::EventType::Focus:
+        e.data.focus = r.get<xwin::FocusData>();
+        break;
+    case xwin::EventType::Keyboard:
+        e.data.keyboard = r.get<xwin::KeyboardData>();
+        break;
+    case xwin::EventType::MouseMove:
+        e.data.mouseMove = r.get<xwin::MouseMoveData>();
+        break;
+    case xwin::EventType::MouseWheel:
+        e.data.mouseWheel = r.get<xwin::MouseWheelData>();
+        break;
+    case xwin::EventType::MouseInput:
+        e.data.mouseInput = r.get<xwin::MouseInputData>();
+        break;
+    default:
+        return false;
+    }
+    return r.ok && r.p == r.end;
+}
+}
+
+RemoteSocket::RemoteSocket() : mListener(kNoSocket), mConnection(kNoSocket) {}
+
+RemoteSocket::~RemoteSocket() { close(); }
+
+bool RemoteSocket::listenTcp(const char* address, unsigned short port)
+{
+    close();
+    mListener = openTcp(address, port, true, [](SocketHandle s, addrinfo* a) {
+        int one = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR,
+                   reinterpret_cast<const char*>(&one), sizeof(one));
+        return bind(s, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0 &&
+               listen(s, 1) == 0;
+    });
+    if (mListener == kNoSocket)
+        fprintf(stderr, "Remote ImGui: couldn't listen on port %u\n", port);
+    return mListener != kNoSocket;
+}
+
+bool RemoteSocket::listenUnix(const char* path)
+{
+    close();
+#if defined(_WIN32)
+    (void)path;
+    fprintf(stderr, "Remote ImGui: Unix sockets aren't supported here\n");
+    return false;
+#else
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path);
+
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0) return false;
+    unlink(path);
+    if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(s, 1) != 0)
+    {
+        fprintf(stderr, "Remote ImGui: couldn't listen on %s\n", path);
+        ::close(s);
+        return false;
+    }
+    mListener = s;
+    mUnixPath = path;
+    return true;
+#endif
+}
+
+bool RemoteSocket::accept()
+{
+    if (mListener == kNoSocket || pollSocket(mListener, 0) <= 0) return false;
+    SocketHandle s =
+        ::accept(static_cast<SocketHandle>(mListener), nullptr, nullptr);
+    if (static_cast<intptr_t>(s) == kNoSocket) return false;
+    closeConnection();
+    mConnection = static_cast<intptr_t>(s);
+    configureConnection(mConnection, mUnixPath.empty());
+    return true;
+}
+
+bool RemoteSocket::connectTcp(const char* host, unsigned short port)
+{
+    close();
+    mConnection =
+        openTcp(host, port, false, [](SocketHandle s, addrinfo* a) {
+            return connect(s, a->ai_addr, static_cast<int>(a->ai_addrlen)) ==
+                   0;
+        });
+    if (mConnection == kNoSocket)
+    {
+        fprintf(stderr, "Remote ImGui: couldn't connect to %s:%u\n", host,
+                port);
+        return false;
+    }
+    configureConnection(mConnection, true);
+    return true;
+}
+
+bool RemoteSocket::connectUnix(const char* path)
+{
+    close();
+#if defined(_WIN32)
+    (void)path;
+    fprintf(stderr, "Remote ImGui: Unix sockets aren't supported here\n");
+    return false;
+#else
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path);
+
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0) return false;
+    if (connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        fprintf(stderr, "Remote ImGui: couldn't connect to %s\n", path);
+        ::close(s);
+        return false;
+    }
+    mConnection = s;
+    configureConnection(mConnection, false);
+    return true;
+#endif
+}
+
+void RemoteSocket::closeConnection()
+{
+    if (mConnection != kNoSocket) closeSocket(mConnection);
+    mConnection = kNoSocket;
+    mReceived.clear();
+    mReceivedOffset = 0;
+}
+
+void RemoteSocket::close()
+{
+    closeConnection();
+    if (mListener != kNoSocket) closeSocket(mListener);
+    mListener = kNoSocket;
+#if !defined(_WIN32)
+    if (!mUnixPath.empty()) unlink(mUnixPath.c_str());
+#endif
+    mUnixPath.clear();
+}
+
+bool RemoteSocket::isConnected() const { return mConnection != kNoSocket; }
+
+bool RemoteSocket::send(uint8_t type, const std::vector<uint8_t>& payload)
+{
+    if (mConnection == kNoSocket) return false;
+    uint8_t header[kMessageHeaderSize];
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    memcpy(header, &size, sizeof(size));
+    header[4] = type;
+
+    const uint8_t* parts[2] = {header, payload.data()};
+    size_t sizes[2] = {kMessageHeaderSize, payload.size()};
+    for (int p = 0; p < 2; p++)
+    {
+        size_t sent = 0;
+        while (sent < sizes[p])
+        {
+            size_t left = sizes[p] - sent;
+            int chunk = static_cast<int>(std::min<size_t>(left, 1u << 30));
+            int n = ::send(static_cast<SocketHandle>(mConnection),
+                           reinterpret_cast<const char*>(parts[p] + sent),
+                           chunk, kSendFlags);
+            if (n <= 0)
+            {
+                closeConnection();
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+    return true;
+}
+
+bool RemoteSocket::receive(uint8_t& type, std::vector<uint8_t>& payload,
+                           bool wait)
+{
+    while (mConnection != kNoSocket)
+    {
+        // Hand out a message once it has fully arrived
+        size_t available = mReceived.size() - mReceivedOffset;
+        if (available >= kMessageHeaderSize)
+        {
+            const uint8_t* at = mReceived.data() + mReceivedOffset;
+            uint32_t size;
+            memcpy(&size, at, sizeof(size));
+            if (size > kMaxMessageSize)
+            {
+                fprintf(stderr, "Remote ImGui: message too large\n");
+                closeConnection();
+                return false;
+            }
+            if (available >= kMessageHeaderSize + size)
+            {
+                type = at[4];
+                payload.assign(at + kMessageHeaderSize,
+                               at + kMessageHeaderSize + size);
+                mReceivedOffset += kMessageHeaderSize + size;
+                return true;
+            }
+        }
+
+        // Drop consumed bytes before reading more
+        if (mReceivedOffset > 0)
+        {
+            mReceived.erase(mReceived.begin(),
+                            mReceived.begin() + mReceivedOffset);
+            mReceivedOffset = 0;
+        }
+        if (!wait && pollSocket(mConnection, 0) <= 0) return false;
+
+        const size_t kChunk = 64 * 1024;
+        size_t at = mReceived.size();
+        mReceived.resize(at + kChunk);
+        int n = recv(static_cast<SocketHandle>(mConnection),
+                     reinterpret_cast<char*>(mReceived.data() + at),
+                     static_cast<int>(kChunk), 0);
+        if (n <= 0)
+        {
+            closeConnection();
+            return false;
+        }
+        mReceived.resize(at + static_cast<size_t>(n));
+    }
+    return false;
+}
+
+void RemoteFrameEncoder::encode(const ImDrawData* drawData,
+                                ImTextureID fontTexture,
+                                std::vector<uint8_t>& out)
+{
+    XGFX_TRACE_SCOPE("RemoteFrameEncoder::encode");
+    mFrame++;
+    std::vector<uint8_t>& raw = mRaw;
+    raw.clear();
+    put(raw, kFrameMagic);
+    put(raw, static_cast<uint8_t>(mKeyframe ? 1 : 0));
+    if (mKeyframe) mLists.clear();
+    mKeyframe = false;
+    put(raw, drawData->DisplayPos);
+    put(raw, drawData->DisplaySize);
+    put(raw, drawData->FramebufferScale);
+    put(raw, static_cast<uint32_t>(drawData->CmdListsCount));
+
+    ListState& next = mScratch;
+    for (int n = 0; n < drawData->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = drawData->CmdLists[n];
+
+        // Lists sharing an owner name get distinct keys in draw order
+        uint32_t key = hashName(cmd_list->_OwnerName);
+        for (auto it = mLists.find(key);
+             it != mLists.end() && it->second.frame == mFrame;
+             it = mLists.find(key))
+            key = key * 16777619u + 1;
+        ListState& state = mLists[key];
+        bool known = state.frame != 0;
+        state.frame = mFrame;
+        put(raw, key);
+
+        size_t vtxCount = static_cast<size_t>(cmd_list->VtxBuffer.Size);
+        size_t idxCount = static_cast<size_t>(cmd_list->IdxBuffer.Size);
+        next.vtx.resize(vtxCount * 4);
+        next.col.resize(vtxCount);
+        for (size_t i = 0; i < vtxCount; i++)
+        {
+            const ImDrawVert& v = cmd_list->VtxBuffer.Data[i];
+            next.vtx[i] = quantizePosition(v.pos.x);
+            next.vtx[vtxCount + i] = quantizePosition(v.pos.y);
+            next.vtx[vtxCount * 2 + i] = quantizeUv(v.uv.x);
+            next.vtx[vtxCount * 3 + i] = quantizeUv(v.uv.y);
+            next.col[i] = v.col;
+        }
+        next.idx.assign(cmd_list->IdxBuffer.Data,
+                        cmd_list->IdxBuffer.Data + idxCount);
+
+        // Callbacks can't cross the wire, except the render state reset
+        next.cmds.clear();
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd& cmd = cmd_list->CmdBuffer[cmd_i];
+            if (cmd.UserCallback)
+            {
+                if (cmd.UserCallback == ImDrawCallback_ResetRenderState)
+                    put(next.cmds,
+                        static_cast<uint8_t>(CommandResetRenderState));
+                continue;
+            }
+            if (cmd.ElemCount == 0) continue;
+            bool font = cmd.GetTexID() == fontTexture;
+            put(next.cmds,
+                static_cast<uint8_t>(font ? CommandFont : CommandDraw));
+            put(next.cmds, cmd.ClipRect);
+            if (!font)
+                put(next.cmds,
+                    static_cast<ImU64>((intptr_t)cmd.GetTexID()));
+            put(next.cmds, static_cast<uint32_t>(cmd.VtxOffset));
+            put(next.cmds, static_cast<uint32_t>(cmd.IdxOffset));
+            put(next.cmds, static_cast<uint32_t>(cmd.ElemCount));
+        }
+
+        bool sameShape = known && state.col.size() == vtxCount &&
+                         state.idx.size() == idxCount;
+        if (sameShape && state.vtx == next.vtx && state.col == next.col &&
+            state.idx == next.idx && state.cmds == next.cmds)
+        {
+            put(raw, static_cast<uint8_t>(ListUnchanged));
+            continue;
+        }
+
+        put(raw, static_cast<uint8_t>(sameShape ? ListDelta : ListFull));
+        put(raw, static_cast<uint32_t>(vtxCount));
+        put(raw, static_cast<uint32_t>(idxCount));
+        put(raw, static_cast<uint32_t>(next.cmds.size()));
+        putBytes(raw, next.cmds.data(), next.cmds.size());
+        for (size_t p = 0; p < 4; p++)
+            putDeltas(raw, next.vtx.data() + p * vtxCount,
+                      sameShape ? state.vtx.data() + p * vtxCount : nullptr,
+                      vtxCount);
+        putDeltas(raw, next.col.data(),
+                  sameShape ? state.col.data() : nullptr, vtxCount);
+        putDeltas(raw, next.idx.data(),
+                  sameShape ? state.idx.data() : nullptr, idxCount);
+
+        // Keep this frame's data, and the old buffers for reuse
+        state.vtx.swap(next.vtx);
+        state.col.swap(next.col);
+        state.idx.swap(next.idx);
+        state.cmds.swap(next.cmds);
+    }
+
+    // Forget windows that weren't drawn, the decoder does the same
+    for (auto it = mLists.begin(); it != mLists.end();)
+    {
+        if (it->second.frame != mFrame)
+            it = mLists.erase(it);
+        else
+            ++it;
+    }
+
+    uint32_t rawSize = static_cast<uint32_t>(raw.size());
+    out.resize(sizeof(rawSize) + lz4::compressBound(raw.size()));
+    memcpy(out.data(), &rawSize, sizeof(rawSize));
+    size_t compressed =
+        lz4::compress(raw.data(), raw.size(), out.data() + sizeof(rawSize));
+    out.resize(sizeof(rawSize) + compressed);
+}
+
+void RemoteFrameEncoder::reset() { mKeyframe = true; }
+
+size_t RemoteFrameEncoder::ListState::memoryBytes() const
+{
+    return vtx.capacity() * sizeof(uint16_t) + col.capacity() * sizeof(ImU32) +
+           idx.capacity() * sizeof(ImDrawIdx) + cmds.capacity();
+}
+
+size_t RemoteFrameEncoder::memoryBytes() const
+{
+    size_t bytes = mScratch.memoryBytes() + mRaw.capacity();
+    for (const auto& it : mLists)
+        bytes += it.second.memoryBytes();
+    return bytes;
+}
+
+void RemoteFrameEncoder::trim(ImGuiTrimPolicy policy)
+{
+    mScratch = ListState();
+    mRaw.clear();
+    mRaw.shrink_to_fit();
+    if (policy == ImGuiTrimPolicy::All)
+    {
+        mLists.clear();
+        mKeyframe = true;
+    }
+}
+
+RemoteFrameDecoder::RemoteFrameDecoder() { mDrawData = ImDrawData(); }
+
+RemoteFrameDecoder::~RemoteFrameDecoder() { reset(); }
+
+void RemoteFrameDecoder::mapTexture(ImU64 remote, ImTextureID local)
+{
+    mTextures[remote] = local;
+}
+
+void RemoteFrameDecoder::dropList(uint32_t key)
+{
+    auto it = mLists.find(key);
+    if (it == mLists.end()) return;
+    IM_DELETE(it->second.list);
+    mLists.erase(it);
+}
+
+void RemoteFrameDecoder::reset()
+{
+    for (auto& it : mLists)
+        IM_DELETE(it.second.list);
+    mLists.clear();
+    mDrawLists.clear();
+    mDrawData.Valid = false;
+    mDrawData.CmdListsCount = 0;
+}
+
+bool RemoteFrameDecoder::decodeCommands(const uint8_t* data, size_t size,
+                                        ListState& state)
+{
+    ImDrawList* list = state.list;
+    list->CmdBuffer.resize(0);
+    uint32_t vtxCount = static_cast<uint32_t>(state.col.size());
+    uint32_t idxCount = static_cast<uint32_t>(state.idx.size());
+    Reader r(data, size);
+    while (r.ok && r.p < r.end)
+    {
+        ImDrawCmd cmd = ImDrawCmd();
+        uint8_t kind = r.get<uint8_t>();
+        if (kind == CommandResetRenderState)
+        {
+            cmd.UserCallback = ImDrawCallback_ResetRenderState;
+            list->CmdBuffer.push_back(cmd);
+            continue;
+        }
+        cmd.ClipRect = r.get<ImVec4>();
+        if (kind == CommandFont)
+        {
+            cmd.TextureId = ImGui::GetIO().Fonts->TexID;
+        }
+        else if (kind == CommandDraw)
+        {
+            ImU64 texture = r.get<ImU64>();
+            auto it = mTextures.find(texture);
+            cmd.TextureId = it != mTextures.end()
+                                ? it->second
+                                : (ImTextureID)(intptr_t)texture;
+        }
+        else
+        {
+            return false;
+        }
+        cmd.VtxOffset = r.get<uint32_t>();
+        cmd.IdxOffset = r.get<uint32_t>();
+        cmd.ElemCount = r.get<uint32_t>();
+        if (!r.ok || cmd.IdxOffset > idxCount ||
+            cmd.ElemCount > idxCount - cmd.IdxOffset)
+            return false;
+
+        // Never let the GPU read past the vertices we have
+        uint32_t vtxLimit =
+            cmd.VtxOffset < vtxCount ? vtxCount - cmd.VtxOffset : 0;
+        for (uint32_t i = 0; i < cmd.ElemCount; i++)
+            if (state.idx[cmd.IdxOffset + i] >= vtxLimit) return false;
+        list->CmdBuffer.push_back(cmd);
+    }
+    return r.ok;
+}
+
+ImDrawData* RemoteFrameDecoder::decode(const uint8_t* data, size_t size)
+{
+    XGFX_TRACE_SCOPE("RemoteFrameDecoder::decode");
+    uint32_t rawSize = 0;
+    if (size < sizeof(rawSize)) return nullptr;
+    memcpy(&rawSize, data, sizeof(rawSize));
+    if (rawSize > kMaxFrameSize) return nullptr;
+    mRaw.resize(rawSize);
+    if (!lz4::decompress(data + sizeof(rawSize), size - sizeof(rawSize),
+                         mRaw.data(), rawSize))
+        return nullptr;
+
+    Reader r(mRaw.data(), mRaw.size());
+    if (r.get<uint32_t>() != kFrameMagic) return nullptr;
+    if (r.get<uint8_t>()) reset();
+    mFrame++;
+    ImVec2 displayPos = r.get<ImVec2>();
+    ImVec2 displaySize = r.get<ImVec2>();
+    ImVec2 framebufferScale = r.get<ImVec2>();
+    uint32_t listCount = r.get<uint32_t>();
+
+    mDrawLists.clear();
+    int totalVtxCount = 0, totalIdxCount = 0;
+    bool ok = r.ok;
+    for (uint32_t n = 0; n < listCount && ok; n++)
+    {
+        uint32_t key = r.get<uint32_t>();
+        uint8_t mode = r.get<uint8_t>();
+        auto found = mLists.find(key);
+        bool known = found != mLists.end();
+        if (!r.ok || (known && found->second.frame == mFrame) ||
+            (mode != ListFull && !known))
+        {
+            ok = false;
+            break;
+        }
+        ListState& state = mLists[key];
+        state.frame = mFrame;
+        if (!state.list)
+            state.list = IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData());
+
+        if (mode != ListUnchanged)
+        {
+            uint32_t vtxCount = r.get<uint32_t>();
+            uint32_t idxCount = r.get<uint32_t>();
+            uint32_t cmdSize = r.get<uint32_t>();
+            const uint8_t* cmds = r.take(cmdSize);
+            bool delta = mode == ListDelta;
+            // Deltas are stored at full width, so counts needing more bytes
+            // than the frame has left are malformed. Checked before
+            // allocating anything for them.
+            uint64_t needed =
+                (uint64_t)vtxCount * (4 * sizeof(uint16_t) + sizeof(ImU32)) +
+                (uint64_t)idxCount * sizeof(ImDrawIdx);
+            ok = r.ok && mode <= ListDelta &&
+                 needed <= static_cast<uint64_t>(r.end - r.p) &&
+                 (!delta || (state.col.size() == vtxCount &&
+                             state.idx.size() == idxCount));
+            if (!ok)
+            {
+                dropList(key);
+                break;
+            }
+            state.vtx.resize(vtxCount * 4);
+            state.col.resize(vtxCount);
+            state.idx.resize(idxCount);
+            for (uint32_t p = 0; p < 4 && ok; p++)
+                ok = getDeltas(r, state.vtx.data() + p * vtxCount, vtxCount,
+                               delta);
+            ok = ok && getDeltas(r, state.col.data(), vtxCount, delta) &&
+                 getDeltas(r, state.idx.data(), idxCount, delta) &&
+                 decodeCommands(cmds, cmdSize, state);
+            if (!ok)
+            {
+                // Half written, so later deltas must never match it
+                dropList(key);
+                break;
+            }
+
+            ImDrawList* list = state.list;
+            list->VtxBuffer.resize(static_cast<int>(vtxCount));
+            for (uint32_t i = 0; i < vtxCount; i++)
+            {
+                ImDrawVert& v = list->VtxBuffer.Data[i];
+                v.pos.x = static_cast<int16_t>(state.vtx[i]) / kPositionScale;
+                v.pos.y = static_cast<int16_t>(state.vtx[vtxCount + i]) /
+                          kPositionScale;
+                v.uv.x = state.vtx[vtxCount * 2 + i] / kUvScale;
+                v.uv.y = state.vtx[vtxCount * 3 + i] / kUvScale;
+                v.col = state.col[i];
+            }
+            list->IdxBuffer.resize(static_cast<int>(idxCount));
+            if (idxCount)
+                memcpy(list->IdxBuffer.Data, state.idx.data(),
+                       idxCount * sizeof(ImDrawIdx));
+        }
+        mDrawLists.push_back(state.list);
+        totalVtxCount += state.list->VtxBuffer.Size;
+        totalIdxCount += state.list->IdxBuffer.Size;
+    }
+    if (!ok || !r.ok)
+    {
+        // The lists are out of step with the encoder now, so wait for the
+        // next keyframe
+        reset();
+        return nullptr;
+    }
+
+    for (auto it = mLists.begin(); it != mLists.end();)
+    {
+        if (it->second.frame != mFrame)
+        {
+            IM_DELETE(it->second.list);
+            it = mLists.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    mDrawData.Valid = true;
+    mDrawData.CmdListsCount = static_cast<int>(mDrawLists.size());
+#if IMGUI_VERSION_NUM >= 18973
+    mDrawData.CmdLists.resize(0);
+    for (ImDrawList* list : mDrawLists)
+        mDrawData.CmdLists.push_back(list);
+#else
+    mDrawData.CmdLists = mDrawLists.data();
+#endif
+    mDrawData.TotalVtxCount = totalVtxCount;
+    mDrawData.TotalIdxCount = totalIdxCount;
+    mDrawData.DisplayPos = displayPos;
+    mDrawData.DisplaySize = displaySize;
+    mDrawData.FramebufferScale = framebufferScale;
+    return &mDrawData;
+}
+
+RemoteImGuiManager::~RemoteImGuiManager() { shutdown(); }
+
+void RemoteImGuiManager::init()
+{
+    IMGUI_CHECKVERSION();
+
+    // Create our context and setup CrossWindow event mapping:
+    ImGuiManager::create();
+
+    // The atlas only has to be built, the viewer draws with its own copy
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = "imgui_crosswindow_remote";
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+    io.Fonts->SetTexID((ImTextureID)(intptr_t)1);
+}
+
+bool RemoteImGuiManager::listenTcp(const char* address, unsigned short port)
+{
+    return mSocket.listenTcp(address, port);
+}
+
+bool RemoteImGuiManager::listenUnix(const char* path)
+{
+    return mSocket.listenUnix(path);
+}
+
+void RemoteImGuiManager::pollEvents()
+{
+    XGFX_TRACE_SCOPE("RemoteImGuiManager::pollEvents");
+    if (mSocket.accept())
+    {
+        mEncoder.reset();
+        requestRedraw();
+    }
+    uint8_t type;
+    while (mSocket.receive(type, mMessage, false))
+    {
+        xwin::Event e;
+        if (type == MessageEvent && decodeEvent(mMessage, e)) updateEvent(e);
+    }
+}
+
+void RemoteImGuiManager::renderDrawData(ImDrawData* drawData)
+{
+    XGFX_TRACE_SCOPE("RemoteImGuiManager::renderDrawData");
+    ImGuiContextScope scope(context);
+    auto cpuStart = std::chrono::high_resolution_clock::now();
+    frameStats = ImGuiFrameStats();
+    if (!mSocket.isConnected()) return;
+
+    frameStats.vertexCount = static_cast<unsigned>(drawData->TotalVtxCount);
+    frameStats.indexCount = static_cast<unsigned>(drawData->TotalIdxCount);
+    mEncoder.encode(drawData, ImGui::GetIO().Fonts->TexID, mMessage);
+    frameStats.bytesUploaded = mMessage.size();
+    if (!mSocket.send(MessageFrame, mMessage)) mEncoder.reset();
+
+    frameStats.cpuTimeMs =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - cpuStart)
+            .count();
+}
+
+size_t RemoteImGuiManager::stagingBytes() const
+{
+    return ImGuiManager::stagingBytes() + mEncoder.memoryBytes() +
+           mMessage.capacity();
+}
+
+void RemoteImGuiManager::trimStaging(ImGuiTrimPolicy policy)
+{
+    ImGuiManager::trimStaging(policy);
+    mEncoder.trim(policy);
+    mMessage.clear();
+    mMessage.shrink_to_fit();
+}
+
+bool RemoteImGuiManager::isConnected() const { return mSocket.isConnected(); }
+
+void RemoteImGuiManager::shutdown() { mSocket.close(); }
+
+bool RemoteImGuiViewer::connectTcp(const char* host, unsigned short port)
+{
+    mDecoder.reset();
+    return mSocket.connectTcp(host, port);
+}
+
+bool RemoteImGuiViewer::connectUnix(const char* path)
+{
+    mDecoder.reset();
+    return mSocket.connectUnix(path);
+}
+
+void RemoteImGuiViewer::disconnect()
+{
+    mSocket.close();
+    mDecoder.reset();
+}
+
+bool RemoteImGuiViewer::isConnected() const { return mSocket.isConnected(); }
+
+void RemoteImGuiViewer::sendEvent(const xwin::Event& e)
+{
+    if (encodeEvent(e, mMessage)) mSocket.send(MessageEvent, mMessage);
+}
+
+ImDrawData* RemoteImGuiViewer::receiveFrame(bool wait)
+{
+    XGFX_TRACE_SCOPE("RemoteImGuiViewer::receiveFrame");
+    ImDrawData* frame = nullptr;
+    uint8_t type;
+    while (mSocket.receive(type, mMessage, wait && !frame))
+    {
+        if (type != MessageFrame) continue;
+        frame = mDecoder.decode(mMessage.data(), mMessage.size());
+        if (!frame)
+        {
+            fprintf(stderr, "Remote ImGui: malformed frame, disconnecting\n");
+            disconnect();
+            return nullptr;
+        }
+    }
+    return frame;
+}
+
+void RemoteImGuiViewer::mapTexture(ImU64 remote, ImTextureID local)
+{
+    mDecoder.mapTexture(remote, local);
+}
+}
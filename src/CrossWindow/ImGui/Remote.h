@@ -0,0 +1,212 @@
+#pragma once
+
+#include "ImGuiManager.h"
+#include "imgui.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace xgfx
+{
+// A TCP or Unix domain socket carrying length prefixed messages between a
+// RemoteImGuiManager and a RemoteImGuiViewer. Both ends are expected to be
+// little endian and built against the same ImGui and CrossWindow versions.
+class RemoteSocket
+{
+  public:
+    RemoteSocket();
+
+    ~RemoteSocket();
+
+    RemoteSocket(const RemoteSocket&) = delete;
+    RemoteSocket& operator=(const RemoteSocket&) = delete;
+
+    bool listenTcp(const char* address, unsigned short port);
+
+    // Unix domain sockets aren't supported on Windows.
+    bool listenUnix(const char* path);
+
+    // Accept a waiting connection without blocking, replacing the current
+    // one. Returns true if a new connection was accepted.
+    bool accept();
+
+    bool connectTcp(const char* host, unsigned short port);
+
+    bool connectUnix(const char* path);
+
+    void close();
+
+    bool isConnected() const;
+
+    bool send(uint8_t type, const std::vector<uint8_t>& payload);
+
+    // Receive the next whole message. Without `wait` this returns false
+    // right away if none has fully arrived yet.
+    bool receive(uint8_t& type, std::vector<uint8_t>& payload, bool wait);
+
+  private:
+    void closeConnection();
+
+    intptr_t mListener;
+    intptr_t mConnection;
+    std::string mUnixPath;
+    std::vector<uint8_t> mReceived;
+    size_t mReceivedOffset = 0;
+};
+
+// Serializes ImDrawData for streaming. Each list is matched to the previous
+// frame's list of the same window and sent as unchanged, as a per vertex
+// delta against it, or in full. Positions are quantized to a quarter pixel
+// and UVs to 16 bits, and the frame is LZ4 compressed.
+class RemoteFrameEncoder
+{
+  public:
+    // Encode a frame into `out`. Commands using `fontTexture` are mapped to
+    // the viewer's own font atlas.
+    void encode(const ImDrawData* drawData, ImTextureID fontTexture,
+                std::vector<uint8_t>& out);
+
+    // Make the next frame self-contained, e.g. for a new viewer.
+    void reset();
+
+    // Bytes kept for encoding deltas and as scratch space.
+    size_t memoryBytes() const;
+
+    // Release scratch space, and with ImGuiTrimPolicy::All the previous
+    // frame too, making the next frame a keyframe.
+    void trim(ImGuiTrimPolicy policy);
+
+  private:
+    struct ListState
+    {
+        std::vector<uint16_t> vtx;
+        std::vector<ImU32> col;
+        std::vector<ImDrawIdx> idx;
+        std::vector<uint8_t> cmds;
+        uint32_t frame = 0;
+
+        size_t memoryBytes() const;
+    };
+
+    std::unordered_map<uint32_t, ListState> mLists;
+    ListState mScratch;
+    std::vector<uint8_t> mRaw;
+    uint32_t mFrame = 0;
+    bool mKeyframe = true;
+};
+
+// Rebuilds the ImDrawData sent by a RemoteFrameEncoder.
+class RemoteFrameDecoder
+{
+  public:
+    RemoteFrameDecoder();
+
+    ~RemoteFrameDecoder();
+
+    RemoteFrameDecoder(const RemoteFrameDecoder&) = delete;
+    RemoteFrameDecoder& operator=(const RemoteFrameDecoder&) = delete;
+
+    // Decode a frame, returning nullptr if it's malformed or doesn't follow
+    // the previously decoded one. The draw data stays valid until the next
+    // call to decode() or reset().
+    ImDrawData* decode(const uint8_t* data, size_t size);
+
+    // Use `local` for commands drawn with the server's texture `remote`. The
+    // font atlas is mapped to the current context's automatically.
+    void mapTexture(ImU64 remote, ImTextureID local);
+
+    void reset();
+
+  private:
+    struct ListState
+    {
+        std::vector<uint16_t> vtx;
+        std::vector<ImU32> col;
+        std::vector<ImDrawIdx> idx;
+        ImDrawList* list = nullptr;
+        uint32_t frame = 0;
+    };
+
+    bool decodeCommands(const uint8_t* data, size_t size, ListState& state);
+
+    void dropList(uint32_t key);
+
+    std::unordered_map<uint32_t, ListState> mLists;
+    std::unordered_map<ImU64, ImTextureID> mTextures;
+    std::vector<ImDrawList*> mDrawLists;
+    std::vector<uint8_t> mRaw;
+    ImDrawData mDrawData;
+    uint32_t mFrame = 0;
+};
+
+/**
+ * Runs ImGui without a display. Each rendered frame is streamed to a
+ * RemoteImGuiViewer, and the viewer's window events are fed back into
+ * updateEvent(). The viewer has to load the same fonts.
+ */
+class RemoteImGuiManager : public ImGuiManager
+{
+  public:
+    ~RemoteImGuiManager();
+
+    // Create the ImGui context and build the font atlas.
+    void init();
+
+    bool listenTcp(const char* address, unsigned short port);
+
+    bool listenUnix(const char* path);
+
+    // Accept a waiting viewer and apply the events it sent. Call once per
+    // frame before beginFrame().
+    void pollEvents();
+
+    // Encode the frame and send it to the viewer, if one is connected. The
+    // frame statistics report the bytes sent and the encoding time.
+    void renderDrawData(ImDrawData* drawData);
+
+    bool isConnected() const;
+
+    void shutdown();
+
+  protected:
+    size_t stagingBytes() const override;
+
+    void trimStaging(ImGuiTrimPolicy policy) override;
+
+  private:
+    RemoteSocket mSocket;
+    RemoteFrameEncoder mEncoder;
+    std::vector<uint8_t> mMessage;
+};
+
+// Displays a RemoteImGuiManager's frames with a local backend manager and
+// sends the local window's events back to it.
+class RemoteImGuiViewer
+{
+  public:
+    bool connectTcp(const char* host, unsigned short port);
+
+    bool connectUnix(const char* path);
+
+    void disconnect();
+
+    bool isConnected() const;
+
+    // Forward a window event to the server's ImGuiManager::updateEvent().
+    void sendEvent(const xwin::Event& e);
+
+    // Decode every frame received since the last call and return the latest,
+    // or nullptr if none arrived. With `wait`, block until one does. Render
+    // it with the local manager's renderDrawData().
+    ImDrawData* receiveFrame(bool wait = false);
+
+    void mapTexture(ImU64 remote, ImTextureID local);
+
+  private:
+    RemoteSocket mSocket;
+    RemoteFrameDecoder mDecoder;
+    std::vector<uint8_t> mMessage;
+};
+}
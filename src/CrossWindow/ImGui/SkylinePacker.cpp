@@ -0,0 +1,81 @@
+#include "SkylinePacker.h"
+
+#include <algorithm>
+
+namespace xgfx
+{
+void SkylinePacker::reset(int width, int height)
+{
+    mWidth = width;
+    mHeight = height;
+    mSkyline.clear();
+    mSkyline.push_back({0, 0, width});
+}
+
+int SkylinePacker::fit(size_t index, int width, int height) const
+{
+    int x = mSkyline[index].x;
+    if (x + width > mWidth) return -1;
+    int y = 0;
+    for (int left = width; left > 0; index++)
+    {
+        y = std::max(y, mSkyline[index].y);
+        if (y + height > mHeight) return -1;
+        left -= mSkyline[index].width;
+    }
+    return y;
+}
+
+bool SkylinePacker::pack(int width, int height, int& x, int& y)
+{
+    // Lowest top wins, then the narrowest node to keep wide gaps open
+    size_t best = mSkyline.size();
+    int best_top = mHeight + 1, best_width = 0;
+    for (size_t i = 0; i < mSkyline.size(); i++)
+    {
+        int top = fit(i, width, height);
+        if (top < 0) continue;
+        if (top + height < best_top ||
+            (top + height == best_top && mSkyline[i].width < best_width))
+        {
+            best = i;
+            best_top = top + height;
+            best_width = mSkyline[i].width;
+        }
+    }
+    if (best == mSkyline.size()) return false;
+    x = mSkyline[best].x;
+    y = best_top - height;
+
+    // Raise the skyline under the new rectangle, trimming the nodes it
+    // covers, and merge neighbours left at the same height
+    mSkyline.insert(mSkyline.begin() + best, {x, best_top, width});
+    for (size_t i = best + 1; i < mSkyline.size();)
+    {
+        Node& prev = mSkyline[i - 1];
+        Node& node = mSkyline[i];
+        int overlap = prev.x + prev.width - node.x;
+        if (overlap <= 0) break;
+        if (overlap < node.width)
+        {
+            node.x += overlap;
+            node.width -= overlap;
+            break;
+        }
+        mSkyline.erase(mSkyline.begin() + i);
+    }
+    for (size_t i = 1; i < mSkyline.size();)
+    {
+        if (mSkyline[i - 1].y == mSkyline[i].y)
+        {
+            mSkyline[i - 1].width += mSkyline[i].width;
+            mSkyline.erase(mSkyline.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+    return true;
+}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace xgfx
+{
+// Packs rectangles into a fixed size area by tracking the skyline of the
+// rectangles placed so far and putting each new one where it leaves the
+// skyline lowest. Rectangles can't be freed individually, reset() to start
+// over.
+class SkylinePacker
+{
+  public:
+    void reset(int width, int height);
+
+    // Find room for a `width` x `height` rectangle. Returns false if there's
+    // none left.
+    bool pack(int width, int height, int& x, int& y);
+
+  private:
+    struct Node
+    {
+        int x, y, width;
+    };
+
+    // Top of a rectangle placed at node `index`, or -1 if it doesn't fit
+    int fit(size_t index, int width, int height) const;
+
+    std::vector<Node> mSkyline;
+    int mWidth = 0;
+    int mHeight = 0;
+};
+}
@@ -0,0 +1,379 @@
+#include "Table.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+
+namespace xgfx
+{
+namespace
+{
+// Sort slices of `items` on the workers, then merge neighbouring slices in
+// rounds until one is left.
+template <typename T, typename Less>
+void parallelSort(WorkerPool& workers, WorkerGroup& group,
+                  std::vector<T>& items, size_t parts, const Less& less)
+{
+    std::vector<size_t> bounds(parts + 1);
+    for (size_t i = 0; i <= parts; i++)
+        bounds[i] = items.size() * i / parts;
+    for (size_t i = 0; i < parts; i++)
+    {
+        workers.submit(group, [&, i] {
+            std::sort(items.begin() + bounds[i], items.begin() + bounds[i + 1],
+                      less);
+        });
+    }
+    workers.wait(group);
+    for (size_t width = 1; width < parts; width *= 2)
+    {
+        for (size_t i = 0; i + width < parts; i += width * 2)
+        {
+            size_t first = bounds[i], middle = bounds[i + width],
+                   last = bounds[std::min(i + width * 2, parts)];
+            workers.submit(group, [&, first, middle, last] {
+                std::inplace_merge(items.begin() + first,
+                                   items.begin() + middle,
+                                   items.begin() + last, less);
+            });
+        }
+        workers.wait(group);
+    }
+}
+
+struct NumberKey
+{
+    double value;
+    uint32_t row;
+};
+
+// Ties keep source order, so the result doesn't depend on the slicing
+struct NumberLess
+{
+    bool descending;
+
+    bool operator()(const NumberKey& a, const NumberKey& b) const
+    {
+        if (a.value != b.value)
+            return descending ? a.value > b.value : a.value < b.value;
+        return a.row < b.row;
+    }
+};
+
+// The first 8 bytes of a cell's text, big endian so comparing them as
+// integers orders like strcmp()
+struct TextKey
+{
+    uint64_t prefix;
+    uint32_t row;
+};
+
+uint64_t textPrefix(const char* text)
+{
+    uint64_t prefix = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        prefix = (prefix << 8) | (unsigned char)*text;
+        if (*text) text++;
+    }
+    return prefix;
+}
+
+// Only cells sharing a prefix are compared through the source
+struct TextLess
+{
+    const TableSource* source;
+    int column;
+    bool descending;
+
+    // Each copy of the comparator, and so each sorting thread, has its own
+    mutable char a[256];
+    mutable char b[256];
+
+    bool operator()(const TextKey& x, const TextKey& y) const
+    {
+        int order = x.prefix < y.prefix ? -1 : x.prefix > y.prefix ? 1 : 0;
+        if (order == 0 && (x.prefix & 0xff) != 0)
+            order = strcmp(source->text(column, x.row, a, sizeof(a)),
+                           source->text(column, y.row, b, sizeof(b)));
+        if (order != 0) return descending ? order > 0 : order < 0;
+        return x.row < y.row;
+    }
+};
+}
+
+double TableSource::number(int column, size_t row) const { return 0.0; }
+
+TableView::TableView(WorkerPool& workers) : mWorkers(workers) {}
+
+TableView::~TableView() { finishQuery(true); }
+
+void TableView::setSource(TableSource* source)
+{
+    finishQuery(true);
+    mSource = source;
+    {
+        std::lock_guard<std::mutex> lock(mRowsMutex);
+        mRows.reset();
+    }
+    mDirty = source != nullptr;
+}
+
+void TableView::refresh() { setSource(mSource); }
+
+void TableView::setFilter(const char* filter)
+{
+    snprintf(mFilterBuf, sizeof(mFilterBuf), "%s", filter);
+    if (mQuery.filter == mFilterBuf) return;
+    mQuery.filter = mFilterBuf;
+    mDirty = true;
+}
+
+void TableView::setSort(int column, bool descending)
+{
+    if (mQuery.column == column && mQuery.descending == descending) return;
+    mQuery.column = column;
+    mQuery.descending = descending;
+    mDirty = true;
+}
+
+void TableView::flush()
+{
+    // An outdated query is cancelled, the current one runs to completion
+    if (mDirty) finishQuery(true);
+    if (mDirty && mSource) startQuery();
+    if (!mBusy) return;
+    mWorkers.wait(mQueryJob);
+    mBusy = false;
+}
+
+size_t TableView::getRowCount() const
+{
+    std::lock_guard<std::mutex> lock(mRowsMutex);
+    if (mRows) return mRows->size();
+    return mSource ? mSource->rowCount() : 0;
+}
+
+size_t TableView::getSourceRow(size_t index) const
+{
+    std::lock_guard<std::mutex> lock(mRowsMutex);
+    return mRows ? (*mRows)[index] : index;
+}
+
+bool TableView::isBusy() const { return mBusy; }
+
+void TableView::startQuery()
+{
+    mDirty = false;
+    mDone = false;
+    mCancel = false;
+    mBusy = true;
+    Query query = mQuery;
+    mWorkers.submit(mQueryJob, [this, query] {
+        runQuery(query);
+        mDone.store(true, std::memory_order_release);
+    });
+}
+
+void TableView::finishQuery(bool cancel)
+{
+    if (!mBusy) return;
+    if (cancel)
+        mCancel = true;
+    else if (!mDone.load(std::memory_order_acquire))
+        return;
+    mWorkers.wait(mQueryJob);
+    mBusy = false;
+    mCancel = false;
+}
+
+void TableView::runQuery(const Query& query)
+{
+    XGFX_TRACE_SCOPE("TableView::runQuery");
+    if (mCancel) return;
+    const TableSource& source = *mSource;
+    const size_t count = source.rowCount();
+    const int columns = source.columnCount();
+    const size_t parts = std::max(1u, std::thread::hardware_concurrency());
+    WorkerPool& workers = mWorkers;
+    WorkerGroup& group = mQueryParts;
+
+    // Filter slices of rows in parallel, keeping them in order
+    std::vector<uint32_t> rows;
+    if (query.filter.empty())
+    {
+        rows.resize(count);
+        std::iota(rows.begin(), rows.end(), 0u);
+    }
+    else
+    {
+        const char* filter = query.filter.c_str();
+        std::vector<std::vector<uint32_t>> matches(parts * 4);
+        for (size_t i = 0; i < matches.size(); i++)
+        {
+            workers.submit(group, [&, i] {
+                char buf[256];
+                size_t first = count * i / matches.size();
+                size_t last = count * (i + 1) / matches.size();
+                for (size_t row = first; row < last; row++)
+                {
+                    if ((row & 4095) == 0 && mCancel) return;
+                    for (int c = 0; c < columns; c++)
+                    {
+                        if (strstr(source.text(c, row, buf, sizeof(buf)),
+                                   filter))
+                        {
+                            matches[i].push_back((uint32_t)row);
+                            break;
+                        }
+                    }
+                }
+            });
+        }
+        workers.wait(group);
+        size_t matched = 0;
+        for (const auto& slice : matches)
+            matched += slice.size();
+        rows.reserve(matched);
+        for (const auto& slice : matches)
+            rows.insert(rows.end(), slice.begin(), slice.end());
+    }
+    if (mCancel) return;
+
+    // Sort keys extracted up front rather than reading the source on every
+    // comparison
+    if (query.column >= 0 && query.column < columns && rows.size() > 1)
+    {
+        const int column = query.column;
+        auto slices = [&](const std::function<void(size_t, size_t)>& job) {
+            for (size_t i = 0; i < parts; i++)
+                workers.submit(group, [&, i] {
+                    job(rows.size() * i / parts, rows.size() * (i + 1) / parts);
+                });
+            workers.wait(group);
+        };
+        if (source.isNumeric(column))
+        {
+            std::vector<NumberKey> keys(rows.size());
+            slices([&](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                {
+                    double value = source.number(column, rows[i]);
+                    if (std::isnan(value))
+                        value = -std::numeric_limits<double>::infinity();
+                    keys[i] = {value, rows[i]};
+                }
+            });
+            if (mCancel) return;
+            parallelSort(workers, group, keys, parts, NumberLess{query.descending});
+            for (size_t i = 0; i < keys.size(); i++)
+                rows[i] = keys[i].row;
+        }
+        else
+        {
+            std::vector<TextKey> keys(rows.size());
+            slices([&](size_t first, size_t last) {
+                char buf[256];
+                for (size_t i = first; i < last; i++)
+                    keys[i] = {textPrefix(
+                                   source.text(column, rows[i], buf,
+                                               sizeof(buf))),
+                               rows[i]};
+            });
+            if (mCancel) return;
+            TextLess less;
+            less.source = &source;
+            less.column = column;
+            less.descending = query.descending;
+            parallelSort(workers, group, keys, parts, less);
+            for (size_t i = 0; i < keys.size(); i++)
+                rows[i] = keys[i].row;
+        }
+    }
+    if (mCancel) return;
+
+    std::shared_ptr<const std::vector<uint32_t>> result =
+        std::make_shared<const std::vector<uint32_t>>(std::move(rows));
+    std::lock_guard<std::mutex> lock(mRowsMutex);
+    mRows.swap(result);
+}
+
+void TableView::draw(const char* id, const ImVec2& size)
+{
+    if (!mSource) return;
+    XGFX_TRACE_SCOPE("TableView::draw");
+    finishQuery(false);
+
+    ImGui::PushID(id);
+    if (ImGui::InputText("Filter", mFilterBuf, sizeof(mFilterBuf)))
+    {
+        mQuery.filter = mFilterBuf;
+        mDirty = true;
+    }
+    ImGui::PopID();
+
+    const int columns = mSource->columnCount();
+    const int flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY |
+                      ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders |
+                      ImGuiTableFlags_Resizable;
+    if (columns <= 0 || !ImGui::BeginTable(id, columns, flags, size)) return;
+    ImGui::TableSetupScrollFreeze(0, 1);
+    for (int c = 0; c < columns; c++)
+        ImGui::TableSetupColumn(mSource->columnName(c));
+    ImGui::TableHeadersRow();
+
+    if (ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs())
+    {
+        if (specs->SpecsDirty)
+        {
+            mQuery.column = specs->SpecsCount > 0 ? specs->Specs[0].ColumnIndex
+                                                  : -1;
+            mQuery.descending =
+                specs->SpecsCount > 0 &&
+                specs->Specs[0].SortDirection == ImGuiSortDirection_Descending;
+            specs->SpecsDirty = false;
+            mDirty = true;
+        }
+    }
+
+    // A running query is cancelled, and the new one starts once it's gone
+    if (mDirty)
+    {
+        if (mBusy)
+            mCancel = true;
+        else
+            startQuery();
+    }
+
+    std::shared_ptr<const std::vector<uint32_t>> rows;
+    {
+        std::lock_guard<std::mutex> lock(mRowsMutex);
+        rows = mRows;
+    }
+    size_t count = rows ? rows->size() : mSource->rowCount();
+    ImGuiListClipper clipper;
+    clipper.Begin(
+        (int)std::min(count, (size_t)std::numeric_limits<int>::max()));
+    char buf[256];
+    while (clipper.Step())
+    {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+        {
+            size_t row = rows ? (*rows)[i] : (size_t)i;
+            ImGui::TableNextRow();
+            for (int c = 0; c < columns; c++)
+            {
+                ImGui::TableSetColumnIndex(c);
+                ImGui::TextUnformatted(mSource->text(c, row, buf, sizeof(buf)));
+            }
+        }
+    }
+    ImGui::EndTable();
+}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "WorkerPool.h"
+#include "imgui.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xgfx
+{
+// Columnar data shown by a TableView. Cells are read from worker threads
+// while sorting and filtering, so only change the data while the view
+// isn't busy, then call TableView::refresh().
+class TableSource
+{
+  public:
+    virtual ~TableSource() {}
+
+    virtual size_t rowCount() const = 0;
+
+    virtual int columnCount() const = 0;
+
+    virtual const char* columnName(int column) const = 0;
+
+    // Numeric columns sort by number(), the rest by text().
+    virtual bool isNumeric(int column) const = 0;
+
+    virtual double number(int column, size_t row) const;
+
+    // A cell's text, either written into `buf` or pointing at the source's
+    // own storage.
+    virtual const char* text(int column, size_t row, char* buf,
+                             size_t size) const = 0;
+};
+
+/**
+ * A table over millions of rows. Only the rows in view are drawn, and
+ * sorting and filtering run in parallel on worker threads into a
+ * permutation of the source rows, which replaces the displayed one when
+ * it's complete. Until then the previous order stays on screen, and a
+ * newer request cancels an outdated one.
+ */
+class TableView
+{
+  public:
+    // Queries run on `workers`, usually the manager's getWorkerPool().
+    explicit TableView(WorkerPool& workers);
+
+    ~TableView();
+
+    TableView(const TableView&) = delete;
+    TableView& operator=(const TableView&) = delete;
+
+    void setSource(TableSource* source);
+
+    // Sort and filter again after the source's data changed. Rows are shown
+    // in the source's order until that's done.
+    void refresh();
+
+    // Show only rows with a cell containing `filter`.
+    void setFilter(const char* filter);
+
+    // Sort by `column`, or in the source's order for -1, as clicking its
+    // header would.
+    void setSort(int column, bool descending = false);
+
+    // Start a pending sort or filter now instead of in the next draw(), and
+    // block until it's complete.
+    void flush();
+
+    // Draw a filter box and the table, sorted by clicking column headers.
+    void draw(const char* id, const ImVec2& size = ImVec2(0.0f, 0.0f));
+
+    // Rows passing the filter, as of the last completed update.
+    size_t getRowCount() const;
+
+    // The source row displayed at `index`, as of the last completed update.
+    size_t getSourceRow(size_t index) const;
+
+    // Whether a sort or filter is still running.
+    bool isBusy() const;
+
+  private:
+    struct Query
+    {
+        int column = -1;
+        bool descending = false;
+        std::string filter;
+    };
+
+    void startQuery();
+
+    // Runs as a job in mQueryJob, parallelizing over mQueryParts.
+    void runQuery(const Query& query);
+
+    // Retire the query if it's done, or wait for it with `cancel`.
+    void finishQuery(bool cancel);
+
+    TableSource* mSource = nullptr;
+    Query mQuery;
+    bool mDirty = false;
+    char mFilterBuf[256] = {};
+
+    WorkerPool& mWorkers;
+    WorkerGroup mQueryJob;
+    WorkerGroup mQueryParts;
+    bool mBusy = false;
+    std::atomic<bool> mDone{false};
+    std::atomic<bool> mCancel{false};
+
+    // The displayed permutation of source rows, null for the source's own
+    // order. Swapped under the mutex and only ever replaced whole.
+    mutable std::mutex mRowsMutex;
+    std::shared_ptr<const std::vector<uint32_t>> mRows;
+};
+}
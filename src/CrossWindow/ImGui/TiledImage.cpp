@@ -0,0 +1,438 @@
+#include "TiledImage.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+#include "imgui_internal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace xgfx
+{
+namespace
+{
+const uint32_t kTiledImageMagic = 0x4d495458; // "XTIM"
+const uint32_t kTiledImageVersion = 1;
+
+// Tiles start a page in, so each one is page aligned in the mapping
+const size_t kTileDataOffset = 4096;
+
+int mipSize(int size, int level)
+{
+    return std::max(1, (size + (1 << level) - 1) >> level);
+}
+
+int tileCount(int size, int tileSize)
+{
+    return (size + tileSize - 1) / tileSize;
+}
+
+// Levels down to the first that fits a single tile
+int mipLevels(int width, int height, int tileSize)
+{
+    int levels = 1;
+    while (mipSize(width, levels - 1) > tileSize ||
+           mipSize(height, levels - 1) > tileSize)
+        levels++;
+    return levels;
+}
+
+uint64_t tileKey(int level, int tx, int ty)
+{
+    return ((uint64_t)level << 56) | ((uint64_t)ty << 28) | (uint64_t)tx;
+}
+}
+
+bool writeTiledImage(const char* path, int width, int height,
+                     const ImageRegionReader& read, int tileSize)
+{
+    XGFX_TRACE_SCOPE("writeTiledImage");
+    if (width <= 0 || height <= 0 || tileSize < 16 || tileSize > 4096)
+    {
+        fprintf(stderr, "ERROR: Invalid tiled image size!\n");
+        return false;
+    }
+
+    // Levels are stored one after the other, each as rows of tiles padded
+    // out to the full tile size
+    const int levels = mipLevels(width, height, tileSize);
+    std::vector<size_t> level_tiles(levels + 1, 0);
+    for (int l = 0; l < levels; l++)
+        level_tiles[l + 1] =
+            level_tiles[l] +
+            (size_t)tileCount(mipSize(width, l), tileSize) *
+                tileCount(mipSize(height, l), tileSize);
+    const size_t tile_bytes = (size_t)tileSize * tileSize * 4;
+    MappedFile file;
+    if (!file.create(path, kTileDataOffset + level_tiles[levels] * tile_bytes))
+        return false;
+    uint8_t* data = file.writableData();
+    const uint32_t header[6] = {kTiledImageMagic,  kTiledImageVersion,
+                                (uint32_t)width,   (uint32_t)height,
+                                (uint32_t)tileSize, (uint32_t)levels};
+    memcpy(data, header, sizeof(header));
+    auto tile = [&](int level, int tx, int ty) {
+        size_t index = level_tiles[level] +
+                       (size_t)ty * tileCount(mipSize(width, level), tileSize) +
+                       tx;
+        return data + kTileDataOffset + index * tile_bytes;
+    };
+
+    // The reader may not be thread safe, so the full resolution level is
+    // read on this thread
+    std::vector<uint8_t> region(tile_bytes);
+    for (int ty = 0; ty < tileCount(height, tileSize); ty++)
+    {
+        for (int tx = 0; tx < tileCount(width, tileSize); tx++)
+        {
+            int x = tx * tileSize, y = ty * tileSize;
+            int w = std::min(tileSize, width - x);
+            int h = std::min(tileSize, height - y);
+            read(x, y, w, h, region.data());
+            uint8_t* dst = tile(0, tx, ty);
+            for (int row = 0; row < h; row++)
+                memcpy(dst + (size_t)row * tileSize * 4,
+                       region.data() + (size_t)row * w * 4, (size_t)w * 4);
+        }
+    }
+
+    // Each further level averages 2x2 texels of the one before it, a row of
+    // tiles per job
+    WorkerPool workers;
+    for (int l = 1; l < levels; l++)
+    {
+        const int src_w = mipSize(width, l - 1), src_h = mipSize(height, l - 1);
+        const int dst_w = mipSize(width, l), dst_h = mipSize(height, l);
+        for (int ty = 0; ty < tileCount(dst_h, tileSize); ty++)
+        {
+            workers.submit([&, l, ty, src_w, src_h, dst_w, dst_h] {
+                auto texel = [&](int x, int y) {
+                    x = std::min(x, src_w - 1);
+                    y = std::min(y, src_h - 1);
+                    return tile(l - 1, x / tileSize, y / tileSize) +
+                           ((size_t)(y % tileSize) * tileSize +
+                            x % tileSize) *
+                               4;
+                };
+                for (int tx = 0; tx < tileCount(dst_w, tileSize); tx++)
+                {
+                    uint8_t* dst = tile(l, tx, ty);
+                    int w = std::min(tileSize, dst_w - tx * tileSize);
+                    int h = std::min(tileSize, dst_h - ty * tileSize);
+                    for (int y = 0; y < h; y++)
+                    {
+                        int sy = (ty * tileSize + y) * 2;
+                        for (int x = 0; x < w; x++)
+                        {
+                            int sx = (tx * tileSize + x) * 2;
+                            const uint8_t* a = texel(sx, sy);
+                            const uint8_t* b = texel(sx + 1, sy);
+                            const uint8_t* c = texel(sx, sy + 1);
+                            const uint8_t* d = texel(sx + 1, sy + 1);
+                            uint8_t* out =
+                                dst + ((size_t)y * tileSize + x) * 4;
+                            for (int i = 0; i < 4; i++)
+                                out[i] = (uint8_t)((a[i] + b[i] + c[i] +
+                                                    d[i] + 2) >>
+                                                   2);
+                        }
+                    }
+                }
+            });
+        }
+        workers.wait();
+    }
+    return true;
+}
+
+TiledImageView::TiledImageView(WorkerPool& workers) : mWorkers(workers) {}
+
+TiledImageView::~TiledImageView() { close(); }
+
+bool TiledImageView::open(const char* path)
+{
+    close();
+    if (!mFile.open(path)) return false;
+    bool valid = mFile.size() >= kTileDataOffset;
+    if (valid)
+    {
+        memcpy(&mHeader, mFile.data(), sizeof(mHeader));
+        valid = mHeader.magic == kTiledImageMagic &&
+                mHeader.version == kTiledImageVersion && mHeader.width > 0 &&
+                mHeader.height > 0 && mHeader.width < (1u << 28) &&
+                mHeader.height < (1u << 28) && mHeader.tileSize >= 16 &&
+                mHeader.tileSize <= 4096 &&
+                (int)mHeader.levels == mipLevels(mHeader.width, mHeader.height,
+                                                 mHeader.tileSize);
+    }
+    if (valid)
+    {
+        mLevelTiles.assign(mHeader.levels + 1, 0);
+        for (int l = 0; l < (int)mHeader.levels; l++)
+            mLevelTiles[l + 1] =
+                mLevelTiles[l] + (size_t)levelTilesX(l) * levelTilesY(l);
+        size_t tile_bytes = (size_t)mHeader.tileSize * mHeader.tileSize * 4;
+        valid = mFile.size() >=
+                kTileDataOffset + mLevelTiles[mHeader.levels] * tile_bytes;
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "ERROR: %s isn't a tiled image!\n", path);
+        close();
+        return false;
+    }
+    mZoom = 0.0f;
+    return true;
+}
+
+void TiledImageView::close()
+{
+    mWorkers.wait(mLoadJobs);
+    mLoads.clear();
+    destroyCache();
+    mFile.close();
+    mHeader = Header();
+    mLevelTiles.clear();
+}
+
+bool TiledImageView::isOpen() const { return mFile.isOpen(); }
+
+int TiledImageView::getWidth() const { return (int)mHeader.width; }
+
+int TiledImageView::getHeight() const { return (int)mHeader.height; }
+
+void TiledImageView::setCacheSize(int tilesPerSide, int maxLoads)
+{
+    if (tilesPerSide != mCacheTiles) destroyCache();
+    mCacheTiles = std::max(tilesPerSide, 2);
+    mMaxLoads = std::max(maxLoads, 1);
+}
+
+void TiledImageView::setView(const ImVec2& center, float zoom)
+{
+    mCenter = center;
+    mZoom = zoom;
+}
+
+ImVec2 TiledImageView::getCenter() const { return mCenter; }
+
+float TiledImageView::getZoom() const { return mZoom; }
+
+int TiledImageView::levelWidth(int level) const
+{
+    return mipSize((int)mHeader.width, level);
+}
+
+int TiledImageView::levelHeight(int level) const
+{
+    return mipSize((int)mHeader.height, level);
+}
+
+int TiledImageView::levelTilesX(int level) const
+{
+    return tileCount(levelWidth(level), (int)mHeader.tileSize);
+}
+
+int TiledImageView::levelTilesY(int level) const
+{
+    return tileCount(levelHeight(level), (int)mHeader.tileSize);
+}
+
+int TiledImageView::findTile(int level, int tx, int ty, bool load)
+{
+    uint64_t key = tileKey(level, tx, ty);
+    auto it = mCachedTiles.find(key);
+    if (it != mCachedTiles.end())
+    {
+        mSlots[it->second].lastFrame = mFrame;
+        return it->second;
+    }
+    if (!load || (int)mLoads.size() >= mMaxLoads) return -1;
+    for (const auto& pending : mLoads)
+        if (pending->key == key) return -1;
+
+    const size_t tile_bytes = (size_t)mHeader.tileSize * mHeader.tileSize * 4;
+    size_t index = mLevelTiles[level] + (size_t)ty * levelTilesX(level) + tx;
+    std::unique_ptr<TileLoad> tile(new TileLoad());
+    tile->key = key;
+    tile->src = mFile.data() + kTileDataOffset + index * tile_bytes;
+    TileLoad* job = tile.get();
+    mLoads.push_back(std::move(tile));
+    mWorkers.submit(mLoadJobs, [job, tile_bytes] {
+        job->pixels.assign(job->src, job->src + tile_bytes);
+        job->done.store(true, std::memory_order_release);
+    });
+    return -1;
+}
+
+void TiledImageView::finishLoads(ImGuiManager& manager)
+{
+    const int tile_size = (int)mHeader.tileSize;
+    for (size_t i = 0; i < mLoads.size();)
+    {
+        TileLoad& tile = *mLoads[i];
+        if (!tile.done.load(std::memory_order_acquire))
+        {
+            i++;
+            continue;
+        }
+
+        // Tiles drawn last frame are only replaced once nothing older is
+        // left, and ones uploaded this frame never are
+        int slot = -1;
+        for (int s = 0; s < (int)mSlots.size(); s++)
+            if (mSlots[s].lastFrame != mFrame &&
+                (slot < 0 || mSlots[s].lastFrame < mSlots[slot].lastFrame))
+                slot = s;
+        if (slot >= 0)
+        {
+            CacheSlot& cached = mSlots[slot];
+            if (cached.key != ~0ull) mCachedTiles.erase(cached.key);
+            cached.key = tile.key;
+            cached.lastFrame = mFrame;
+            mCachedTiles[tile.key] = slot;
+            manager.updateTexture(mCacheTexture,
+                                  (slot % mCacheTiles) * tile_size,
+                                  (slot / mCacheTiles) * tile_size, tile_size,
+                                  tile_size, tile.pixels.data());
+        }
+        mLoads.erase(mLoads.begin() + i);
+    }
+}
+
+void TiledImageView::drawTile(ImDrawList* drawList, int level, int tx,
+                              int ty, const ImVec2& origin)
+{
+    // The tile's rect in full resolution pixels
+    const int tile_size = (int)mHeader.tileSize;
+    const float span = (float)(tile_size << level);
+    float x0 = tx * span, y0 = ty * span;
+    float x1 = std::min(x0 + span, (float)mHeader.width);
+    float y1 = std::min(y0 + span, (float)mHeader.height);
+
+    int slot = findTile(level, tx, ty, true);
+    int found = level;
+    for (int l = level + 1; slot < 0 && l < (int)mHeader.levels; l++)
+    {
+        slot = findTile(l, tx >> (l - level), ty >> (l - level), false);
+        found = l;
+    }
+    if (slot < 0) return;
+
+    // Texels of the cached tile covering the rect, kept half a texel inside
+    // its content so filtering doesn't reach into the next slot
+    const float texel = (float)(1 << found);
+    const float tile_x = (float)((tx >> (found - level)) * tile_size),
+                tile_y = (float)((ty >> (found - level)) * tile_size);
+    const float content_w =
+        (float)std::min(tile_size, levelWidth(found) - (int)tile_x);
+    const float content_h =
+        (float)std::min(tile_size, levelHeight(found) - (int)tile_y);
+    float u0 = ImClamp(x0 / texel - tile_x, 0.5f, content_w - 0.5f);
+    float v0 = ImClamp(y0 / texel - tile_y, 0.5f, content_h - 0.5f);
+    float u1 = ImClamp(x1 / texel - tile_x, 0.5f, content_w - 0.5f);
+    float v1 = ImClamp(y1 / texel - tile_y, 0.5f, content_h - 0.5f);
+    const float side = (float)(mCacheTiles * tile_size);
+    const float slot_x = (float)((slot % mCacheTiles) * tile_size);
+    const float slot_y = (float)((slot / mCacheTiles) * tile_size);
+    drawList->AddImage(
+        mCacheTexture,
+        ImVec2(origin.x + (x0 - mCenter.x) * mZoom,
+               origin.y + (y0 - mCenter.y) * mZoom),
+        ImVec2(origin.x + (x1 - mCenter.x) * mZoom,
+               origin.y + (y1 - mCenter.y) * mZoom),
+        ImVec2((slot_x + u0) / side, (slot_y + v0) / side),
+        ImVec2((slot_x + u1) / side, (slot_y + v1) / side));
+}
+
+bool TiledImageView::draw(ImGuiManager& manager, const ImVec2& size)
+{
+    if (!mFile.isOpen() || size.x <= 0.0f || size.y <= 0.0f) return false;
+    XGFX_TRACE_SCOPE("TiledImageView::draw");
+    const int tile_size = (int)mHeader.tileSize;
+    if (!mCacheTexture)
+    {
+        int side = mCacheTiles * tile_size;
+        mCacheTexture = manager.createTexture(side, side);
+        if (!mCacheTexture)
+        {
+            fprintf(stderr, "ERROR: Failed to create the tile cache!\n");
+            return false;
+        }
+        mManager = &manager;
+        mSlots.assign((size_t)mCacheTiles * mCacheTiles, CacheSlot());
+    }
+    mFrame++;
+    finishLoads(manager);
+
+    // Drag to pan, scroll to zoom about the cursor
+    const ImVec2 pos = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton("##TiledImageView", size);
+    const float fit = std::min(size.x / mHeader.width, size.y / mHeader.height);
+    if (mZoom <= 0.0f)
+    {
+        mZoom = fit;
+        mCenter = ImVec2(mHeader.width * 0.5f, mHeader.height * 0.5f);
+    }
+    ImGuiIO& io = ImGui::GetIO();
+    if (ImGui::IsItemActive() && ImGui::IsMouseDragging(0, 0.0f))
+    {
+        mCenter.x -= io.MouseDelta.x / mZoom;
+        mCenter.y -= io.MouseDelta.y / mZoom;
+    }
+    const ImVec2 origin(pos.x + size.x * 0.5f, pos.y + size.y * 0.5f);
+    if (ImGui::IsItemHovered() && io.MouseWheel != 0.0f)
+    {
+        ImVec2 mouse = ImGui::GetMousePos();
+        float zoom = ImClamp(mZoom * powf(1.2f, io.MouseWheel), fit * 0.5f,
+                             32.0f);
+        mCenter.x += (mouse.x - origin.x) * (1.0f / mZoom - 1.0f / zoom);
+        mCenter.y += (mouse.y - origin.y) * (1.0f / mZoom - 1.0f / zoom);
+        mZoom = zoom;
+    }
+
+    // The finest level with no more than one texel per screen pixel
+    const int levels = (int)mHeader.levels;
+    int level = mZoom >= 1.0f ? 0 : (int)floorf(log2f(1.0f / mZoom));
+    level = ImClamp(level, 0, levels - 1);
+
+    // The coarsest level is always requested, as the fallback for the rest
+    findTile(levels - 1, 0, 0, true);
+
+    // A view needing more tiles than the cache holds next to that fallback
+    // would evict tiles it's still drawing every frame, so it drops to
+    // coarser levels until they fit
+    const float half_w = size.x * 0.5f / mZoom, half_h = size.y * 0.5f / mZoom;
+    int tx0, ty0, tx1, ty1;
+    for (;; level++)
+    {
+        const float span = (float)(tile_size << level);
+        tx0 = std::max(0, (int)floorf((mCenter.x - half_w) / span));
+        ty0 = std::max(0, (int)floorf((mCenter.y - half_h) / span));
+        tx1 = std::min(levelTilesX(level) - 1,
+                       (int)floorf((mCenter.x + half_w) / span));
+        ty1 = std::min(levelTilesY(level) - 1,
+                       (int)floorf((mCenter.y + half_h) / span));
+        int visible = std::max(0, tx1 - tx0 + 1) * std::max(0, ty1 - ty0 + 1);
+        if (level == levels - 1 || visible < mCacheTiles * mCacheTiles) break;
+    }
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->PushClipRect(pos, ImVec2(pos.x + size.x, pos.y + size.y), true);
+    for (int ty = ty0; ty <= ty1; ty++)
+        for (int tx = tx0; tx <= tx1; tx++)
+            drawTile(draw_list, level, tx, ty, origin);
+    draw_list->PopClipRect();
+    return true;
+}
+
+void TiledImageView::destroyCache()
+{
+    if (mManager && mCacheTexture) mManager->destroyTexture(mCacheTexture);
+    mManager = nullptr;
+    mCacheTexture = nullptr;
+    mCachedTiles.clear();
+    mSlots.clear();
+}
+}
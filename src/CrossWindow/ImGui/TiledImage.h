@@ -0,0 +1,138 @@
+#pragma once
+
+#include "ImGuiManager.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+#include "imgui.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace xgfx
+{
+// Fill `pixels` with the RGBA8 pixels of the `width` x `height` region of a
+// source image at `x`, `y`, rows tightly packed.
+typedef std::function<void(int x, int y, int width, int height,
+                           uint8_t* pixels)>
+    ImageRegionReader;
+
+// Write an image of any size to `path` for TiledImageView, as RGBA8 tiles
+// of `tileSize` with mip levels down to a single tile. The source is read a
+// tile at a time and the file is filled through a mapping, so memory use
+// doesn't grow with the image.
+bool writeTiledImage(const char* path, int width, int height,
+                     const ImageRegionReader& read, int tileSize = 256);
+
+/**
+ * Displays a tiled image from writeTiledImage(), such as a gigapixel scan.
+ * Only the tiles in view are read, at the mip level closest to the zoom,
+ * on worker threads straight from the mapped file. They're kept in a
+ * fixed size cache texture, so a view draws with a single texture and its
+ * memory use doesn't depend on the image size. Until a tile arrives the
+ * closest coarser cached one is drawn in its place.
+ */
+class TiledImageView
+{
+  public:
+    // Tiles are read on `workers`, usually the manager's getWorkerPool().
+    explicit TiledImageView(WorkerPool& workers);
+
+    // Call close() first if the manager is shut down before the view.
+    ~TiledImageView();
+
+    TiledImageView(const TiledImageView&) = delete;
+    TiledImageView& operator=(const TiledImageView&) = delete;
+
+    bool open(const char* path);
+
+    void close();
+
+    bool isOpen() const;
+
+    int getWidth() const;
+
+    int getHeight() const;
+
+    // The cache texture holds `tilesPerSide` squared tiles, and at most
+    // `maxLoads` more are read at once. A view needing more tiles than fit
+    // draws a coarser level. Set before the first draw().
+    void setCacheSize(int tilesPerSide = 16, int maxLoads = 16);
+
+    // Center the view on `center`, in image pixels, at `zoom` screen pixels
+    // per image pixel. Zero zoom fits the whole image on the next draw.
+    void setView(const ImVec2& center, float zoom);
+
+    ImVec2 getCenter() const;
+
+    float getZoom() const;
+
+    // Draw the image into a `size` region at the cursor with textures from
+    // `manager`, dragging to pan and scrolling to zoom. Returns false if the
+    // manager can't create the cache texture.
+    bool draw(ImGuiManager& manager, const ImVec2& size);
+
+  private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width, height;
+        uint32_t tileSize;
+        uint32_t levels;
+    };
+
+    // A tile copied out of the mapping on a worker, which pages it in off
+    // the UI thread.
+    struct TileLoad
+    {
+        uint64_t key = 0;
+        const uint8_t* src = nullptr;
+        std::vector<uint8_t> pixels;
+        std::atomic<bool> done{false};
+    };
+
+    struct CacheSlot
+    {
+        uint64_t key = ~0ull;
+        unsigned lastFrame = 0;
+    };
+
+    int levelWidth(int level) const;
+    int levelHeight(int level) const;
+    int levelTilesX(int level) const;
+    int levelTilesY(int level) const;
+
+    // Cache slot holding a tile, or -1 after requesting it with `load`.
+    int findTile(int level, int tx, int ty, bool load);
+
+    // Upload finished loads into the least recently drawn slots.
+    void finishLoads(ImGuiManager& manager);
+
+    // Draw the image rect of a tile from the cache, or from a coarser level
+    // if it isn't cached yet.
+    void drawTile(ImDrawList* drawList, int level, int tx, int ty,
+                  const ImVec2& origin);
+
+    void destroyCache();
+
+    MappedFile mFile;
+    Header mHeader = {};
+    std::vector<size_t> mLevelTiles;
+    WorkerPool& mWorkers;
+    WorkerGroup mLoadJobs;
+    std::vector<std::unique_ptr<TileLoad>> mLoads;
+    std::unordered_map<uint64_t, int> mCachedTiles;
+    std::vector<CacheSlot> mSlots;
+    ImGuiManager* mManager = nullptr;
+    ImTextureID mCacheTexture = nullptr;
+    int mCacheTiles = 16;
+    int mMaxLoads = 16;
+    unsigned mFrame = 0;
+    ImVec2 mCenter;
+    float mZoom = 0.0f;
+};
+}
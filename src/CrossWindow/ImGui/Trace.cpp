@@ -0,0 +1,155 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace xgfx
+{
+namespace trace
+{
+namespace
+{
+const uint64_t kRingCapacity = 4096;
+
+// Zone fields are relaxed atomics so the dump may read a ring while its
+// owner thread is writing to it.
+struct Zone
+{
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+struct ThreadRing
+{
+    uint32_t threadId = 0;
+    std::atomic<uint64_t> head{0};
+    Zone zones[kRingCapacity];
+    ThreadRing* next = nullptr;
+};
+
+// Rings are pushed onto this list once per thread and never freed, so zones
+// of threads that have exited can still be dumped.
+std::atomic<ThreadRing*> ringList{nullptr};
+std::atomic<uint32_t> nextThreadId{1};
+
+ThreadRing* getThreadRing()
+{
+    thread_local ThreadRing* ring = nullptr;
+    if (!ring)
+    {
+        ring = new ThreadRing();
+        ring->threadId = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+        ThreadRing* head = ringList.load(std::memory_order_relaxed);
+        do
+        {
+            ring->next = head;
+        } while (!ringList.compare_exchange_weak(head, ring,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    }
+    return ring;
+}
+
+void appendEscaped(std::string& out, const char* s)
+{
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\') out += '\\';
+        if (static_cast<unsigned char>(*s) >= 0x20) out += *s;
+    }
+}
+}
+
+uint64_t now()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+void recordZone(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    ThreadRing* ring = getThreadRing();
+    uint64_t index = ring->head.load(std::memory_order_relaxed);
+    Zone& zone = ring->zones[index % kRingCapacity];
+    zone.name.store(name, std::memory_order_relaxed);
+    zone.start.store(startNs, std::memory_order_relaxed);
+    zone.end.store(endNs, std::memory_order_relaxed);
+    ring->head.store(index + 1, std::memory_order_release);
+}
+
+std::string dumpChromeTrace()
+{
+    struct CopiedZone
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+    std::vector<CopiedZone> copied;
+
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    char buf[128];
+    for (ThreadRing* ring = ringList.load(std::memory_order_acquire); ring;
+         ring = ring->next)
+    {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > kRingCapacity ? head - kRingCapacity : 0;
+        copied.clear();
+        for (uint64_t i = begin; i < head; ++i)
+        {
+            const Zone& zone = ring->zones[i % kRingCapacity];
+            copied.push_back({zone.name.load(std::memory_order_relaxed),
+                              zone.start.load(std::memory_order_relaxed),
+                              zone.end.load(std::memory_order_relaxed)});
+        }
+
+        // Drop the entries the owner may have overwritten while we copied.
+        // The fence keeps the copies above from moving after this load. The
+        // slot of index headAfter - kRingCapacity may be mid write, since
+        // head is only published after a zone is stored.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t headAfter = ring->head.load(std::memory_order_relaxed);
+        uint64_t firstValid = headAfter + 1 > kRingCapacity
+                                  ? headAfter + 1 - kRingCapacity
+                                  : 0;
+        size_t skip = firstValid > begin
+                          ? static_cast<size_t>(firstValid - begin)
+                          : 0;
+
+        for (size_t i = skip; i < copied.size(); ++i)
+        {
+            const CopiedZone& zone = copied[i];
+            if (!zone.name) continue;
+            if (!first) out += ',';
+            first = false;
+            out += "{\"name\":\"";
+            appendEscaped(out, zone.name);
+            std::snprintf(buf, sizeof(buf),
+                          "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+                          "\"dur\":%.3f}",
+                          ring->threadId, zone.start / 1000.0,
+                          (zone.end - zone.start) / 1000.0);
+            out += buf;
+        }
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+}
+
+bool writeChromeTrace(const char* path)
+{
+    std::FILE* file = std::fopen(path, "wb");
+    if (!file) return false;
+    std::string json = dumpChromeTrace();
+    bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+    std::fclose(file);
+    return written;
+}
+}
+}
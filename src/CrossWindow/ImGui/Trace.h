@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace xgfx
+{
+namespace trace
+{
+// Nanoseconds on a monotonic clock.
+uint64_t now();
+
+// Record a completed zone into the calling thread's ring buffer. Each thread
+// writes to its own ring so recording never takes a lock; the oldest zones
+// are overwritten once the ring is full. `name` must outlive the trace.
+void recordZone(const char* name, uint64_t startNs, uint64_t endNs);
+
+// Serialize the zones recorded by every thread as Chrome trace event JSON,
+// loadable in chrome://tracing or ui.perfetto.dev.
+std::string dumpChromeTrace();
+
+bool writeChromeTrace(const char* path);
+
+// Records the lifetime of a scope as a zone.
+class Scope
+{
+  public:
+    explicit Scope(const char* name) : mName(name), mStart(now()) {}
+
+    ~Scope() { recordZone(mName, mStart, now()); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    const char* mName;
+    uint64_t mStart;
+};
+}
+}
+
+// Trace zones compile away entirely unless XGFX_IMGUI_TRACE is defined.
+#if defined(XGFX_IMGUI_TRACE)
+#define XGFX_TRACE_CONCAT_IMPL(a, b) a##b
+#define XGFX_TRACE_CONCAT(a, b) XGFX_TRACE_CONCAT_IMPL(a, b)
+#define XGFX_TRACE_SCOPE(name)                                                 \
+    xgfx::trace::Scope XGFX_TRACE_CONCAT(xgfxTraceScope, __LINE__)(name)
+#else
+#define XGFX_TRACE_SCOPE(name)
+#endif
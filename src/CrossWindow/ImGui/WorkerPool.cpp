@@ -0,0 +1,99 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace xgfx
+{
+WorkerPool::WorkerPool(unsigned threads)
+{
+    if (threads == 0)
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned i = 0; i < threads; i++)
+        mThreads.emplace_back([this] { run(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    for (std::thread& thread : mThreads)
+        thread.join();
+}
+
+void WorkerPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back({std::move(job), nullptr});
+    }
+    mWake.notify_one();
+}
+
+void WorkerPool::submit(WorkerGroup& group, std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        group.mPending++;
+        mJobs.push_back({std::move(job), &group});
+    }
+    mWake.notify_one();
+}
+
+void WorkerPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this] { return mJobs.empty() && mRunning == 0; });
+}
+
+void WorkerPool::wait(WorkerGroup& group)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (group.mPending > 0)
+    {
+        auto it = std::find_if(mJobs.begin(), mJobs.end(),
+                               [&](const Job& job) {
+                                   return job.group == &group;
+                               });
+        if (it == mJobs.end())
+        {
+            // The rest are running on workers
+            mIdle.wait(lock);
+            continue;
+        }
+        Job job = std::move(*it);
+        mJobs.erase(it);
+        runJob(lock, job);
+    }
+}
+
+void WorkerPool::run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;)
+    {
+        mWake.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+        if (mJobs.empty()) return;
+        Job job = std::move(mJobs.front());
+        mJobs.pop_front();
+        runJob(lock, job);
+    }
+}
+
+void WorkerPool::runJob(std::unique_lock<std::mutex>& lock, Job& job)
+{
+    mRunning++;
+    lock.unlock();
+    job.run();
+    job.run = nullptr;
+    lock.lock();
+    mRunning--;
+    bool finished = job.group && --job.group->mPending == 0;
+    if (finished || (mJobs.empty() && mRunning == 0)) mIdle.notify_all();
+}
+}
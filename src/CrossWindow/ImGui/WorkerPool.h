@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xgfx
+{
+// Jobs submitted to a shared pool together, so their submitter can wait for
+// them without waiting on everyone else's.
+class WorkerGroup
+{
+  public:
+    WorkerGroup() {}
+
+    WorkerGroup(const WorkerGroup&) = delete;
+    WorkerGroup& operator=(const WorkerGroup&) = delete;
+
+  private:
+    friend class WorkerPool;
+
+    unsigned mPending = 0;
+};
+
+// A fixed set of threads running jobs in submission order, for work a
+// backend moves off the UI thread.
+class WorkerPool
+{
+  public:
+    // Zero starts one thread per core but the calling one.
+    explicit WorkerPool(unsigned threads = 0);
+
+    // Finishes queued jobs before joining the threads.
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> job);
+
+    void submit(WorkerGroup& group, std::function<void()> job);
+
+    // Block until every submitted job has run.
+    void wait();
+
+    // Block until the group's jobs have run, running its queued ones on the
+    // calling thread meanwhile, so a job can wait for jobs it submitted in
+    // another group even when every worker is busy.
+    void wait(WorkerGroup& group);
+
+  private:
+    struct Job
+    {
+        std::function<void()> run;
+        WorkerGroup* group;
+    };
+
+    void run();
+
+    // Run a job taken off the queue, with the mutex held on entry and exit.
+    void runJob(std::unique_lock<std::mutex>& lock, Job& job);
+
+    std::vector<std::thread> mThreads;
+    std::deque<Job> mJobs;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mIdle;
+    unsigned mRunning = 0;
+    bool mStopping = false;
+};
+}
@@ -0,0 +1,59 @@
+#include "CrossWindow/ImGui/Capture.h"
+#include "Png.h"
+#include "Test.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace xgfx;
+using namespace xgfx::test;
+
+XGFX_TEST(Capture, ConvertsReadback)
+{
+    // Two rows of BGRA, bottom first
+    const uint8_t src[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    uint8_t dst[16];
+    convertReadback(src, dst, 2, 2);
+    const uint8_t expected[] = {11, 10, 9,  255, 15, 14, 13, 255,
+                                3,  2,  1,  255, 7,  6,  5,  255};
+    XGFX_CHECK(memcmp(dst, expected, sizeof(dst)) == 0);
+}
+
+XGFX_TEST(Capture, EncodesDecodablePng)
+{
+    CaptureImage image;
+    image.width = 67;
+    image.height = 41;
+    image.pixels.resize((size_t)image.width * image.height * 4);
+    for (int y = 0; y < image.height; y++)
+    {
+        for (int x = 0; x < image.width; x++)
+        {
+            // Flat areas, gradients and noise
+            uint8_t* p = &image.pixels[(y * image.width + x) * 4];
+            p[0] = x < 20 ? 40 : (uint8_t)(x * 3);
+            p[1] = (uint8_t)(y * 5);
+            p[2] = (uint8_t)((x * 7919 + y * 104729) >> 3);
+            p[3] = 255;
+        }
+    }
+    std::vector<uint8_t> png;
+    encodePng(image, png);
+    Image decoded;
+    if (!decodePng(png, decoded)) return;
+    XGFX_CHECK(decoded.width == image.width);
+    XGFX_CHECK(decoded.height == image.height);
+    XGFX_CHECK(decoded.pixels == image.pixels);
+}
+
+XGFX_TEST(Capture, EncodesTinyPng)
+{
+    CaptureImage image;
+    image.width = 1;
+    image.height = 1;
+    image.pixels = {1, 2, 3, 255};
+    std::vector<uint8_t> png;
+    encodePng(image, png);
+    Image decoded;
+    if (decodePng(png, decoded)) XGFX_CHECK(decoded.pixels == image.pixels);
+}
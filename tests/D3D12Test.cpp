@@ -0,0 +1,174 @@
+#include "CrossWindow/ImGui/DirectX12.h"
+#include "Scenes.h"
+#include "Test.h"
+#include "imgui.h"
+
+#include <d3d12.h>
+#include <dxgi1_4.h>
+#include <windows.h>
+#include <wrl/client.h>
+
+using namespace xgfx;
+using namespace xgfx::test;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+// A device on WARP, the software rasterizer that ships with Windows, so the
+// scenes run the same on machines without a GPU.
+class D3D12Context
+{
+  public:
+    ~D3D12Context()
+    {
+        if (mFenceEvent) CloseHandle(mFenceEvent);
+    }
+
+    bool create()
+    {
+        ComPtr<IDXGIFactory4> factory;
+        ComPtr<IDXGIAdapter> warp;
+        if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) ||
+            FAILED(factory->EnumWarpAdapter(IID_PPV_ARGS(&warp))) ||
+            FAILED(D3D12CreateDevice(warp.Get(), D3D_FEATURE_LEVEL_11_0,
+                                     IID_PPV_ARGS(&device))))
+            return false;
+
+        D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+        queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+        D3D12_DESCRIPTOR_HEAP_DESC rtvDesc = {};
+        rtvDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+        rtvDesc.NumDescriptors = 1;
+        D3D12_DESCRIPTOR_HEAP_DESC srvDesc = {};
+        srvDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+        srvDesc.NumDescriptors = 1;
+        srvDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        if (FAILED(device->CreateCommandQueue(&queueDesc,
+                                              IID_PPV_ARGS(&queue))) ||
+            FAILED(device->CreateCommandAllocator(
+                D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator))) ||
+            FAILED(device->CreateCommandList(
+                0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator.Get(), nullptr,
+                IID_PPV_ARGS(&commandList))) ||
+            FAILED(commandList->Close()) ||
+            FAILED(device->CreateDescriptorHeap(&rtvDesc,
+                                                IID_PPV_ARGS(&rtvHeap))) ||
+            FAILED(device->CreateDescriptorHeap(&srvDesc,
+                                                IID_PPV_ARGS(&srvHeap))) ||
+            FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE,
+                                       IID_PPV_ARGS(&fence))))
+            return false;
+        mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+        D3D12_HEAP_PROPERTIES heap = {};
+        heap.Type = D3D12_HEAP_TYPE_DEFAULT;
+        D3D12_RESOURCE_DESC desc = {};
+        desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        desc.Width = kSceneWidth;
+        desc.Height = kSceneHeight;
+        desc.DepthOrArraySize = 1;
+        desc.MipLevels = 1;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+        D3D12_CLEAR_VALUE clear = {};
+        clear.Format = desc.Format;
+        if (FAILED(device->CreateCommittedResource(
+                &heap, D3D12_HEAP_FLAG_NONE, &desc,
+                D3D12_RESOURCE_STATE_RENDER_TARGET, &clear,
+                IID_PPV_ARGS(&target))))
+            return false;
+        rtv = rtvHeap->GetCPUDescriptorHandleForHeapStart();
+        device->CreateRenderTargetView(target.Get(), nullptr, rtv);
+        return mFenceEvent != nullptr;
+    }
+
+    ID3D12GraphicsCommandList* begin()
+    {
+        allocator->Reset();
+        commandList->Reset(allocator.Get(), nullptr);
+        const float clearColor[4] = {0.1f, 0.2f, 0.3f, 1.0f};
+        commandList->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+        commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+        ID3D12DescriptorHeap* heaps[] = {srvHeap.Get()};
+        commandList->SetDescriptorHeaps(1, heaps);
+        return commandList.Get();
+    }
+
+    // Submit the frame and wait for the GPU, so every frame can reuse the
+    // same allocator.
+    bool finish()
+    {
+        if (FAILED(commandList->Close())) return false;
+        ID3D12CommandList* lists[] = {commandList.Get()};
+        queue->ExecuteCommandLists(1, lists);
+        queue->Signal(fence.Get(), ++mFenceValue);
+        fence->SetEventOnCompletion(mFenceValue, mFenceEvent);
+        WaitForSingleObject(mFenceEvent, INFINITE);
+        return SUCCEEDED(device->GetDeviceRemovedReason());
+    }
+
+    ComPtr<ID3D12Device> device;
+    ComPtr<ID3D12CommandQueue> queue;
+    ComPtr<ID3D12CommandAllocator> allocator;
+    ComPtr<ID3D12GraphicsCommandList> commandList;
+    ComPtr<ID3D12DescriptorHeap> rtvHeap, srvHeap;
+    ComPtr<ID3D12Resource> target;
+    ComPtr<ID3D12Fence> fence;
+    D3D12_CPU_DESCRIPTOR_HANDLE rtv = {};
+
+  private:
+    HANDLE mFenceEvent = nullptr;
+    UINT64 mFenceValue = 0;
+};
+
+// Render a scene with a fresh manager, so no window state carries over
+void renderScene(D3D12Context& d3d, const Scene& scene, bool fontSdf)
+{
+    D3D12ImGuiManager manager;
+    manager.init(d3d.device.Get(), 1, DXGI_FORMAT_R8G8B8A8_UNORM,
+                 d3d.srvHeap.Get(),
+                 d3d.srvHeap->GetCPUDescriptorHandleForHeapStart(),
+                 d3d.srvHeap->GetGPUDescriptorHandleForHeapStart());
+    manager.setFontSdf(fontSdf);
+    manager.setAnalyticShapes(true);
+    manager.newFrame();
+    bool ok = true;
+    runScene(manager, scene, [&](ImDrawData* drawData) {
+        manager.renderDrawData(drawData, d3d.begin());
+        ok = d3d.finish() && ok;
+    });
+    XGFX_CHECK(ok);
+
+    // The distance field needs padding between glyphs
+    if (fontSdf)
+    {
+        manager.makeCurrent();
+        XGFX_CHECK(ImGui::GetIO().Fonts->TexGlyphPadding >= 4);
+    }
+    manager.shutdown();
+}
+}
+
+XGFX_TEST(DirectX12, StaysWithinSceneBudgets)
+{
+    D3D12Context d3d;
+    if (!d3d.create())
+    {
+        skip("no WARP device");
+        return;
+    }
+    for (int i = 0; i < kSceneCount; i++)
+        renderScene(d3d, kScenes[i], false);
+}
+
+XGFX_TEST(DirectX12, DrawsDistanceFieldFonts)
+{
+    D3D12Context d3d;
+    if (!d3d.create())
+    {
+        skip("no WARP device");
+        return;
+    }
+    renderScene(d3d, kScenes[0], true);
+}
@@ -0,0 +1,74 @@
+#include "CrossWindow/ImGui/EventQueue.h"
+#include "Test.h"
+
+#include <thread>
+#include <vector>
+
+using namespace xgfx;
+
+XGFX_TEST(EventQueue, RoundsCapacityUp)
+{
+    EventQueue<int> queue(5);
+    int pushed = 0;
+    while (pushed < 100 && queue.push(pushed))
+        pushed++;
+    XGFX_CHECK(pushed == 8);
+
+    int value = -1;
+    XGFX_CHECK(queue.pop(value) && value == 0);
+    XGFX_CHECK(queue.push(8));
+    XGFX_CHECK(!queue.push(9));
+}
+
+XGFX_TEST(EventQueue, KeepsOrderAcrossWraps)
+{
+    EventQueue<int> queue(4);
+    int next = 0, expected = 0, value = 0;
+    for (int round = 0; round < 100; round++)
+    {
+        // Fill a varying amount so the head and tail wrap at every offset
+        for (int i = 0; i < round % 4 + 1; i++)
+            XGFX_CHECK(queue.push(next++));
+        while (queue.pop(value))
+            XGFX_CHECK(value == expected++);
+    }
+    XGFX_CHECK(expected == next);
+    XGFX_CHECK(!queue.pop(value));
+}
+
+XGFX_TEST(EventQueue, DeliversEveryProducersEvents)
+{
+    const int kProducers = 4;
+    const int kCount = 20000;
+    EventQueue<int> queue(64);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++)
+    {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < kCount; i++)
+                while (!queue.push(p * kCount + i))
+                    std::this_thread::yield();
+        });
+    }
+
+    // Each producer's events arrive in the order it pushed them
+    std::vector<int> next(kProducers, 0);
+    int received = 0, value = 0;
+    bool ordered = true;
+    while (received < kProducers * kCount)
+    {
+        if (!queue.pop(value))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        int p = value / kCount;
+        ordered = ordered && p < kProducers && value % kCount == next[p];
+        if (p < kProducers) next[p]++;
+        received++;
+    }
+    for (std::thread& producer : producers)
+        producer.join();
+    XGFX_CHECK(ordered);
+    XGFX_CHECK(!queue.pop(value));
+}
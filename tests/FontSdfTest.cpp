@@ -0,0 +1,61 @@
+#include "CrossWindow/ImGui/FontSdf.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace xgfx;
+
+XGFX_TEST(FontSdf, MatchesSquareDistances)
+{
+    // An odd texel count so the vector loop leaves a tail
+    const int w = 61, h = 63;
+    const int x0 = 20, y0 = 22, x1 = 40, y1 = 38;
+    const float spread = 4.0f;
+    std::vector<unsigned char> pixels(w * h, 0);
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++)
+            pixels[y * w + x] = 255;
+    buildDistanceField(pixels.data(), w, h, spread);
+
+    // Texel centers are compared against the exact distance to the square,
+    // allowing for the corners, where distances between centers round up
+    int worst = 0;
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            float cx = x + 0.5f, cy = y + 0.5f;
+            float dx = std::max(std::max(x0 - cx, cx - x1), 0.0f);
+            float dy = std::max(std::max(y0 - cy, cy - y1), 0.0f);
+            float d = dx > 0.0f || dy > 0.0f
+                          ? -std::sqrt(dx * dx + dy * dy)
+                          : std::min(std::min(cx - x0, x1 - cx),
+                                     std::min(cy - y0, y1 - cy));
+            float value = std::min(std::max(0.5f + d * 0.5f / spread, 0.0f),
+                                   1.0f) * 255.0f;
+            worst = std::max(worst, std::abs(pixels[y * w + x] -
+                                             (int)std::lround(value)));
+        }
+    }
+    XGFX_CHECK(worst <= 8);
+
+    // Along an edge the distance is exact, half a texel either side of it
+    XGFX_CHECK(pixels[30 * w + x0] == 143);
+    XGFX_CHECK(pixels[30 * w + x0 - 1] == 112);
+    XGFX_CHECK(pixels[30 * w + 30] == 255);
+    XGFX_CHECK(pixels[2 * w + 2] == 0);
+}
+
+XGFX_TEST(FontSdf, UsesCoverageOnEdges)
+{
+    const int w = 9, h = 1;
+    unsigned char pixels[w * h] = {0, 0, 0, 64, 192, 255, 255, 255, 255};
+    buildDistanceField(pixels, w, h, 4.0f);
+    // Partially covered texels sit within half a texel of the edge
+    XGFX_CHECK(pixels[3] == 120);
+    XGFX_CHECK(pixels[4] == 136);
+    XGFX_CHECK(pixels[2] < pixels[3] && pixels[4] < pixels[5]);
+}
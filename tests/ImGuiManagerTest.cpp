@@ -0,0 +1,192 @@
+#include "CrossWindow/ImGui/ImGuiManager.h"
+#include "Test.h"
+#include "imgui.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace xgfx;
+
+namespace
+{
+bool sameRect(const ImVec4& a, const ImVec4& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+// Exposes the culling pass to run on a frame without a backend.
+struct CullingManager : ImGuiManager
+{
+    void init() { create(); }
+
+    using ImGuiManager::compileRenderOps;
+    using ImGuiManager::cullOccludedCommands;
+    using ImGuiManager::frameStats;
+};
+
+// Every rect of every command of `list`, packed with its element count
+std::vector<float> snapshot(const ImDrawList* list)
+{
+    std::vector<float> values;
+    for (const ImDrawCmd& cmd : list->CmdBuffer)
+    {
+        values.push_back(cmd.ClipRect.x);
+        values.push_back(cmd.ClipRect.y);
+        values.push_back(cmd.ClipRect.z);
+        values.push_back(cmd.ClipRect.w);
+        values.push_back((float)cmd.ElemCount);
+    }
+    return values;
+}
+
+const ImDrawList* findList(const ImDrawData* drawData, const char* window)
+{
+    for (int n = 0; n < drawData->CmdListsCount; n++)
+    {
+        const char* owner = drawData->CmdLists[n]->_OwnerName;
+        if (owner && strcmp(owner, window) == 0) return drawData->CmdLists[n];
+    }
+    return nullptr;
+}
+}
+
+XGFX_TEST(ImGuiManager, TrimsClipRects)
+{
+    const ImVec4 clip(10.0f, 10.0f, 50.0f, 30.0f);
+
+    // Apart or only touching leaves the clip rect alone
+    ImVec4 trimmed = clip;
+    XGFX_CHECK(trimClipRect(trimmed, ImVec4(50.0f, 0.0f, 90.0f, 40.0f)));
+    XGFX_CHECK(sameRect(trimmed, clip));
+
+    trimmed = clip;
+    XGFX_CHECK(!trimClipRect(trimmed, ImVec4(10.0f, 10.0f, 50.0f, 30.0f)));
+    trimmed = clip;
+    XGFX_CHECK(!trimClipRect(trimmed, ImVec4(0.0f, 0.0f, 100.0f, 100.0f)));
+
+    // Spanning one axis cuts off the covered side
+    trimmed = clip;
+    XGFX_CHECK(trimClipRect(trimmed, ImVec4(0.0f, 0.0f, 60.0f, 15.0f)));
+    XGFX_CHECK(sameRect(trimmed, ImVec4(10.0f, 15.0f, 50.0f, 30.0f)));
+    trimmed = clip;
+    XGFX_CHECK(trimClipRect(trimmed, ImVec4(0.0f, 25.0f, 60.0f, 40.0f)));
+    XGFX_CHECK(sameRect(trimmed, ImVec4(10.0f, 10.0f, 50.0f, 25.0f)));
+    trimmed = clip;
+    XGFX_CHECK(trimClipRect(trimmed, ImVec4(0.0f, 0.0f, 20.0f, 40.0f)));
+    XGFX_CHECK(sameRect(trimmed, ImVec4(20.0f, 10.0f, 50.0f, 30.0f)));
+    trimmed = clip;
+    XGFX_CHECK(trimClipRect(trimmed, ImVec4(45.0f, 5.0f, 60.0f, 35.0f)));
+    XGFX_CHECK(sameRect(trimmed, ImVec4(10.0f, 10.0f, 45.0f, 30.0f)));
+
+    // A hole in the middle or a corner can't be cut out of a rectangle
+    trimmed = clip;
+    XGFX_CHECK(trimClipRect(trimmed, ImVec4(20.0f, 15.0f, 30.0f, 25.0f)));
+    XGFX_CHECK(sameRect(trimmed, clip));
+    trimmed = clip;
+    XGFX_CHECK(trimClipRect(trimmed, ImVec4(0.0f, 0.0f, 20.0f, 20.0f)));
+    XGFX_CHECK(sameRect(trimmed, clip));
+    trimmed = clip;
+    XGFX_CHECK(trimClipRect(trimmed, ImVec4(20.0f, 0.0f, 30.0f, 40.0f)));
+    XGFX_CHECK(sameRect(trimmed, clip));
+}
+
+XGFX_TEST(ImGuiManager, CullsOccludedCommands)
+{
+    CullingManager manager;
+    manager.init();
+    manager.setOcclusionCulling(true);
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2(400.0f, 300.0f);
+    io.DeltaTime = 1.0f / 60.0f;
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    // Opaque square windows, so each one covers its whole rect
+    ImGuiStyle& style = ImGui::GetStyle();
+    style.WindowRounding = 0.0f;
+    style.Colors[ImGuiCol_WindowBg].w = 1.0f;
+
+    // "Front" is drawn last, over all of "Behind" and the left of "Side"
+    ImDrawData* drawData = nullptr;
+    for (int frame = 0; frame < 2; frame++)
+    {
+        manager.beginFrame();
+        const char* names[] = {"Behind", "Side", "Front"};
+        const ImVec2 positions[] = {ImVec2(20.0f, 20.0f), ImVec2(150.0f, 40.0f),
+                                    ImVec2(0.0f, 0.0f)};
+        const ImVec2 sizes[] = {ImVec2(100.0f, 100.0f), ImVec2(150.0f, 100.0f),
+                                ImVec2(200.0f, 200.0f)};
+        for (int w = 0; w < 3; w++)
+        {
+            ImGui::SetNextWindowPos(positions[w]);
+            ImGui::SetNextWindowSize(sizes[w]);
+            ImGui::Begin(names[w], nullptr, ImGuiWindowFlags_NoSavedSettings);
+            ImGui::TextUnformatted(names[w]);
+            ImGui::End();
+        }
+        ImGui::Render();
+        drawData = ImGui::GetDrawData();
+    }
+
+    const ImDrawList* behind = findList(drawData, "Behind");
+    const ImDrawList* side = findList(drawData, "Side");
+    const ImDrawList* front = findList(drawData, "Front");
+    if (!XGFX_CHECK(behind && side && front)) return;
+    std::vector<float> before[3] = {snapshot(behind), snapshot(side),
+                                    snapshot(front)};
+    manager.cullOccludedCommands(drawData);
+    std::vector<ImGuiRenderOp> ops;
+    manager.compileRenderOps(drawData, ops);
+
+    // The results only show in the compiled ops
+    XGFX_CHECK(snapshot(behind) == before[0]);
+    XGFX_CHECK(snapshot(side) == before[1]);
+    XGFX_CHECK(snapshot(front) == before[2]);
+    XGFX_CHECK(manager.frameStats.drawsOccluded >= 1);
+
+    bool hidden = true, trimmed = true, drawn = false, shown = false;
+    for (const ImGuiRenderOp& op : ops)
+    {
+        if (op.type != ImGuiRenderOp::Draw) continue;
+        hidden = hidden && op.list != behind;
+        if (op.list == side)
+        {
+            trimmed = trimmed && op.scissor[0] >= 200;
+            drawn = true;
+        }
+        shown = shown || op.list == front;
+    }
+    XGFX_CHECK(hidden);
+    XGFX_CHECK(trimmed && drawn);
+    XGFX_CHECK(shown);
+}
+
+XGFX_TEST(ImGuiManager, SizesBuffers)
+{
+    ImGuiBufferSizer sizer;
+    XGFX_CHECK(sizer.update(10) && sizer.capacity == 1024);
+    XGFX_CHECK(!sizer.update(1024));
+    XGFX_CHECK(sizer.update(1025) && sizer.capacity == 2048);
+    XGFX_CHECK(sizer.update(100000) && sizer.capacity == 131072);
+
+    // A spike is released once usage has stayed low long enough, down to
+    // the class of the peak seen meanwhile
+    bool shrunk = false;
+    int frames = 0;
+    for (; frames < ImGuiBufferSizer::kShrinkFrames && !shrunk; frames++)
+        shrunk = sizer.update(frames == 10 ? 5000 : 3000);
+    XGFX_CHECK(shrunk);
+    XGFX_CHECK(frames == ImGuiBufferSizer::kShrinkFrames);
+    XGFX_CHECK(sizer.capacity == 8192);
+
+    // Usage near a quarter of the capacity keeps it
+    for (int i = 0; i < ImGuiBufferSizer::kShrinkFrames * 2; i++)
+        XGFX_CHECK(!sizer.update(i % 2 ? 2048 : 1500));
+    XGFX_CHECK(sizer.capacity == 8192);
+
+    sizer.reset();
+    XGFX_CHECK(sizer.capacity == 0);
+    XGFX_CHECK(sizer.update(0) && sizer.capacity == 1024);
+}
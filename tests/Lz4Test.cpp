@@ -0,0 +1,103 @@
+#include "CrossWindow/ImGui/Lz4.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace xgfx;
+
+namespace
+{
+// Compress `data` and decompress it again, checking it survived.
+bool roundTrip(const std::vector<uint8_t>& data, size_t* compressedSize)
+{
+    std::vector<uint8_t> compressed(lz4::compressBound(data.size()));
+    size_t size = lz4::compress(data.data(), data.size(), compressed.data());
+    if (!XGFX_CHECK(size <= compressed.size())) return false;
+    if (compressedSize) *compressedSize = size;
+
+    std::vector<uint8_t> out(data.size() + 1, 0xcd);
+    bool ok = lz4::decompress(compressed.data(), size, out.data(),
+                              data.size());
+    return XGFX_CHECK(ok) &&
+           XGFX_CHECK(std::equal(data.begin(), data.end(), out.begin())) &&
+           XGFX_CHECK(out[data.size()] == 0xcd);
+}
+
+std::vector<uint8_t> noise(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        data[i] = static_cast<uint8_t>(seed >> 24);
+    }
+    return data;
+}
+}
+
+XGFX_TEST(Lz4, RoundTripsShortInputs)
+{
+    // Inputs shorter than the end of block rules are all literals
+    for (size_t size = 0; size < 32; size++)
+        roundTrip(std::vector<uint8_t>(size, 'a'), nullptr);
+}
+
+XGFX_TEST(Lz4, RoundTripsNoise)
+{
+    size_t size = 0;
+    std::vector<uint8_t> data = noise(100000, 1);
+    if (roundTrip(data, &size)) XGFX_CHECK(size >= data.size());
+}
+
+XGFX_TEST(Lz4, CompressesRepeats)
+{
+    // Long runs, matches overlapping their own output and matches further
+    // back than the 64KB window
+    std::vector<uint8_t> data(300000, 0);
+    std::vector<uint8_t> block = noise(4096, 2);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = i < 100000 ? block[i % block.size()]
+                  : i < 200000 ? static_cast<uint8_t>(i % 3)
+                               : data[i - 150000];
+    size_t size = 0;
+    if (roundTrip(data, &size)) XGFX_CHECK(size < data.size() / 10);
+}
+
+XGFX_TEST(Lz4, RejectsMalformedBlocks)
+{
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<uint8_t>(i % 7 + (i / 100));
+    std::vector<uint8_t> compressed(lz4::compressBound(data.size()));
+    size_t size = lz4::compress(data.data(), data.size(), compressed.data());
+    std::vector<uint8_t> out(data.size());
+
+    // Every truncation, and a block expanding to more or fewer bytes than
+    // asked for
+    for (size_t cut = 0; cut < size; cut++)
+        XGFX_CHECK(!lz4::decompress(compressed.data(), cut, out.data(),
+                                    out.size()));
+    XGFX_CHECK(!lz4::decompress(compressed.data(), size, out.data(),
+                                out.size() - 1));
+    std::vector<uint8_t> bigger(data.size() + 1);
+    XGFX_CHECK(!lz4::decompress(compressed.data(), size, bigger.data(),
+                                bigger.size()));
+
+    // A match reaching back before the start of the output
+    const uint8_t before[] = {0x14, 'a', 0x10, 0x00, 0x50, 'b', 'c',
+                              'd',  'e', 'f'};
+    std::vector<uint8_t> small(14);
+    XGFX_CHECK(!lz4::decompress(before, sizeof(before), small.data(),
+                                small.size()));
+
+    // Flipped bytes may still decode, but must never overrun
+    for (size_t i = 0; i < size; i++)
+    {
+        std::vector<uint8_t> flipped(compressed.begin(),
+                                     compressed.begin() + size);
+        flipped[i] ^= 0xff;
+        lz4::decompress(flipped.data(), flipped.size(), out.data(),
+                        out.size());
+    }
+}
@@ -0,0 +1,82 @@
+#include "Test.h"
+
+#include <cstring>
+
+namespace xgfx
+{
+namespace test
+{
+namespace
+{
+TestCase* gTests = nullptr;
+TestCase** gLast = &gTests;
+int gFailures = 0;
+const char* gSkipped = nullptr;
+}
+
+Registrar::Registrar(TestCase& test)
+{
+    // Appended so each file's tests run in the order they are defined
+    *gLast = &test;
+    gLast = &test.next;
+}
+
+bool check(bool ok, const char* expr, const char* file, int line)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+        gFailures++;
+    }
+    return ok;
+}
+
+void skip(const char* reason) { gSkipped = reason; }
+
+// A filter is either a suite or a single `Suite.Name` test
+bool matches(const char* filter, const TestCase& test)
+{
+    size_t suiteLength = strlen(test.suite);
+    if (strncmp(filter, test.suite, suiteLength) != 0) return false;
+    const char* rest = filter + suiteLength;
+    return *rest == 0 || (*rest == '.' && strcmp(rest + 1, test.name) == 0);
+}
+}
+}
+
+int main(int argc, char** argv)
+{
+    using namespace xgfx::test;
+    int failed = 0, run = 0, skipped = 0;
+    for (TestCase* test = gTests; test; test = test->next)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; i++)
+            selected = matches(argv[i], *test);
+        if (!selected) continue;
+
+        int before = gFailures;
+        gSkipped = nullptr;
+        test->run();
+        run++;
+        if (gFailures != before)
+        {
+            failed++;
+            printf("FAIL %s.%s\n", test->suite, test->name);
+        }
+        else if (gSkipped)
+        {
+            skipped++;
+            printf("skip %s.%s: %s\n", test->suite, test->name, gSkipped);
+        }
+        else
+        {
+            printf("ok   %s.%s\n", test->suite, test->name);
+        }
+    }
+    printf("%d of %d tests passed, %d skipped\n", run - failed - skipped, run,
+           skipped);
+    if (run == 0) fprintf(stderr, "ERROR: No tests matched!\n");
+    if (run == 0 || failed > 0) return 1;
+    return skipped == run ? kSkipped : 0;
+}
@@ -0,0 +1,374 @@
+#include "CrossWindow/ImGui/Capture.h"
+#include "CrossWindow/ImGui/OpenGL.h"
+#include "Png.h"
+#include "Scenes.h"
+#include "Test.h"
+#include "imgui.h"
+
+#include <EGL/egl.h>
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace xgfx;
+using namespace xgfx::test;
+
+namespace
+{
+const int kWidth = 128;
+const int kHeight = 96;
+
+// An offscreen OpenGL 3.3 core context. ctest picks Mesa's surfaceless
+// platform and llvmpipe, so the output doesn't depend on the machine's GPU.
+class GLContext
+{
+  public:
+    ~GLContext()
+    {
+        if (mDisplay == EGL_NO_DISPLAY) return;
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                       EGL_NO_CONTEXT);
+        if (mContext != EGL_NO_CONTEXT) eglDestroyContext(mDisplay, mContext);
+        if (mSurface != EGL_NO_SURFACE) eglDestroySurface(mDisplay, mSurface);
+        eglTerminate(mDisplay);
+    }
+
+    bool create()
+    {
+        mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (mDisplay == EGL_NO_DISPLAY || !eglInitialize(mDisplay, 0, 0))
+        {
+            mDisplay = EGL_NO_DISPLAY;
+            return false;
+        }
+        const EGLint configAttribs[] = {EGL_SURFACE_TYPE,
+                                        EGL_PBUFFER_BIT,
+                                        EGL_RENDERABLE_TYPE,
+                                        EGL_OPENGL_BIT,
+                                        EGL_RED_SIZE,
+                                        8,
+                                        EGL_NONE};
+        EGLConfig config;
+        EGLint configs = 0;
+        if (!eglChooseConfig(mDisplay, configAttribs, &config, 1, &configs) ||
+            configs < 1 || !eglBindAPI(EGL_OPENGL_API))
+            return false;
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK,
+            EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+        mContext =
+            eglCreateContext(mDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+        const EGLint surfaceAttribs[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16,
+                                         EGL_NONE};
+        mSurface = eglCreatePbufferSurface(mDisplay, config, surfaceAttribs);
+        if (mContext == EGL_NO_CONTEXT || mSurface == EGL_NO_SURFACE ||
+            !eglMakeCurrent(mDisplay, mSurface, mSurface, mContext))
+            return false;
+#if defined(GLAD_GL_H_)
+        return gladLoadGL((GLADloadfunc)eglGetProcAddress) != 0;
+#else
+        return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+#endif
+    }
+
+  private:
+    EGLDisplay mDisplay = EGL_NO_DISPLAY;
+    EGLContext mContext = EGL_NO_CONTEXT;
+    EGLSurface mSurface = EGL_NO_SURFACE;
+};
+
+// A color texture to render into, read back top row first.
+class Framebuffer
+{
+  public:
+    ~Framebuffer()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &mFramebuffer);
+        glDeleteTextures(1, &mTexture);
+    }
+
+    bool create(int width, int height)
+    {
+        mWidth = width;
+        mHeight = height;
+        glGenTextures(1, &mTexture);
+        glBindTexture(GL_TEXTURE_2D, mTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+        glGenFramebuffers(1, &mFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, mTexture, 0);
+        return glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+               GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    void clear()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glViewport(0, 0, mWidth, mHeight);
+        glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    void read(Image& image)
+    {
+        image.width = mWidth;
+        image.height = mHeight;
+        image.pixels.resize((size_t)mWidth * mHeight * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                     image.pixels.data());
+        // Alpha is whatever blending left, which a window shows as opaque
+        for (size_t i = 3; i < image.pixels.size(); i += 4)
+            image.pixels[i] = 255;
+        // GL rows start at the bottom
+        const size_t stride = (size_t)mWidth * 4;
+        for (int y = 0; y < mHeight / 2; y++)
+            std::swap_ranges(&image.pixels[stride * y],
+                             &image.pixels[stride * (y + 1)],
+                             &image.pixels[stride * (mHeight - 1 - y)]);
+    }
+
+  private:
+    int mWidth = 0, mHeight = 0;
+    GLuint mFramebuffer = 0, mTexture = 0;
+};
+
+// A texture filtered like the manager's own, for the golden image.
+GLuint createTexture(int width, int height, const uint8_t* pixels)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, pixels);
+    return texture;
+}
+
+// A quad on whole pixels, so no edge depends on the rasterizer's tie
+// breaking. Colors are given per corner, clockwise from the top left.
+void addQuad(ImDrawList& list, float x0, float y0, float x1, float y1,
+             const ImU32 (&cols)[4], const ImVec2& uv0, const ImVec2& uv1)
+{
+    ImDrawIdx base = (ImDrawIdx)list.VtxBuffer.Size;
+    const ImVec2 pos[] = {ImVec2(x0, y0), ImVec2(x1, y0), ImVec2(x1, y1),
+                          ImVec2(x0, y1)};
+    const ImVec2 uv[] = {uv0, ImVec2(uv1.x, uv0.y), uv1,
+                         ImVec2(uv0.x, uv1.y)};
+    for (int i = 0; i < 4; i++)
+    {
+        ImDrawVert v;
+        v.pos = pos[i];
+        v.uv = uv[i];
+        v.col = cols[i];
+        list.VtxBuffer.push_back(v);
+    }
+    const int order[] = {0, 1, 2, 0, 2, 3};
+    for (int i = 0; i < 6; i++)
+        list.IdxBuffer.push_back((ImDrawIdx)(base + order[i]));
+}
+
+void addCommand(ImDrawList& list, ImTextureID texture, const ImVec4& clip,
+                unsigned quads)
+{
+    ImDrawCmd cmd = ImDrawCmd();
+    cmd.ClipRect = clip;
+    cmd.TextureId = texture;
+    for (const ImDrawCmd& previous : list.CmdBuffer)
+        cmd.IdxOffset += previous.ElemCount;
+    cmd.ElemCount = quads * 6;
+    list.CmdBuffer.push_back(cmd);
+}
+
+std::string goldenPath(const char* name)
+{
+    return std::string(XGFX_GOLDEN_DIR) + "/" + name + ".png";
+}
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    uint8_t buf[4096];
+    size_t read = 0;
+    while ((read = std::fread(buf, 1, sizeof(buf), file)) > 0)
+        data.insert(data.end(), buf, buf + read);
+    std::fclose(file);
+    return true;
+}
+
+// Compare `image` against the reference named `name`, allowing `tolerance`
+// per channel for drivers filtering or blending slightly differently. With
+// XGFX_UPDATE_GOLDEN set the reference is rewritten instead, and on a
+// mismatch the rendered image is written next to the test for inspection.
+void checkGolden(const char* name, const Image& image, int tolerance)
+{
+    const std::string path = goldenPath(name);
+    if (std::getenv("XGFX_UPDATE_GOLDEN"))
+    {
+        XGFX_CHECK(writePng(path.c_str(), image));
+        return;
+    }
+
+    std::vector<uint8_t> png;
+    Image golden;
+    if (!XGFX_CHECK(readFile(path, png)) || !decodePng(png, golden)) return;
+    if (!XGFX_CHECK(golden.width == image.width &&
+                    golden.height == image.height))
+        return;
+    int worst = 0;
+    size_t differing = 0;
+    for (size_t i = 0; i < image.pixels.size(); i++)
+    {
+        int diff = std::abs(image.pixels[i] - golden.pixels[i]);
+        worst = std::max(worst, diff);
+        differing += diff > tolerance;
+    }
+    if (!XGFX_CHECK(differing == 0))
+    {
+        std::string actual = std::string(name) + ".actual.png";
+        writePng(actual.c_str(), image);
+        fprintf(stderr, "%zu channels differ from %s by up to %d, see %s\n",
+                differing, path.c_str(), worst, actual.c_str());
+    }
+}
+}
+
+XGFX_TEST(OpenGL, MatchesGoldenImage)
+{
+    GLContext gl;
+    if (!gl.create())
+    {
+        skip("no OpenGL 3.3 context through EGL");
+        return;
+    }
+    Framebuffer target;
+    if (!XGFX_CHECK(target.create(kWidth, kHeight))) return;
+
+    // Declared after the context, so its GL objects go first
+    OpenGLImGuiManager manager;
+    manager.init();
+    if (!XGFX_CHECK(manager.createDeviceObjects())) return;
+    manager.makeCurrent();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2((float)kWidth, (float)kHeight);
+    io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
+    target.clear();
+
+    // A white texel for flat colors and a 4x4 checker, magnified so linear
+    // filtering shows
+    const uint8_t whitePixel[4] = {255, 255, 255, 255};
+    GLuint whiteTexture = createTexture(1, 1, whitePixel);
+    uint8_t checkerPixels[4 * 4 * 4];
+    for (int i = 0; i < 16; i++)
+    {
+        bool on = ((i % 4) + (i / 4)) % 2 != 0;
+        uint8_t* p = &checkerPixels[i * 4];
+        p[0] = on ? 240 : 30;
+        p[1] = on ? 200 : 30;
+        p[2] = on ? 40 : 90;
+        p[3] = 255;
+    }
+    GLuint checkerTexture = createTexture(4, 4, checkerPixels);
+    ImTextureID white = (ImTextureID)(intptr_t)whiteTexture;
+    ImTextureID checker = (ImTextureID)(intptr_t)checkerTexture;
+
+    const ImVec4 full(0.0f, 0.0f, (float)kWidth, (float)kHeight);
+    const ImU32 red[] = {0xff2020e0, 0xff2020e0, 0xff2020e0, 0xff2020e0};
+    const ImU32 green[] = {0x8020e020, 0x8020e020, 0x8020e020, 0x8020e020};
+    const ImU32 gradient[] = {0xffffffff, 0xffffffff, 0xff800000,
+                              0xff800000};
+    const ImU32 blue[] = {0xffe08020, 0xffe08020, 0xffe08020, 0xffe08020};
+    const ImU32 opaque[] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+    const ImVec2 center(0.5f, 0.5f);
+
+    ImDrawList list(ImGui::GetDrawListSharedData());
+    list._OwnerName = "Golden";
+    // A flat quad, a translucent one blended over it and a vertical color
+    // gradient, in one command
+    addQuad(list, 8.0f, 8.0f, 56.0f, 56.0f, red, center, center);
+    addQuad(list, 32.0f, 32.0f, 88.0f, 80.0f, green, center, center);
+    addQuad(list, 8.0f, 64.0f, 24.0f, 88.0f, gradient, center, center);
+    addCommand(list, white, full, 3);
+    // The checker, then a quad scissored to part of itself
+    addQuad(list, 72.0f, 8.0f, 120.0f, 56.0f, opaque, ImVec2(0.0f, 0.0f),
+            ImVec2(1.0f, 1.0f));
+    addCommand(list, checker, full, 1);
+    addQuad(list, 96.0f, 60.0f, 124.0f, 92.0f, blue, center, center);
+    addCommand(list, white, ImVec4(100.0f, 70.0f, 116.0f, 84.0f), 1);
+
+    ImDrawData drawData;
+    drawData.Valid = true;
+    drawData.CmdListsCount = 1;
+#if IMGUI_VERSION_NUM >= 18973
+    drawData.CmdLists.push_back(&list);
+#else
+    ImDrawList* lists[] = {&list};
+    drawData.CmdLists = lists;
+#endif
+    drawData.TotalVtxCount = list.VtxBuffer.Size;
+    drawData.TotalIdxCount = list.IdxBuffer.Size;
+    drawData.DisplayPos = ImVec2(0.0f, 0.0f);
+    drawData.DisplaySize = io.DisplaySize;
+    drawData.FramebufferScale = ImVec2(1.0f, 1.0f);
+
+    CaptureImage captured;
+    manager.captureFrame(
+        [&captured](CaptureImage& image) { captured = std::move(image); });
+    manager.renderDrawData(&drawData);
+    manager.flushCaptures();
+    XGFX_CHECK(glGetError() == GL_NO_ERROR);
+    XGFX_CHECK(manager.getFrameStats().drawCalls == 3);
+
+    Image rendered;
+    target.read(rendered);
+    checkGolden("OpenGL", rendered, 8);
+
+    // The asynchronous capture sees the same pixels
+    XGFX_CHECK(captured.width == kWidth && captured.height == kHeight);
+    XGFX_CHECK(captured.pixels == rendered.pixels);
+
+    glDeleteTextures(1, &whiteTexture);
+    glDeleteTextures(1, &checkerTexture);
+}
+
+XGFX_TEST(OpenGL, StaysWithinSceneBudgets)
+{
+    GLContext gl;
+    if (!gl.create())
+    {
+        skip("no OpenGL 3.3 context through EGL");
+        return;
+    }
+    Framebuffer target;
+    if (!XGFX_CHECK(target.create(kSceneWidth, kSceneHeight))) return;
+
+    // A fresh context per scene, so no window state carries over
+    for (int i = 0; i < kSceneCount; i++)
+    {
+        OpenGLImGuiManager manager;
+        manager.init();
+        manager.setAnalyticShapes(true);
+        if (!XGFX_CHECK(manager.createDeviceObjects())) return;
+        runScene(manager, kScenes[i], [&](ImDrawData* drawData) {
+            target.clear();
+            manager.renderDrawData(drawData);
+        });
+        XGFX_CHECK(glGetError() == GL_NO_ERROR);
+    }
+}
+
@@ -0,0 +1,65 @@
+#include "CrossWindow/ImGui/Pixels.h"
+#include "Test.h"
+
+#include <vector>
+
+using namespace xgfx;
+
+namespace
+{
+uint8_t premultiplied(uint8_t c, uint8_t a) { return (c * a * 2 + 255) / 510; }
+}
+
+XGFX_TEST(Pixels, MatchesScalarReference)
+{
+    // Every color and alpha pair, at counts exercising the vector loop and
+    // its scalar tail
+    std::vector<uint8_t> src(256 * 256 * 4);
+    for (int a = 0; a < 256; a++)
+    {
+        for (int c = 0; c < 256; c++)
+        {
+            uint8_t* p = &src[(a * 256 + c) * 4];
+            p[0] = (uint8_t)c;
+            p[1] = (uint8_t)(255 - c);
+            p[2] = (uint8_t)(c ^ 0x5a);
+            p[3] = (uint8_t)a;
+        }
+    }
+    for (size_t count : {size_t(1), size_t(7), size_t(256 * 256)})
+    {
+        for (int bgra = 0; bgra < 2; bgra++)
+        {
+            PixelFormat format = bgra ? PixelFormat::BGRA8 : PixelFormat::RGBA8;
+            for (int premultiply = 0; premultiply < 2; premultiply++)
+            {
+                std::vector<uint8_t> dst(count * 4);
+                convertPixels(src.data(), dst.data(), count, format,
+                              premultiply != 0);
+                int mismatches = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    const uint8_t* s = &src[i * 4];
+                    uint8_t r = bgra ? s[2] : s[0], b = bgra ? s[0] : s[2];
+                    uint8_t rgba[4] = {r, s[1], b, s[3]};
+                    for (int ch = 0; ch < 3 && premultiply; ch++)
+                        rgba[ch] = premultiplied(rgba[ch], s[3]);
+                    for (int ch = 0; ch < 4; ch++)
+                        mismatches += dst[i * 4 + ch] != rgba[ch];
+                }
+                XGFX_CHECK(mismatches == 0);
+            }
+        }
+    }
+}
+
+XGFX_TEST(Pixels, ConvertsInPlace)
+{
+    std::vector<uint8_t> pixels(9 * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (uint8_t)(i * 29 + 3);
+    std::vector<uint8_t> expected(pixels.size());
+    convertPixels(pixels.data(), expected.data(), 9, PixelFormat::BGRA8, true);
+    convertPixels(pixels.data(), pixels.data(), 9, PixelFormat::BGRA8, true);
+    XGFX_CHECK(pixels == expected);
+}
@@ -0,0 +1,107 @@
+#include "CrossWindow/ImGui/Plot.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace xgfx;
+
+namespace
+{
+std::vector<float> wave(size_t count)
+{
+    std::vector<float> values(count);
+    for (size_t i = 0; i < count; i++)
+        values[i] = std::sin(i * 0.01f) * 10.0f + (i % 13 == 0 ? 3.0f : 0.0f);
+    return values;
+}
+}
+
+XGFX_TEST(Plot, DecimatesToBucketRanges)
+{
+    const size_t count = 100000;
+    std::vector<float> values = wave(count);
+    PlotSeries series;
+    series.append(values.data(), values.size());
+    XGFX_CHECK(series.size() == count);
+
+    // Each bucket covers at least its own samples, and no more than the
+    // pyramid blocks overlapping it
+    const int columns = 37;
+    const double first = 1234.5, last = 98765.25;
+    std::vector<float> mins(columns), maxs(columns);
+    series.decimate(first, last, columns, mins.data(), maxs.data());
+    const double step = (last - first) / columns;
+    int wrong = 0;
+    for (int c = 0; c < columns; c++)
+    {
+        size_t s0 = (size_t)(first + step * c);
+        size_t s1 = (size_t)std::ceil(first + step * (c + 1));
+        float lo = *std::min_element(&values[s0], &values[s1]);
+        float hi = *std::max_element(&values[s0], &values[s1]);
+        // Blocks are at most half a bucket wide
+        size_t slack = (s1 - s0) / 2 + 1;
+        size_t w0 = s0 > slack ? s0 - slack : 0;
+        size_t w1 = std::min(s1 + slack, count);
+        float wlo = *std::min_element(&values[w0], &values[w1]);
+        float whi = *std::max_element(&values[w0], &values[w1]);
+        wrong += !(mins[c] <= lo && maxs[c] >= hi && mins[c] >= wlo &&
+                   maxs[c] <= whi);
+    }
+    XGFX_CHECK(wrong == 0);
+}
+
+XGFX_TEST(Plot, DecimatesExactlyWhenZoomedIn)
+{
+    std::vector<float> values = wave(1000);
+    PlotSeries series;
+    series.append(values.data(), values.size());
+
+    // Fewer than two blocks of the finest level per bucket read the samples
+    const int columns = 100;
+    std::vector<float> mins(columns), maxs(columns);
+    series.decimate(200.0, 1200.0, columns, mins.data(), maxs.data());
+    int wrong = 0;
+    for (int c = 0; c < 80; c++)
+    {
+        const float* s = &values[200 + c * 10];
+        wrong += mins[c] != *std::min_element(s, s + 10) ||
+                 maxs[c] != *std::max_element(s, s + 10);
+    }
+    XGFX_CHECK(wrong == 0);
+
+    // Buckets past the end are empty
+    bool empty = true;
+    for (int c = 80; c < columns; c++)
+        empty = empty && mins[c] > maxs[c];
+    XGFX_CHECK(empty);
+}
+
+XGFX_TEST(Plot, AppendsMatchBulkAppend)
+{
+    std::vector<float> values = wave(40000);
+    PlotSeries bulk, streamed;
+    bulk.append(values.data(), values.size());
+    for (size_t i = 0; i < values.size();)
+    {
+        // Uneven batches end partway through blocks of every level
+        size_t batch = std::min<size_t>(1 + i % 777, values.size() - i);
+        if (batch == 1)
+            streamed.append(values[i]);
+        else
+            streamed.append(&values[i], batch);
+        i += batch;
+    }
+
+    const int columns = 64;
+    std::vector<float> a(columns * 2), b(columns * 2);
+    bulk.decimate(0.0, 40000.0, columns, a.data(), a.data() + columns);
+    streamed.decimate(0.0, 40000.0, columns, b.data(), b.data() + columns);
+    XGFX_CHECK(a == b);
+
+    streamed.clear();
+    XGFX_CHECK(streamed.size() == 0);
+    streamed.decimate(0.0, 10.0, 4, b.data(), b.data() + 4);
+    XGFX_CHECK(b[0] > b[4]);
+}
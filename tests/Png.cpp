@@ -0,0 +1,277 @@
+#include "Png.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace xgfx
+{
+namespace test
+{
+namespace
+{
+uint32_t readBigEndian(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+           p[3];
+}
+
+void writeBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((uint8_t)(value >> shift));
+}
+
+uint32_t crc32(const uint8_t* data, size_t size)
+{
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+uint32_t adler32(const uint8_t* data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return b << 16 | a;
+}
+
+void writeChunk(std::vector<uint8_t>& out, const char* type,
+                const std::vector<uint8_t>& body)
+{
+    writeBigEndian(out, (uint32_t)body.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), body.begin(), body.end());
+    writeBigEndian(out, crc32(&out[start], out.size() - start));
+}
+
+// Just enough inflate for stored and fixed Huffman blocks, decoding
+// canonical codes a bit at a time.
+struct Inflater
+{
+    const uint8_t* data;
+    size_t size;
+    size_t bit = 0;
+    bool ok = true;
+
+    unsigned bits(int count)
+    {
+        unsigned value = 0;
+        for (int i = 0; i < count; i++, bit++)
+        {
+            if (bit / 8 >= size)
+            {
+                ok = false;
+                return 0;
+            }
+            value |= ((data[bit / 8] >> (bit % 8)) & 1u) << i;
+        }
+        return value;
+    }
+
+    // Symbols of a canonical code given each one's length
+    int decode(const int* lengths, int symbols)
+    {
+        int code = 0, first = 0;
+        for (int len = 1; len <= 15 && ok; len++)
+        {
+            code |= (int)bits(1);
+            int count = 0;
+            for (int s = 0; s < symbols; s++)
+                count += lengths[s] == len;
+            if (code - first < count)
+            {
+                for (int s = 0, n = 0; s < symbols; s++)
+                    if (lengths[s] == len && n++ == code - first) return s;
+            }
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        ok = false;
+        return -1;
+    }
+
+    bool inflate(std::vector<uint8_t>& out)
+    {
+        static const int lengthBase[29] = {
+            3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+            31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                            1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                            4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const int distBase[30] = {
+            1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+            33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+            1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        int litLengths[288], distLengths[30];
+        for (int s = 0; s < 288; s++)
+            litLengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+        for (int s = 0; s < 30; s++)
+            distLengths[s] = 5;
+
+        bool last = false;
+        while (!last && ok)
+        {
+            last = bits(1) != 0;
+            unsigned type = bits(2);
+            if (type == 0)
+            {
+                bit = (bit + 7) & ~size_t(7);
+                unsigned len = bits(16), nlen = bits(16);
+                if (!ok || (len ^ 0xffff) != nlen || bit / 8 + len > size)
+                    return false;
+                out.insert(out.end(), data + bit / 8, data + bit / 8 + len);
+                bit += len * 8;
+            }
+            else if (type == 1)
+            {
+                for (;;)
+                {
+                    int sym = decode(litLengths, 288);
+                    if (!ok || sym > 285) return false;
+                    if (sym < 256)
+                    {
+                        out.push_back((uint8_t)sym);
+                        continue;
+                    }
+                    if (sym == 256) break;
+                    sym -= 257;
+                    size_t len = lengthBase[sym] + bits(lengthExtra[sym]);
+                    int d = decode(distLengths, 30);
+                    if (!ok || d > 29) return false;
+                    size_t dist = distBase[d] + bits(d < 4 ? 0 : d / 2 - 1);
+                    if (!ok || dist > out.size()) return false;
+                    for (size_t i = 0; i < len; i++)
+                        out.push_back(out[out.size() - dist]);
+                }
+            }
+            else
+            {
+                return false;
+            }
+        }
+        bit = (bit + 7) & ~size_t(7);
+        return ok;
+    }
+};
+}
+
+bool decodePng(const std::vector<uint8_t>& png, Image& image)
+{
+    static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    if (!XGFX_CHECK(png.size() > 8 && memcmp(png.data(), signature, 8) == 0))
+        return false;
+    std::vector<uint8_t> zlib;
+    bool ended = false;
+    for (size_t p = 8; p < png.size() && !ended;)
+    {
+        if (!XGFX_CHECK(p + 12 <= png.size())) return false;
+        uint32_t length = readBigEndian(&png[p]);
+        if (!XGFX_CHECK(p + 12 + length <= png.size())) return false;
+        const uint8_t* type = &png[p + 4];
+        const uint8_t* body = type + 4;
+        if (!XGFX_CHECK(crc32(type, length + 4) ==
+                        readBigEndian(body + length)))
+            return false;
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            XGFX_CHECK(length == 13);
+            image.width = (int)readBigEndian(body);
+            image.height = (int)readBigEndian(body + 4);
+            // 8 bits per channel RGBA, no interlacing
+            XGFX_CHECK(body[8] == 8 && body[9] == 6 && body[12] == 0);
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            zlib.insert(zlib.end(), body, body + length);
+        }
+        ended = memcmp(type, "IEND", 4) == 0;
+        p += 12 + length;
+    }
+    if (!XGFX_CHECK(ended && zlib.size() >= 6)) return false;
+    XGFX_CHECK((zlib[0] * 256 + zlib[1]) % 31 == 0 && (zlib[0] & 0xf) == 8);
+
+    Inflater inflater = {zlib.data() + 2, zlib.size() - 2};
+    std::vector<uint8_t> raw;
+    if (!XGFX_CHECK(inflater.inflate(raw))) return false;
+    if (!XGFX_CHECK(inflater.bit / 8 + 4 <= inflater.size)) return false;
+    XGFX_CHECK(readBigEndian(inflater.data + inflater.bit / 8) ==
+               adler32(raw.data(), raw.size()));
+
+    const size_t stride = (size_t)image.width * 4;
+    if (!XGFX_CHECK(raw.size() == (stride + 1) * image.height)) return false;
+    image.pixels.resize(stride * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        const uint8_t* row = &raw[(stride + 1) * y];
+        uint8_t* dst = &image.pixels[stride * y];
+        if (!XGFX_CHECK(row[0] <= 1)) return false;
+        for (size_t i = 0; i < stride; i++)
+            dst[i] = row[1 + i] + (row[0] == 1 && i >= 4 ? dst[i - 4] : 0);
+    }
+    return true;
+}
+
+void encodePng(const Image& image, std::vector<uint8_t>& png)
+{
+    static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    png.assign(signature, signature + 8);
+
+    std::vector<uint8_t> header;
+    writeBigEndian(header, (uint32_t)image.width);
+    writeBigEndian(header, (uint32_t)image.height);
+    const uint8_t format[] = {8, 6, 0, 0, 0};
+    header.insert(header.end(), format, format + 5);
+    writeChunk(png, "IHDR", header);
+
+    // Every row unfiltered, in stored blocks of at most 65535 bytes
+    const size_t stride = (size_t)image.width * 4;
+    std::vector<uint8_t> raw;
+    raw.reserve((stride + 1) * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        raw.push_back(0);
+        const uint8_t* row = &image.pixels[stride * y];
+        raw.insert(raw.end(), row, row + stride);
+    }
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    size_t offset = 0;
+    do
+    {
+        size_t len = std::min(raw.size() - offset, size_t(65535));
+        zlib.push_back(offset + len == raw.size() ? 1 : 0);
+        const uint8_t lengths[] = {
+            (uint8_t)len, (uint8_t)(len >> 8), (uint8_t)~len,
+            (uint8_t)(~len >> 8)};
+        zlib.insert(zlib.end(), lengths, lengths + 4);
+        zlib.insert(zlib.end(), raw.begin() + offset,
+                    raw.begin() + offset + len);
+        offset += len;
+    } while (offset < raw.size());
+    writeBigEndian(zlib, adler32(raw.data(), raw.size()));
+    writeChunk(png, "IDAT", zlib);
+    writeChunk(png, "IEND", std::vector<uint8_t>());
+}
+
+bool writePng(const char* path, const Image& image)
+{
+    std::vector<uint8_t> png;
+    encodePng(image, png);
+    std::FILE* file = std::fopen(path, "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(png.data(), 1, png.size(), file) == png.size();
+    return std::fclose(file) == 0 && ok;
+}
+}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace xgfx
+{
+namespace test
+{
+// 8-bit RGBA pixels, top row first.
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Decode an 8-bit RGBA PNG whose deflate stream only has stored or fixed
+// Huffman blocks, and whose rows are filtered with None or Sub. Checks the
+// chunk CRCs and the zlib checksum along the way.
+bool decodePng(const std::vector<uint8_t>& png, Image& image);
+
+// Encode `image` with stored deflate blocks. Large, but enough for goldens.
+void encodePng(const Image& image, std::vector<uint8_t>& png);
+
+bool writePng(const char* path, const Image& image);
+}
+}
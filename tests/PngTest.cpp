@@ -0,0 +1,24 @@
+#include "Png.h"
+#include "Test.h"
+
+#include <vector>
+
+using namespace xgfx::test;
+
+XGFX_TEST(Png, RoundTripsStoredBlocks)
+{
+    // Big enough to need more than one stored block
+    Image image;
+    image.width = 150;
+    image.height = 120;
+    image.pixels.resize((size_t)image.width * image.height * 4);
+    for (size_t i = 0; i < image.pixels.size(); i++)
+        image.pixels[i] = (uint8_t)(i * 7919 >> 3);
+    std::vector<uint8_t> png;
+    encodePng(image, png);
+    Image decoded;
+    if (!decodePng(png, decoded)) return;
+    XGFX_CHECK(decoded.width == image.width);
+    XGFX_CHECK(decoded.height == image.height);
+    XGFX_CHECK(decoded.pixels == image.pixels);
+}
@@ -0,0 +1,306 @@
+#include "CrossWindow/ImGui/Lz4.h"
+#include "CrossWindow/ImGui/Remote.h"
+#include "Test.h"
+#include "imgui.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace xgfx;
+
+namespace
+{
+const ImTextureID kServerFont = (ImTextureID)(intptr_t)1;
+const ImTextureID kServerImage = (ImTextureID)(intptr_t)7;
+const ImTextureID kViewerFont = (ImTextureID)(intptr_t)42;
+const ImTextureID kViewerImage = (ImTextureID)(intptr_t)9;
+
+// An ImGui context for the test's lifetime, with a stand-in font texture.
+struct Context
+{
+    Context() : context(ImGui::CreateContext())
+    {
+        ImGui::GetIO().Fonts->TexID = kViewerFont;
+    }
+
+    ~Context() { ImGui::DestroyContext(context); }
+
+    ImGuiContext* context;
+};
+
+// Positions on the quarter pixel grid and UVs at 16 bits survive encoding.
+void addQuad(ImDrawList& list, float x, float y, float size, ImU32 col)
+{
+    ImDrawIdx base = (ImDrawIdx)list.VtxBuffer.Size;
+    const ImVec2 corners[] = {ImVec2(x, y), ImVec2(x + size, y),
+                              ImVec2(x + size, y + size),
+                              ImVec2(x, y + size)};
+    for (int i = 0; i < 4; i++)
+    {
+        ImDrawVert v;
+        v.pos = corners[i];
+        v.uv = ImVec2(i == 1 || i == 2 ? 1.0f : 0.0f, i >= 2 ? 0.5f : 0.25f);
+        v.col = col;
+        list.VtxBuffer.push_back(v);
+    }
+    const int order[] = {0, 1, 2, 0, 2, 3};
+    for (int i = 0; i < 6; i++)
+        list.IdxBuffer.push_back((ImDrawIdx)(base + order[i]));
+}
+
+void addCommand(ImDrawList& list, ImTextureID texture, unsigned elemCount)
+{
+    ImDrawCmd cmd = ImDrawCmd();
+    cmd.ClipRect = ImVec4(0.0f, 0.0f, 640.0f, 480.0f);
+    cmd.TextureId = texture;
+    for (const ImDrawCmd& previous : list.CmdBuffer)
+        cmd.IdxOffset += previous.ElemCount;
+    cmd.ElemCount = elemCount;
+    list.CmdBuffer.push_back(cmd);
+}
+
+void setLists(ImDrawData& drawData, const std::vector<ImDrawList*>& lists)
+{
+    drawData.Valid = true;
+    drawData.CmdListsCount = (int)lists.size();
+    drawData.TotalVtxCount = drawData.TotalIdxCount = 0;
+#if IMGUI_VERSION_NUM >= 18973
+    drawData.CmdLists.resize(0);
+    for (ImDrawList* list : lists)
+        drawData.CmdLists.push_back(list);
+#else
+    static std::vector<ImDrawList*> storage;
+    storage = lists;
+    drawData.CmdLists = storage.data();
+#endif
+    for (ImDrawList* list : lists)
+    {
+        drawData.TotalVtxCount += list->VtxBuffer.Size;
+        drawData.TotalIdxCount += list->IdxBuffer.Size;
+    }
+    drawData.DisplayPos = ImVec2(0.0f, 0.0f);
+    drawData.DisplaySize = ImVec2(640.0f, 480.0f);
+    drawData.FramebufferScale = ImVec2(2.0f, 2.0f);
+}
+
+ImTextureID viewerTexture(ImTextureID texture)
+{
+    return texture == kServerFont    ? kViewerFont
+           : texture == kServerImage ? kViewerImage
+                                     : texture;
+}
+
+// Whether the viewer's list draws what the server's did. Callbacks other
+// than the render state reset and empty commands aren't sent.
+bool sameList(const ImDrawList& sent, const ImDrawList& received)
+{
+    if (sent.VtxBuffer.Size != received.VtxBuffer.Size ||
+        sent.IdxBuffer.Size != received.IdxBuffer.Size)
+        return false;
+    for (int i = 0; i < sent.VtxBuffer.Size; i++)
+    {
+        const ImDrawVert& a = sent.VtxBuffer[i];
+        const ImDrawVert& b = received.VtxBuffer[i];
+        if (a.pos.x != b.pos.x || a.pos.y != b.pos.y || a.col != b.col ||
+            std::fabs(a.uv.x - b.uv.x) > 1e-4f ||
+            std::fabs(a.uv.y - b.uv.y) > 1e-4f)
+            return false;
+    }
+    if (memcmp(sent.IdxBuffer.Data, received.IdxBuffer.Data,
+               sent.IdxBuffer.size_in_bytes()) != 0)
+        return false;
+
+    int r = 0;
+    for (const ImDrawCmd& cmd : sent.CmdBuffer)
+    {
+        if ((cmd.UserCallback &&
+             cmd.UserCallback != ImDrawCallback_ResetRenderState) ||
+            (!cmd.UserCallback && cmd.ElemCount == 0))
+            continue;
+        if (r >= received.CmdBuffer.Size) return false;
+        const ImDrawCmd& other = received.CmdBuffer[r++];
+        if (cmd.UserCallback)
+        {
+            if (other.UserCallback != cmd.UserCallback) return false;
+            continue;
+        }
+        if (other.UserCallback || other.ElemCount != cmd.ElemCount ||
+            other.IdxOffset != cmd.IdxOffset ||
+            other.VtxOffset != cmd.VtxOffset ||
+            memcmp(&other.ClipRect, &cmd.ClipRect, sizeof(ImVec4)) != 0 ||
+            other.TextureId != viewerTexture(cmd.TextureId))
+            return false;
+    }
+    return r == received.CmdBuffer.Size;
+}
+
+bool sameFrame(const ImDrawData& sent, const ImDrawData* received)
+{
+    if (!received || received->CmdListsCount != sent.CmdListsCount ||
+        received->TotalVtxCount != sent.TotalVtxCount ||
+        received->TotalIdxCount != sent.TotalIdxCount ||
+        received->FramebufferScale.x != sent.FramebufferScale.x ||
+        received->DisplaySize.x != sent.DisplaySize.x)
+        return false;
+    for (int n = 0; n < sent.CmdListsCount; n++)
+        if (!sameList(*sent.CmdLists[n], *received->CmdLists[n]))
+            return false;
+    return true;
+}
+
+// Two windows, one drawing with the font and an image, the other resetting
+// the render state between its draws.
+struct Scene
+{
+    Scene()
+        : first(ImGui::GetDrawListSharedData()),
+          second(ImGui::GetDrawListSharedData())
+    {
+        first._OwnerName = "First";
+        second._OwnerName = "Second";
+        addQuad(first, 10.0f, 10.0f, 100.0f, 0xff0000ff);
+        addQuad(first, 20.25f, 30.5f, 8.75f, 0x80ffffff);
+        addCommand(first, kServerFont, 6);
+        addCommand(first, kServerImage, 6);
+        addCommand(first, kServerImage, 0);
+
+        addQuad(second, 300.0f, 200.0f, 50.0f, 0xff00ff00);
+        addQuad(second, 310.0f, 210.0f, 20.0f, 0xffff0000);
+        addCommand(second, kServerFont, 6);
+        ImDrawCmd reset = ImDrawCmd();
+        reset.UserCallback = ImDrawCallback_ResetRenderState;
+        second.CmdBuffer.push_back(reset);
+        addCommand(second, kServerImage, 6);
+        setLists(drawData, {&first, &second});
+    }
+
+    ImDrawList first, second;
+    ImDrawData drawData;
+};
+
+// The frame's LZ4 compressed body, with the 4 byte size in front
+std::vector<uint8_t> decompressFrame(const std::vector<uint8_t>& frame)
+{
+    uint32_t rawSize = 0;
+    memcpy(&rawSize, frame.data(), sizeof(rawSize));
+    std::vector<uint8_t> raw(rawSize);
+    lz4::decompress(frame.data() + 4, frame.size() - 4, raw.data(), rawSize);
+    return raw;
+}
+
+std::vector<uint8_t> compressFrame(const std::vector<uint8_t>& raw)
+{
+    std::vector<uint8_t> frame(4 + lz4::compressBound(raw.size()));
+    uint32_t rawSize = (uint32_t)raw.size();
+    memcpy(frame.data(), &rawSize, sizeof(rawSize));
+    frame.resize(4 + lz4::compress(raw.data(), raw.size(), &frame[4]));
+    return frame;
+}
+}
+
+XGFX_TEST(Remote, RoundTripsFrames)
+{
+    Context context;
+    Scene scene;
+    RemoteFrameEncoder encoder;
+    RemoteFrameDecoder decoder;
+    decoder.mapTexture((ImU64)(intptr_t)kServerImage, kViewerImage);
+    std::vector<uint8_t> frame;
+
+    encoder.encode(&scene.drawData, kServerFont, frame);
+    XGFX_CHECK(sameFrame(scene.drawData, decoder.decode(frame.data(),
+                                                        frame.size())));
+
+    // A moved vertex is sent as a delta, the other list as unchanged
+    std::vector<uint8_t> keyframe = frame;
+    scene.first.VtxBuffer[5].pos.x += 3.25f;
+    scene.first.VtxBuffer[5].col = 0xff123456;
+    encoder.encode(&scene.drawData, kServerFont, frame);
+    XGFX_CHECK(frame.size() < keyframe.size());
+    XGFX_CHECK(sameFrame(scene.drawData, decoder.decode(frame.data(),
+                                                        frame.size())));
+
+    // A window that's gone is dropped, and a grown one sent in full
+    addQuad(scene.second, 0.0f, 0.0f, 4.0f, 0xffffffff);
+    scene.second.CmdBuffer.back().ElemCount += 6;
+    setLists(scene.drawData, {&scene.second});
+    encoder.encode(&scene.drawData, kServerFont, frame);
+    XGFX_CHECK(sameFrame(scene.drawData, decoder.decode(frame.data(),
+                                                        frame.size())));
+    XGFX_CHECK(encoder.memoryBytes() > 0);
+
+    // After a reset the next frame stands alone
+    encoder.reset();
+    encoder.encode(&scene.drawData, kServerFont, frame);
+    RemoteFrameDecoder fresh;
+    fresh.mapTexture((ImU64)(intptr_t)kServerImage, kViewerImage);
+    XGFX_CHECK(sameFrame(scene.drawData, fresh.decode(frame.data(),
+                                                      frame.size())));
+}
+
+XGFX_TEST(Remote, RejectsMalformedFrames)
+{
+    Context context;
+    Scene scene;
+    RemoteFrameEncoder encoder;
+    std::vector<uint8_t> keyframe, delta;
+    encoder.encode(&scene.drawData, kServerFont, keyframe);
+    scene.first.VtxBuffer[0].pos.y += 1.0f;
+    encoder.encode(&scene.drawData, kServerFont, delta);
+
+    // A delta without the frame it follows
+    RemoteFrameDecoder decoder;
+    XGFX_CHECK(!decoder.decode(delta.data(), delta.size()));
+
+    // Every truncation
+    int accepted = 0;
+    for (size_t cut = 0; cut < keyframe.size(); cut++)
+        accepted += decoder.decode(keyframe.data(), cut) != nullptr;
+    XGFX_CHECK(accepted == 0);
+
+    // Counts claiming more than the frame holds, checked before anything
+    // is allocated for them. The raw frame starts with its magic, keyframe
+    // flag, display pos, size and scale, then the list count and the first
+    // list's key, mode and vertex count.
+    std::vector<uint8_t> raw = decompressFrame(keyframe);
+    const size_t listCountOffset = 4 + 1 + 3 * sizeof(ImVec2);
+    const size_t vtxCountOffset = listCountOffset + 4 + 4 + 1;
+    const uint32_t huge[] = {0xffffffffu, 0x7fffffffu, 0x10000u};
+    for (uint32_t count : huge)
+    {
+        for (size_t offset : {listCountOffset, vtxCountOffset,
+                              vtxCountOffset + 4, vtxCountOffset + 8})
+        {
+            std::vector<uint8_t> bad = raw;
+            memcpy(&bad[offset], &count, sizeof(count));
+            std::vector<uint8_t> frame = compressFrame(bad);
+            XGFX_CHECK(!decoder.decode(frame.data(), frame.size()));
+        }
+    }
+    std::vector<uint8_t> bad = raw;
+    bad[0] ^= 1;
+    std::vector<uint8_t> frame = compressFrame(bad);
+    XGFX_CHECK(!decoder.decode(frame.data(), frame.size()));
+
+    // Any corrupted byte either decodes to something or is rejected, without
+    // reading past the frame
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        for (uint8_t flip : {0x01, 0x80, 0xff})
+        {
+            bad = raw;
+            bad[i] ^= flip;
+            frame = compressFrame(bad);
+            decoder.reset();
+            decoder.decode(frame.data(), frame.size());
+        }
+    }
+
+    // And the decoder recovers with the next keyframe
+    decoder.reset();
+    decoder.mapTexture((ImU64)(intptr_t)kServerImage, kViewerImage);
+    scene.first.VtxBuffer[0].pos.y -= 1.0f;
+    XGFX_CHECK(sameFrame(scene.drawData,
+                         decoder.decode(keyframe.data(), keyframe.size())));
+}
@@ -0,0 +1,180 @@
+#include "Scenes.h"
+#include "Test.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace xgfx
+{
+namespace test
+{
+namespace
+{
+// ImGui settles window sizes and fonts over the first couple of frames
+const int kFrames = 3;
+
+void buildWidgets(ImGuiManager&)
+{
+    static bool checked = true;
+    static float value = 0.25f;
+    static char text[32] = "Hello";
+    static float samples[64];
+    for (int i = 0; i < 64; i++)
+        samples[i] = std::sin(i * 0.2f);
+
+    ImGui::SetNextWindowPos(ImVec2(8.0f, 8.0f));
+    ImGui::SetNextWindowSize(ImVec2(300.0f, 220.0f));
+    ImGui::Begin("Widgets", nullptr, ImGuiWindowFlags_NoSavedSettings);
+    ImGui::Text("Value %.2f", value);
+    ImGui::Button("Button");
+    ImGui::SameLine();
+    ImGui::Checkbox("Checkbox", &checked);
+    ImGui::SliderFloat("Slider", &value, 0.0f, 1.0f);
+    ImGui::InputText("Input", text, sizeof(text));
+    ImGui::ProgressBar(value);
+    ImGui::PlotLines("Plot", samples, 64);
+    ImGui::End();
+}
+
+// A window hidden behind an opaque one, and one only partly covered
+void buildOverlap(ImGuiManager&)
+{
+    ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 1.0f;
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoSavedSettings;
+    ImGui::SetNextWindowPos(ImVec2(40.0f, 40.0f));
+    ImGui::SetNextWindowSize(ImVec2(120.0f, 80.0f));
+    ImGui::Begin("Back", nullptr, flags);
+    for (int i = 0; i < 4; i++)
+        ImGui::Text("Hidden line %d", i);
+    ImGui::End();
+    ImGui::SetNextWindowPos(ImVec2(200.0f, 20.0f));
+    ImGui::SetNextWindowSize(ImVec2(110.0f, 200.0f));
+    ImGui::Begin("Side", nullptr, flags);
+    for (int i = 0; i < 12; i++)
+        ImGui::Text("Side line %d", i);
+    ImGui::End();
+    ImGui::SetNextWindowPos(ImVec2(20.0f, 20.0f));
+    ImGui::SetNextWindowSize(ImVec2(240.0f, 160.0f));
+    ImGui::Begin("Front", nullptr, flags);
+    ImGui::Text("Covers Back and part of Side");
+    ImGui::End();
+}
+
+// Far more rows than fit, only the visible ones should be submitted
+void buildTable(ImGuiManager&)
+{
+    ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+    ImGui::SetNextWindowSize(ImVec2((float)kSceneWidth, (float)kSceneHeight));
+    ImGui::Begin("Table", nullptr, ImGuiWindowFlags_NoSavedSettings);
+    const ImGuiTableFlags flags = ImGuiTableFlags_ScrollY |
+                                  ImGuiTableFlags_RowBg |
+                                  ImGuiTableFlags_Borders;
+    if (ImGui::BeginTable("rows", 4, flags))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Id");
+        ImGui::TableSetupColumn("Name");
+        ImGui::TableSetupColumn("Value");
+        ImGui::TableSetupColumn("State");
+        ImGui::TableHeadersRow();
+        ImGuiListClipper clipper;
+        clipper.Begin(10000);
+        while (clipper.Step())
+        {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd;
+                 row++)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%d", row);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("Row %d", row);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.3f", row * 0.001f);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::TextUnformatted(row % 3 ? "Idle" : "Busy");
+            }
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+// Rounded frames, circles and lines through the manager, single quads on
+// backends that evaluate them in their shaders
+void buildShapes(ImGuiManager& manager)
+{
+    ImGui::SetNextWindowPos(ImVec2(8.0f, 8.0f));
+    ImGui::SetNextWindowSize(ImVec2(300.0f, 220.0f));
+    ImGui::Begin("Shapes", nullptr, ImGuiWindowFlags_NoSavedSettings);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    for (int i = 0; i < 32; i++)
+    {
+        float x = origin.x + (i % 8) * 34.0f;
+        float y = origin.y + (i / 8) * 44.0f;
+        ImU32 col = IM_COL32(64 + i * 6, 128, 255 - i * 6, 255);
+        manager.addRect(drawList, ImVec2(x, y), ImVec2(x + 28.0f, y + 16.0f),
+                        col, 4.0f, i % 2 ? 1.5f : 0.0f);
+        manager.addCircle(drawList, ImVec2(x + 14.0f, y + 28.0f), 7.0f, col,
+                          i % 2 ? 0.0f : 1.0f);
+        manager.addLine(drawList, ImVec2(x, y + 40.0f),
+                        ImVec2(x + 28.0f, y + 36.0f), col);
+    }
+    ImGui::Dummy(ImVec2(272.0f, 176.0f));
+    ImGui::End();
+}
+
+ImGuiFrameBudget budget(unsigned drawCalls, size_t bytesUploaded)
+{
+    ImGuiFrameBudget b;
+    b.drawCalls = drawCalls;
+    b.bytesUploaded = bytesUploaded;
+    // Generous, software rasterizers and sanitizers run these too
+    b.cpuTimeMs = 50.0;
+    return b;
+}
+}
+
+const Scene kScenes[] = {
+    {"Widgets", buildWidgets, budget(8, 128 * 1024), 0},
+    {"Overlap", buildOverlap, budget(12, 128 * 1024), 1},
+    // Every row submitted would upload megabytes
+    {"Table", buildTable, budget(16, 256 * 1024), 0},
+    // Tessellated where the backend doesn't evaluate shapes
+    {"Shapes", buildShapes, budget(4, 256 * 1024), 0},
+};
+const int kSceneCount = sizeof(kScenes) / sizeof(kScenes[0]);
+
+void runScene(ImGuiManager& manager, const Scene& scene,
+              const std::function<void(ImDrawData*)>& render)
+{
+    manager.makeCurrent();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2((float)kSceneWidth, (float)kSceneHeight);
+    io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
+    io.DeltaTime = 1.0f / 60.0f;
+    manager.setOcclusionCulling(scene.drawsOccluded > 0);
+
+    for (int frame = 0; frame < kFrames; frame++)
+    {
+        if (manager.beginFrame())
+        {
+            scene.build(manager);
+            ImGui::Render();
+        }
+        render(ImGui::GetDrawData());
+    }
+
+    const ImGuiFrameStats& stats = manager.getFrameStats();
+    bool withinBudget =
+        XGFX_CHECK(manager.checkFrameBudget(scene.budget, scene.name));
+    bool culled = XGFX_CHECK(stats.drawsOccluded >= scene.drawsOccluded);
+    if (!withinBudget || !culled)
+        fprintf(stderr, "%s: %u draws, %u occluded, %zu bytes, %.2f ms\n",
+                scene.name, stats.drawCalls, stats.drawsOccluded,
+                stats.bytesUploaded, stats.cpuTimeMs);
+}
+}
+}
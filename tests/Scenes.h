@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CrossWindow/ImGui/ImGuiManager.h"
+#include "imgui.h"
+
+#include <functional>
+
+namespace xgfx
+{
+namespace test
+{
+const int kSceneWidth = 320;
+const int kSceneHeight = 240;
+
+// A scripted UI built the same way every frame, and the budget its last
+// frame has to stay within on every backend.
+struct Scene
+{
+    const char* name;
+    void (*build)(ImGuiManager& manager);
+    ImGuiFrameBudget budget;
+    // Runs with occlusion culling when nonzero, expecting at least this many
+    // draws to be skipped.
+    unsigned drawsOccluded;
+};
+
+extern const Scene kScenes[];
+extern const int kSceneCount;
+
+// Build `scene` for a few frames with the manager's current ImGui context,
+// passing each frame's draw data to `render`, then check the last frame's
+// statistics against the scene's budget.
+void runScene(ImGuiManager& manager, const Scene& scene,
+              const std::function<void(ImDrawData*)>& render);
+}
+}
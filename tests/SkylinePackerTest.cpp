@@ -0,0 +1,56 @@
+#include "CrossWindow/ImGui/SkylinePacker.h"
+#include "Test.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace xgfx;
+
+XGFX_TEST(SkylinePacker, FillsExactly)
+{
+    SkylinePacker packer;
+    packer.reset(64, 64);
+    int x = 0, y = 0;
+    for (int i = 0; i < 16; i++)
+        XGFX_CHECK(packer.pack(16, 16, x, y));
+    XGFX_CHECK(!packer.pack(1, 1, x, y));
+
+    packer.reset(64, 64);
+    XGFX_CHECK(!packer.pack(65, 1, x, y));
+    XGFX_CHECK(!packer.pack(1, 65, x, y));
+    XGFX_CHECK(packer.pack(64, 64, x, y) && x == 0 && y == 0);
+}
+
+XGFX_TEST(SkylinePacker, PlacesWithoutOverlap)
+{
+    const int kSize = 256;
+    SkylinePacker packer;
+    packer.reset(kSize, kSize);
+    std::vector<unsigned char> used(kSize * kSize, 0);
+    uint32_t seed = 7;
+    int packed = 0, overlaps = 0, outside = 0;
+    for (int i = 0; i < 500; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        int w = 1 + (seed >> 8) % 24, h = 1 + (seed >> 16) % 24;
+        int x = -1, y = -1;
+        if (!packer.pack(w, h, x, y)) continue;
+        packed++;
+        if (x < 0 || y < 0 || x + w > kSize || y + h > kSize)
+        {
+            outside++;
+            continue;
+        }
+        for (int j = y; j < y + h; j++)
+            for (int k = x; k < x + w; k++)
+                overlaps += used[j * kSize + k]++ != 0;
+    }
+    XGFX_CHECK(outside == 0);
+    XGFX_CHECK(overlaps == 0);
+    // Random sizes up to a tenth of the side still fill most of it
+    int area = 0;
+    for (unsigned char u : used)
+        area += u;
+    XGFX_CHECK(packed > 100);
+    XGFX_CHECK(area > kSize * kSize * 3 / 4);
+}
@@ -0,0 +1,166 @@
+#include "CrossWindow/ImGui/Table.h"
+#include "CrossWindow/ImGui/WorkerPool.h"
+#include "Test.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace xgfx;
+
+namespace
+{
+// A number column with ties and NaNs, and a name column whose names share
+// prefixes longer than the 8 bytes sorted on up front.
+class Source : public TableSource
+{
+  public:
+    explicit Source(size_t rows) : mNumbers(rows), mNames(rows)
+    {
+        uint32_t seed = 3;
+        for (size_t i = 0; i < rows; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            mNumbers[i] = i % 101 == 0 ? std::numeric_limits<double>::quiet_NaN()
+                                       : (double)(seed >> 20);
+            char name[32];
+            snprintf(name, sizeof(name), "%s%05u",
+                     i % 3 ? "sharedprefix" : "short", (seed >> 8) % 50000);
+            mNames[i] = name;
+        }
+    }
+
+    size_t rowCount() const override { return mNumbers.size(); }
+
+    int columnCount() const override { return 2; }
+
+    const char* columnName(int column) const override
+    {
+        return column == 0 ? "Number" : "Name";
+    }
+
+    bool isNumeric(int column) const override { return column == 0; }
+
+    double number(int column, size_t row) const override
+    {
+        return mNumbers[row];
+    }
+
+    const char* text(int column, size_t row, char* buf,
+                     size_t size) const override
+    {
+        if (column == 1) return mNames[row].c_str();
+        snprintf(buf, size, "%g", mNumbers[row]);
+        return buf;
+    }
+
+    // Whether source row `a` belongs before `b`, ties in source order.
+    bool before(int column, bool descending, size_t a, size_t b) const
+    {
+        int order = 0;
+        if (column == 0)
+        {
+            double x = std::isnan(mNumbers[a]) ? -HUGE_VAL : mNumbers[a];
+            double y = std::isnan(mNumbers[b]) ? -HUGE_VAL : mNumbers[b];
+            order = x < y ? -1 : x > y ? 1 : 0;
+        }
+        else
+        {
+            order = strcmp(mNames[a].c_str(), mNames[b].c_str());
+        }
+        if (descending) order = -order;
+        return order != 0 ? order < 0 : a < b;
+    }
+
+  private:
+    std::vector<double> mNumbers;
+    std::vector<std::string> mNames;
+};
+
+bool sortedBy(const TableView& view, const Source& source, int column,
+              bool descending)
+{
+    for (size_t i = 1; i < view.getRowCount(); i++)
+        if (!source.before(column, descending, view.getSourceRow(i - 1),
+                           view.getSourceRow(i)))
+            return false;
+    return true;
+}
+}
+
+XGFX_TEST(Table, SortsColumns)
+{
+    WorkerPool workers(4);
+    Source source(100000);
+    TableView view(workers);
+    view.setSource(&source);
+    view.flush();
+    XGFX_CHECK(view.getRowCount() == source.rowCount());
+    XGFX_CHECK(view.getSourceRow(5) == 5);
+
+    for (int column = 0; column < 2; column++)
+    {
+        for (int descending = 0; descending < 2; descending++)
+        {
+            view.setSort(column, descending != 0);
+            view.flush();
+            XGFX_CHECK(!view.isBusy());
+            XGFX_CHECK(view.getRowCount() == source.rowCount());
+            XGFX_CHECK(sortedBy(view, source, column, descending != 0));
+        }
+    }
+
+    view.setSort(-1);
+    view.flush();
+    XGFX_CHECK(view.getSourceRow(1234) == 1234);
+}
+
+XGFX_TEST(Table, SortsFilteredRows)
+{
+    WorkerPool workers(4);
+    Source source(50000);
+    TableView view(workers);
+    view.setSource(&source);
+    view.setFilter("short");
+    view.setSort(1, true);
+    view.flush();
+
+    // Every third row is named "short..."
+    size_t expected = (source.rowCount() + 2) / 3;
+    XGFX_CHECK(view.getRowCount() == expected);
+    char buf[64];
+    bool matching = true;
+    for (size_t i = 0; i < view.getRowCount(); i++)
+        matching = matching &&
+                   strstr(source.text(1, view.getSourceRow(i), buf,
+                                      sizeof(buf)),
+                          "short") != nullptr;
+    XGFX_CHECK(matching);
+    XGFX_CHECK(sortedBy(view, source, 1, true));
+}
+
+XGFX_TEST(Table, UsesLatestRequest)
+{
+    WorkerPool workers(4);
+    Source source(20000);
+    TableView view(workers);
+    view.setSource(&source);
+    view.setSort(0, true);
+    view.setFilter("prefix");
+    view.setSort(1);
+    view.flush();
+
+    // Every row not named "short..."
+    size_t expected = source.rowCount() - (source.rowCount() + 2) / 3;
+    XGFX_CHECK(view.getRowCount() == expected);
+    XGFX_CHECK(sortedBy(view, source, 1, false));
+
+    // Changed data shows in source order until sorted again
+    view.refresh();
+    XGFX_CHECK(view.getRowCount() == source.rowCount());
+    view.flush();
+    XGFX_CHECK(view.getRowCount() == expected);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdio>
+
+namespace xgfx
+{
+namespace test
+{
+// A test function, registered by XGFX_TEST() before main() runs.
+struct TestCase
+{
+    const char* suite;
+    const char* name;
+    void (*run)();
+    TestCase* next;
+};
+
+struct Registrar
+{
+    explicit Registrar(TestCase& test);
+};
+
+// Report a failed check of the running test. Returns `ok` so a test can
+// stop early on a failure its later checks depend on.
+bool check(bool ok, const char* expr, const char* file, int line);
+
+// Skip the running test when its environment is missing, e.g. a GL driver.
+// A run where every test skipped exits with kSkipped for ctest.
+void skip(const char* reason);
+
+const int kSkipped = 77;
+}
+}
+
+// Define a test in `suite`. `ctest` runs each suite as its own test, and the
+// test executable runs the suites or `Suite.Name` tests given on its command
+// line, or all of them.
+#define XGFX_TEST(suite, name)                                                 \
+    static void suite##_##name();                                              \
+    static xgfx::test::TestCase suite##_##name##_case = {                      \
+        #suite, #name, suite##_##name, nullptr};                               \
+    static xgfx::test::Registrar suite##_##name##_registrar(                   \
+        suite##_##name##_case);                                                \
+    static void suite##_##name()
+
+#define XGFX_CHECK(expr) xgfx::test::check((expr), #expr, __FILE__, __LINE__)